@@ -0,0 +1,336 @@
+// PATH_MAX is not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <AvUtils/dataStructures/avDynamicArray.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#endif
+
+#define ACTION_CACHE_DIR BUILD_DATABASE_DIR "/cache"
+#define ACTION_CACHE_ENTRY_NAME_SIZE (PATH_MAX + 64)
+
+static struct ActionCache {
+    bool32 enabled;
+    bool32 modified;
+    uint64 maxSize;
+    char dir[PATH_MAX]; // absolute, import.project runs sub-builds from their own directories
+} actionCache = {0};
+
+void actionCacheOpen(uint64 maxSize){
+    actionCache.enabled = false;
+    actionCache.modified = false;
+    actionCache.maxSize = maxSize;
+#ifndef _WIN32
+    if(maxSize == 0){
+        return;
+    }
+    workspacePath(actionCache.dir, sizeof(actionCache.dir), ACTION_CACHE_DIR);
+    if(mkdir(actionCache.dir, 0755) != 0 && errno != EEXIST){
+        return;
+    }
+    actionCache.enabled = true;
+#endif
+}
+
+bool32 actionCacheEnabled(){
+    return actionCache.enabled;
+}
+
+bool32 hashFileContent(AvString path, uint64* hash){
+#ifndef _WIN32
+    char* fileName = avAllocate(path.len + 1, "file name");
+    memcpy(fileName, path.chrs, path.len);
+    fileName[path.len] = '\0';
+    int fd = open(fileName, O_RDONLY);
+    avFree(fileName);
+    if(fd == -1){
+        return false;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0){
+        close(fd);
+        return false;
+    }
+    uint64 size = info.st_size;
+    *hash = hashBytes(&size, sizeof(uint64), *hash);
+    if(size){
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED){
+            close(fd);
+            return false;
+        }
+        *hash = hashBytes(data, size, *hash);
+        munmap(data, size);
+    }
+    close(fd);
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifndef _WIN32
+static void entryName(char* name, uint64 key){
+    snprintf(name, ACTION_CACHE_ENTRY_NAME_SIZE, "%s/%016llx", actionCache.dir, (unsigned long long)key);
+}
+
+// reflinks where the filesystem supports them, hardlinks otherwise and copies as a last resort
+static bool32 cloneFile(const char* source, const char* destination, bool32 allowLink){
+    int in = open(source, O_RDONLY);
+    if(in == -1){
+        return false;
+    }
+    struct stat info;
+    if(fstat(in, &info) != 0){
+        close(in);
+        return false;
+    }
+
+    unlink(destination);
+    int out = open(destination, O_WRONLY | O_CREAT | O_TRUNC, info.st_mode & 0777);
+    if(out == -1){
+        close(in);
+        return false;
+    }
+#ifdef FICLONE
+    if(ioctl(out, FICLONE, in) == 0){
+        close(out);
+        close(in);
+        return true;
+    }
+#endif
+    if(allowLink){
+        close(out);
+        unlink(destination);
+        if(link(source, destination) == 0){
+            close(in);
+            return true;
+        }
+        out = open(destination, O_WRONLY | O_CREAT | O_TRUNC, info.st_mode & 0777);
+        if(out == -1){
+            close(in);
+            return false;
+        }
+    }
+
+    char buffer[64 * 1024];
+    bool32 success = true;
+    while(success){
+        ssize_t readBytes = read(in, buffer, sizeof(buffer));
+        if(readBytes == 0){
+            break;
+        }
+        if(readBytes < 0){
+            success = errno == EINTR;
+            continue;
+        }
+        success = write(out, buffer, readBytes) == readBytes;
+    }
+    close(out);
+    close(in);
+    if(!success){
+        unlink(destination);
+    }
+    return success;
+}
+
+static void removeEntry(const char* entry){
+    DIR* dir = opendir(entry);
+    if(dir){
+        struct dirent* file;
+        char fileName[ACTION_CACHE_ENTRY_NAME_SIZE + 256];
+        while((file = readdir(dir))){
+            if(strcmp(file->d_name, ".") == 0 || strcmp(file->d_name, "..") == 0){
+                continue;
+            }
+            snprintf(fileName, sizeof(fileName), "%s/%s", entry, file->d_name);
+            unlink(fileName);
+        }
+        closedir(dir);
+    }
+    rmdir(entry);
+}
+#endif
+
+bool32 actionCacheRestore(const struct CommandBuild* build){
+#ifndef _WIN32
+    if(!actionCache.enabled || build->actionKey == 0){
+        return false;
+    }
+    char entry[ACTION_CACHE_ENTRY_NAME_SIZE];
+    entryName(entry, build->actionKey);
+    struct stat info;
+    if(stat(entry, &info) != 0){
+        return false;
+    }
+
+    char fileName[ACTION_CACHE_ENTRY_NAME_SIZE + 32];
+    for(uint32 i = 0; i < build->outputCount; i++){
+        snprintf(fileName, sizeof(fileName), "%s/%u", entry, i);
+        if(!cloneFile(fileName, build->outputs[i], true)){
+            return false;
+        }
+    }
+    if(build->depfile){
+        snprintf(fileName, sizeof(fileName), "%s/d", entry);
+        if(!cloneFile(fileName, build->depfile, false)){
+            return false;
+        }
+    }
+
+    // the modification time of an entry tracks its last use
+    utimes(entry, nullptr);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void actionCacheStore(const struct CommandBuild* build){
+#ifndef _WIN32
+    if(!actionCache.enabled || build->actionKey == 0){
+        return;
+    }
+    char entry[ACTION_CACHE_ENTRY_NAME_SIZE];
+    entryName(entry, build->actionKey);
+    struct stat info;
+    if(stat(entry, &info) == 0){
+        return;
+    }
+
+    // entries are filled in a private directory and renamed into place, so they are never seen half written
+    char tmpEntry[ACTION_CACHE_ENTRY_NAME_SIZE + 32];
+    snprintf(tmpEntry, sizeof(tmpEntry), "%s.tmp%i", entry, (int)getpid());
+    if(mkdir(tmpEntry, 0755) != 0){
+        return;
+    }
+
+    // a hardlink would let anything writing the output in place change the entry as well, so entries own their
+    // content and are only linked out when restored, see actionCacheDetachOutputs
+    char fileName[ACTION_CACHE_ENTRY_NAME_SIZE + 64];
+    bool32 success = true;
+    for(uint32 i = 0; i < build->outputCount && success; i++){
+        snprintf(fileName, sizeof(fileName), "%s/%u", tmpEntry, i);
+        success = cloneFile(build->outputs[i], fileName, false);
+    }
+    if(success && build->depfile){
+        snprintf(fileName, sizeof(fileName), "%s/d", tmpEntry);
+        success = cloneFile(build->depfile, fileName, false);
+    }
+    if(!success || rename(tmpEntry, entry) != 0){
+        removeEntry(tmpEntry);
+        return;
+    }
+    actionCache.modified = true;
+#endif
+}
+
+void actionCacheDetachOutputs(const struct CommandBuild* build){
+#ifndef _WIN32
+    // outputs restored as hardlinks of an entry must not be overwritten in place
+    for(uint32 i = 0; i < build->outputCount; i++){
+        struct stat info;
+        if(stat(build->outputs[i], &info) == 0 && info.st_nlink > 1){
+            unlink(build->outputs[i]);
+        }
+    }
+#endif
+}
+
+#ifndef _WIN32
+struct CacheEntry {
+    uint64 lastUse;
+    uint64 size;
+    char name[32];
+};
+
+static int compareCacheEntries(const void* a, const void* b){
+    const struct CacheEntry* entryA = a;
+    const struct CacheEntry* entryB = b;
+    return (entryA->lastUse > entryB->lastUse) - (entryA->lastUse < entryB->lastUse);
+}
+
+// removes the least recently used entries until the cache is below its size limit
+static void evictEntries(){
+    DIR* dir = opendir(actionCache.dir);
+    if(dir == nullptr){
+        return;
+    }
+    AV_DS(AvDynamicArray, struct CacheEntry) entries = AV_EMPTY;
+    avDynamicArrayCreate(0, sizeof(struct CacheEntry), &entries);
+
+    uint64 totalSize = 0;
+    char fileName[ACTION_CACHE_ENTRY_NAME_SIZE + 256];
+    struct dirent* file;
+    while((file = readdir(dir))){
+        if(file->d_name[0] == '.' || strlen(file->d_name) >= sizeof(((struct CacheEntry*)0)->name)){
+            continue;
+        }
+        struct CacheEntry entry = {0};
+        strcpy(entry.name, file->d_name);
+        snprintf(fileName, sizeof(fileName), "%s/%s", actionCache.dir, file->d_name);
+        struct stat info;
+        if(stat(fileName, &info) != 0 || !S_ISDIR(info.st_mode)){
+            continue;
+        }
+        entry.lastUse = info.st_mtime;
+
+        DIR* entryDir = opendir(fileName);
+        if(entryDir == nullptr){
+            continue;
+        }
+        struct dirent* entryFile;
+        char entryFileName[ACTION_CACHE_ENTRY_NAME_SIZE + 512];
+        while((entryFile = readdir(entryDir))){
+            snprintf(entryFileName, sizeof(entryFileName), "%s/%s", fileName, entryFile->d_name);
+            if(entryFile->d_name[0] != '.' && stat(entryFileName, &info) == 0){
+                entry.size += info.st_size;
+            }
+        }
+        closedir(entryDir);
+        totalSize += entry.size;
+        avDynamicArrayAdd(&entry, entries);
+    }
+    closedir(dir);
+
+    if(totalSize > actionCache.maxSize){
+        avDynamicArrayMakeContiguous(entries);
+        uint32 entryCount = avDynamicArrayGetSize(entries);
+        struct CacheEntry* sortedEntries = avDynamicArrayGetPageDataPtr(0, entries);
+        qsort(sortedEntries, entryCount, sizeof(struct CacheEntry), compareCacheEntries);
+        // leave some headroom so the next run does not evict again right away
+        uint64 targetSize = actionCache.maxSize / 10 * 9;
+        for(uint32 i = 0; i < entryCount && totalSize > targetSize; i++){
+            snprintf(fileName, sizeof(fileName), "%s/%s", actionCache.dir, sortedEntries[i].name);
+            removeEntry(fileName);
+            totalSize -= sortedEntries[i].size;
+        }
+    }
+    avDynamicArrayDestroy(entries);
+}
+#endif
+
+void actionCacheClose(){
+#ifndef _WIN32
+    if(actionCache.enabled && actionCache.modified){
+        evictEntries();
+    }
+#endif
+    memset(&actionCache, 0, sizeof(struct ActionCache));
+}
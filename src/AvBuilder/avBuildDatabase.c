@@ -0,0 +1,531 @@
+// st_mtim, ftruncate and PATH_MAX are not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <AvUtils/logging/avAssert.h>
+#include <AvUtils/dataStructures/avDynamicArray.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#endif
+
+// the working directory the run started in, scripts change directories while they run
+static char workspaceDir[PATH_MAX] = {0};
+
+// the databases and caches stay in the build directory of the workspace, whatever directory a script changed to
+void workspaceOpen(){
+#ifndef _WIN32
+    if(getcwd(workspaceDir, sizeof(workspaceDir)) == nullptr){
+        workspaceDir[0] = '\0';
+    }
+#endif
+}
+
+// the absolute path of relative within the workspace, relative itself as long as the workspace is unknown
+void workspacePath(char* path, uint64 size, const char* relative){
+    if(workspaceDir[0] == '\0'){
+        snprintf(path, size, "%s", relative);
+    }else{
+        snprintf(path, size, "%s/%s", workspaceDir, relative);
+    }
+}
+
+#define BUILD_DATABASE_MAGIC 0x42444241 // "ABDB"
+#define BUILD_DATABASE_VERSION 1
+#define BUILD_DATABASE_COMPACT_THRESHOLD 1024
+
+struct BuildDatabaseHeader {
+    uint32 magic;
+    uint32 version;
+};
+
+static struct BuildDatabase {
+    int fd;
+    uint64 recordCount;
+    uint64 entryCount;
+    uint64 capacity;
+    struct BuildRecord* entries;
+} database = { .fd = -1 };
+
+#define DEPENDENCY_DATABASE_MAGIC 0x53504544 // "DEPS"
+#define DEPENDENCY_DATABASE_VERSION 1
+
+struct DependencyRecordHeader {
+    uint64 key;
+    uint32 count; // number of paths
+    uint32 size;  // size of the nul separated paths, padded to 8 bytes
+};
+
+struct DependencyEntry {
+    struct DependencyRecordHeader header;
+    const char* paths;
+    bool32 owned;
+};
+
+static struct DependencyDatabase {
+    int fd;
+    uint64 recordCount;
+    uint64 entryCount;
+    uint64 capacity;
+    struct DependencyEntry* entries;
+    void* mapping;
+    uint64 mappingSize;
+} dependencyDatabase = { .fd = -1 };
+
+uint64 hashBytes(const void* data, uint64 size, uint64 hash){
+    const uint8* bytes = data;
+    for(uint64 i = 0; i < size; i++){
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64 hashString(AvString str, uint64 hash){
+    hash = hashBytes(str.chrs, str.len, hash);
+    // separator, so ["ab","c"] and ["a","bc"] do not collide
+    return hashBytes("", 1, hash);
+}
+
+bool32 fileStatus(AvString path, uint64* time, uint64* size){
+    char* fileName = avAllocate(path.len + 1, "file name");
+    memcpy(fileName, path.chrs, path.len);
+    fileName[path.len] = '\0';
+    struct stat info;
+    bool32 exists = stat(fileName, &info) == 0;
+    avFree(fileName);
+    if(!exists){
+        return false;
+    }
+#ifdef __linux__
+    *time = (uint64)info.st_mtim.tv_sec * 1000000000ull + info.st_mtim.tv_nsec;
+#else
+    *time = (uint64)info.st_mtime * 1000000000ull;
+#endif
+    *size = info.st_size;
+    return true;
+}
+
+bool32 hashFile(AvString path, uint64* hash, uint64* time){
+    *hash = hashString(path, *hash);
+    uint64 size = 0;
+    if(!fileStatus(path, time, &size)){
+        return false;
+    }
+    *hash = hashBytes(time, sizeof(uint64), *hash);
+    *hash = hashBytes(&size, sizeof(uint64), *hash);
+    return true;
+}
+
+static struct BuildRecord* findEntry(uint64 key){
+    uint64 mask = database.capacity - 1;
+    for(uint64 i = key & mask;; i = (i + 1) & mask){
+        struct BuildRecord* entry = database.entries + i;
+        if(entry->key == key || entry->key == 0){
+            return entry;
+        }
+    }
+}
+
+static void insertEntry(struct BuildRecord record){
+    if((database.entryCount + 1) * 2 > database.capacity){
+        struct BuildRecord* entries = database.entries;
+        uint64 capacity = database.capacity;
+        database.capacity = capacity ? capacity * 2 : 1024;
+        database.entries = avCallocate(database.capacity, sizeof(struct BuildRecord), "build database");
+        for(uint64 i = 0; i < capacity; i++){
+            if(entries[i].key){
+                memcpy(findEntry(entries[i].key), entries + i, sizeof(struct BuildRecord));
+            }
+        }
+        if(entries){
+            avFree(entries);
+        }
+    }
+    struct BuildRecord* entry = findEntry(record.key);
+    if(entry->key == 0){
+        database.entryCount++;
+    }
+    memcpy(entry, &record, sizeof(struct BuildRecord));
+}
+
+static struct DependencyEntry* findDependencyEntry(uint64 key){
+    uint64 mask = dependencyDatabase.capacity - 1;
+    for(uint64 i = key & mask;; i = (i + 1) & mask){
+        struct DependencyEntry* entry = dependencyDatabase.entries + i;
+        if(entry->header.key == key || entry->header.key == 0){
+            return entry;
+        }
+    }
+}
+
+static void insertDependencyEntry(struct DependencyEntry dependencyEntry){
+    if((dependencyDatabase.entryCount + 1) * 2 > dependencyDatabase.capacity){
+        struct DependencyEntry* entries = dependencyDatabase.entries;
+        uint64 capacity = dependencyDatabase.capacity;
+        dependencyDatabase.capacity = capacity ? capacity * 2 : 1024;
+        dependencyDatabase.entries = avCallocate(dependencyDatabase.capacity, sizeof(struct DependencyEntry), "dependency database");
+        for(uint64 i = 0; i < capacity; i++){
+            if(entries[i].header.key){
+                memcpy(findDependencyEntry(entries[i].header.key), entries + i, sizeof(struct DependencyEntry));
+            }
+        }
+        if(entries){
+            avFree(entries);
+        }
+    }
+    struct DependencyEntry* entry = findDependencyEntry(dependencyEntry.header.key);
+    if(entry->header.key == 0){
+        dependencyDatabase.entryCount++;
+    }else if(entry->owned){
+        avFree((char*)entry->paths);
+    }
+    memcpy(entry, &dependencyEntry, sizeof(struct DependencyEntry));
+}
+
+#ifndef _WIN32
+static bool32 writeHeader(int fd, uint32 magic, uint32 version){
+    struct BuildDatabaseHeader header = {
+        .magic = magic,
+        .version = version,
+    };
+    return write(fd, &header, sizeof(header)) == sizeof(header);
+}
+
+static void compactDatabase(){
+    char tmpFile[PATH_MAX];
+    char databaseFile[PATH_MAX];
+    workspacePath(tmpFile, sizeof(tmpFile), BUILD_DATABASE_DIR "/db.tmp");
+    workspacePath(databaseFile, sizeof(databaseFile), BUILD_DATABASE_FILE);
+    int fd = open(tmpFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1){
+        return;
+    }
+    bool32 success = writeHeader(fd, BUILD_DATABASE_MAGIC, BUILD_DATABASE_VERSION);
+    for(uint64 i = 0; i < database.capacity && success; i++){
+        if(database.entries[i].key){
+            success = write(fd, database.entries + i, sizeof(struct BuildRecord)) == sizeof(struct BuildRecord);
+        }
+    }
+    close(fd);
+    if(!success || rename(tmpFile, databaseFile) != 0){
+        unlink(tmpFile);
+    }
+}
+
+static void compactDependencyDatabase(){
+    char tmpFile[PATH_MAX];
+    char databaseFile[PATH_MAX];
+    workspacePath(tmpFile, sizeof(tmpFile), BUILD_DATABASE_DIR "/deps.tmp");
+    workspacePath(databaseFile, sizeof(databaseFile), DEPENDENCY_DATABASE_FILE);
+    int fd = open(tmpFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1){
+        return;
+    }
+    bool32 success = writeHeader(fd, DEPENDENCY_DATABASE_MAGIC, DEPENDENCY_DATABASE_VERSION);
+    for(uint64 i = 0; i < dependencyDatabase.capacity && success; i++){
+        struct DependencyEntry* entry = dependencyDatabase.entries + i;
+        if(entry->header.key){
+            success = write(fd, &entry->header, sizeof(struct DependencyRecordHeader)) == sizeof(struct DependencyRecordHeader)
+                && write(fd, entry->paths, entry->header.size) == entry->header.size;
+        }
+    }
+    close(fd);
+    if(!success || rename(tmpFile, databaseFile) != 0){
+        unlink(tmpFile);
+    }
+}
+
+static void openDependencyDatabase(){
+    char databaseFile[PATH_MAX];
+    workspacePath(databaseFile, sizeof(databaseFile), DEPENDENCY_DATABASE_FILE);
+    int fd = open(databaseFile, O_RDWR | O_CREAT, 0644);
+    if(fd == -1){
+        return;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0){
+        close(fd);
+        return;
+    }
+
+    uint64 size = info.st_size;
+    uint64 validSize = 0;
+    uint64 recordCount = 0;
+    if(size >= sizeof(struct BuildDatabaseHeader)){
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data != MAP_FAILED){
+            const struct BuildDatabaseHeader* header = data;
+            if(header->magic == DEPENDENCY_DATABASE_MAGIC && header->version == DEPENDENCY_DATABASE_VERSION){
+                // the paths stay in the mapping, only the index is built here
+                dependencyDatabase.mapping = data;
+                dependencyDatabase.mappingSize = size;
+                uint64 offset = sizeof(struct BuildDatabaseHeader);
+                while(offset + sizeof(struct DependencyRecordHeader) <= size){
+                    struct DependencyEntry entry = {0};
+                    memcpy(&entry.header, (const char*)data + offset, sizeof(struct DependencyRecordHeader));
+                    uint64 end = offset + sizeof(struct DependencyRecordHeader) + entry.header.size;
+                    if(end > size || entry.header.key == 0){
+                        break;
+                    }
+                    entry.paths = (const char*)data + offset + sizeof(struct DependencyRecordHeader);
+                    insertDependencyEntry(entry);
+                    offset = end;
+                    recordCount++;
+                }
+                validSize = offset;
+            }else{
+                munmap(data, size);
+            }
+        }
+    }
+
+    if(validSize == 0){
+        // unknown or damaged database, start over
+        if(ftruncate(fd, 0) != 0 || !writeHeader(fd, DEPENDENCY_DATABASE_MAGIC, DEPENDENCY_DATABASE_VERSION)){
+            close(fd);
+            return;
+        }
+    }else if(validSize != size){
+        // drop a record that was only partially written
+        if(ftruncate(fd, validSize) != 0){
+            close(fd);
+            return;
+        }
+    }
+
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_APPEND);
+    dependencyDatabase.fd = fd;
+    dependencyDatabase.recordCount = recordCount;
+}
+#endif
+
+void buildDatabaseOpen(){
+#ifndef _WIN32
+    char databaseFile[PATH_MAX];
+    workspacePath(databaseFile, sizeof(databaseFile), BUILD_DATABASE_DIR);
+    if(mkdir(databaseFile, 0755) != 0 && errno != EEXIST){
+        return;
+    }
+    workspacePath(databaseFile, sizeof(databaseFile), BUILD_DATABASE_FILE);
+    int fd = open(databaseFile, O_RDWR | O_CREAT, 0644);
+    if(fd == -1){
+        return;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0){
+        close(fd);
+        return;
+    }
+
+    uint64 size = info.st_size;
+    uint64 recordCount = 0;
+    bool32 valid = false;
+    if(size >= sizeof(struct BuildDatabaseHeader)){
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data != MAP_FAILED){
+            const struct BuildDatabaseHeader* header = data;
+            valid = header->magic == BUILD_DATABASE_MAGIC && header->version == BUILD_DATABASE_VERSION;
+            if(valid){
+                recordCount = (size - sizeof(struct BuildDatabaseHeader)) / sizeof(struct BuildRecord);
+                const struct BuildRecord* records = (const struct BuildRecord*)(header + 1);
+                for(uint64 i = 0; i < recordCount; i++){
+                    insertEntry(records[i]);
+                }
+            }
+            munmap(data, size);
+        }
+    }
+
+    uint64 validSize = sizeof(struct BuildDatabaseHeader) + recordCount * sizeof(struct BuildRecord);
+    if(!valid){
+        // unknown or damaged database, start over
+        if(ftruncate(fd, 0) != 0 || !writeHeader(fd, BUILD_DATABASE_MAGIC, BUILD_DATABASE_VERSION)){
+            close(fd);
+            return;
+        }
+    }else if(validSize != size){
+        // drop a record that was only partially written
+        if(ftruncate(fd, validSize) != 0){
+            close(fd);
+            return;
+        }
+    }
+
+    // records are only ever appended
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_APPEND);
+    database.fd = fd;
+    database.recordCount = recordCount;
+
+    openDependencyDatabase();
+#endif
+}
+
+void buildDatabaseClose(){
+#ifndef _WIN32
+    if(database.fd != -1){
+        close(database.fd);
+        if(database.recordCount > BUILD_DATABASE_COMPACT_THRESHOLD && database.recordCount > database.entryCount * 2){
+            compactDatabase();
+        }
+    }
+#endif
+    if(database.entries){
+        avFree(database.entries);
+    }
+    memset(&database, 0, sizeof(struct BuildDatabase));
+    database.fd = -1;
+
+#ifndef _WIN32
+    if(dependencyDatabase.fd != -1){
+        close(dependencyDatabase.fd);
+        if(dependencyDatabase.recordCount > BUILD_DATABASE_COMPACT_THRESHOLD && dependencyDatabase.recordCount > dependencyDatabase.entryCount * 2){
+            compactDependencyDatabase();
+        }
+    }
+    if(dependencyDatabase.mapping){
+        munmap(dependencyDatabase.mapping, dependencyDatabase.mappingSize);
+    }
+#endif
+    for(uint64 i = 0; i < dependencyDatabase.capacity; i++){
+        if(dependencyDatabase.entries[i].owned){
+            avFree((char*)dependencyDatabase.entries[i].paths);
+        }
+    }
+    if(dependencyDatabase.entries){
+        avFree(dependencyDatabase.entries);
+    }
+    memset(&dependencyDatabase, 0, sizeof(struct DependencyDatabase));
+    dependencyDatabase.fd = -1;
+}
+
+bool32 buildDatabaseFind(uint64 key, struct BuildRecord* record){
+    if(database.entryCount == 0){
+        return false;
+    }
+    struct BuildRecord* entry = findEntry(key ? key : 1);
+    if(entry->key == 0){
+        return false;
+    }
+    memcpy(record, entry, sizeof(struct BuildRecord));
+    return true;
+}
+
+void buildDatabaseRecord(struct BuildRecord record){
+    if(database.fd == -1){
+        return;
+    }
+    // 0 marks an empty slot
+    record.key = record.key ? record.key : 1;
+    struct BuildRecord existing;
+    if(buildDatabaseFind(record.key, &existing) && memcmp(&existing, &record, sizeof(struct BuildRecord)) == 0){
+        return;
+    }
+    insertEntry(record);
+#ifndef _WIN32
+    if(write(database.fd, &record, sizeof(struct BuildRecord)) == sizeof(struct BuildRecord)){
+        database.recordCount++;
+    }
+#endif
+}
+
+bool32 buildDatabaseFindDependencies(uint64 key, const char** paths, uint32* count){
+    if(dependencyDatabase.entryCount == 0){
+        return false;
+    }
+    struct DependencyEntry* entry = findDependencyEntry(key ? key : 1);
+    if(entry->header.key == 0){
+        return false;
+    }
+    *paths = entry->paths;
+    *count = entry->header.count;
+    return true;
+}
+
+void buildDatabaseRecordDependencies(uint64 key, uint32 count, AvString* dependencies){
+    if(dependencyDatabase.fd == -1){
+        return;
+    }
+    uint64 size = 0;
+    for(uint32 i = 0; i < count; i++){
+        size += dependencies[i].len + 1;
+    }
+    size = (size + 7) & ~7ull;
+
+    char* paths = avCallocate(size ? size : 1, 1, "dependencies");
+    char* path = paths;
+    for(uint32 i = 0; i < count; i++){
+        memcpy(path, dependencies[i].chrs, dependencies[i].len);
+        path += dependencies[i].len + 1;
+    }
+
+    struct DependencyEntry entry = {
+        .header = {
+            .key = key ? key : 1,
+            .count = count,
+            .size = size,
+        },
+        .paths = paths,
+        .owned = true,
+    };
+
+    const char* previousPaths = nullptr;
+    uint32 previousCount = 0;
+    if(buildDatabaseFindDependencies(entry.header.key, &previousPaths, &previousCount)){
+        struct DependencyEntry* previous = findDependencyEntry(entry.header.key);
+        if(previous->header.count == count && previous->header.size == size && memcmp(previousPaths, paths, size) == 0){
+            avFree(paths);
+            return;
+        }
+    }
+
+#ifndef _WIN32
+    if(write(dependencyDatabase.fd, &entry.header, sizeof(struct DependencyRecordHeader)) == sizeof(struct DependencyRecordHeader)
+        && write(dependencyDatabase.fd, paths, size) == size){
+        dependencyDatabase.recordCount++;
+    }
+#endif
+    insertDependencyEntry(entry);
+}
+
+void commitCommandBuild(const struct CommandBuild* build){
+    struct BuildRecord record = build->record;
+    if(build->depfile){
+        uint64 size = 0;
+        char* data = readDepfile(build->depfile, &size);
+        if(data == nullptr){
+            return;
+        }
+        AV_DS(AvDynamicArray, AvString) dependencies = AV_EMPTY;
+        avDynamicArrayCreate(0, sizeof(AvString), &dependencies);
+        if(!parseDepfile(data, size, dependencies)){
+            avDynamicArrayDestroy(dependencies);
+            avFree(data);
+            return;
+        }
+        avDynamicArrayMakeContiguous(dependencies);
+        uint32 count = avDynamicArrayGetSize(dependencies);
+        AvString* paths = count ? avDynamicArrayGetPageDataPtr(0, dependencies) : nullptr;
+        buildDatabaseRecordDependencies(record.key, count, paths);
+        // must match the order in which the dependencies are hashed when checking the command
+        for(uint32 i = 0; i < count; i++){
+            uint64 time = 0;
+            hashFile(paths[i], &record.inputHash, &time);
+        }
+        avDynamicArrayDestroy(dependencies);
+        avFree(data);
+    }
+    buildDatabaseRecord(record);
+    actionCacheStore(build);
+}
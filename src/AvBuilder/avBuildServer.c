@@ -0,0 +1,453 @@
+// sigaction, MSG_NOSIGNAL, the SCM_RIGHTS helpers, environ and clearenv are not part of strict c11
+#define _GNU_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <AvUtils/dataStructures/avDynamicArray.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#define BUILD_SERVER_MAGIC 0x52455653766158ull // "XavSERV"
+#define BUILD_SERVER_VERSION 2
+// the client hands its standard input, output and error to the server, commands write to them directly
+#define BUILD_SERVER_STREAM_COUNT 3
+
+// followed by the null terminated project file and arguments, and the environment of the client
+struct BuildServerRequest {
+    uint64 magic;
+    uint32 version;
+    uint32 argumentCount;
+    uint32 environmentCount;
+    uint64 size;
+};
+
+#ifndef _WIN32
+static volatile sig_atomic_t serverStopped = 0;
+
+static void stopServer(int signal){
+    serverStopped = 1;
+}
+
+// writing to a client that went away fails instead of ending the server. A handler is used instead of
+// ignoring the signal, ignored signals would be inherited by the commands
+static void ignoreSignal(int signal){
+}
+
+static bool32 readAll(int fd, void* data, uint64 size){
+    char* bytes = data;
+    while(size){
+        ssize_t received = read(fd, bytes, size);
+        if(received <= 0){
+            if(received < 0 && errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+static bool32 writeAll(int fd, const void* data, uint64 size){
+    const char* bytes = data;
+    while(size){
+        ssize_t written = send(fd, bytes, size, MSG_NOSIGNAL);
+        if(written <= 0){
+            if(written < 0 && errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool32 serverAddress(struct sockaddr_un* address){
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    if(sizeof(BUILD_SERVER_SOCKET) > sizeof(address->sun_path)){
+        return false;
+    }
+    memcpy(address->sun_path, BUILD_SERVER_SOCKET, sizeof(BUILD_SERVER_SOCKET));
+    return true;
+}
+
+static int connectServer(){
+    struct sockaddr_un address;
+    if(!serverAddress(&address)){
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1){
+        return -1;
+    }
+    if(connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct ServerState {
+    uint32 jobCount;
+    uint64 cacheSize;
+    int workingDir;     // requests changing the directory are put back here
+    uint32 environmentCount;
+    char** environment; // of the server itself, restored after every request
+};
+
+// replaces the environment with count NAME=value strings, setenv copies them
+static void setEnvironment(uint32 count, char** variables){
+    clearenv();
+    for(uint32 i = 0; i < count; i++){
+        char* separator = strchr(variables[i], '=');
+        if(separator == nullptr || separator == variables[i]){
+            continue;
+        }
+        *separator = '\0';
+        setenv(variables[i], separator + 1, 1);
+        *separator = '=';
+    }
+}
+
+static void saveEnvironment(struct ServerState* state){
+    uint32 count = 0;
+    while(environ[count]){
+        count++;
+    }
+    state->environmentCount = count;
+    state->environment = avAllocate(sizeof(char*) * (count + 1), "server environment");
+    for(uint32 i = 0; i < count; i++){
+        uint64 length = strlen(environ[i]) + 1;
+        state->environment[i] = avAllocate(length, "server environment");
+        memcpy(state->environment[i], environ[i], length);
+    }
+    state->environment[count] = nullptr;
+}
+
+static void freeEnvironment(struct ServerState* state){
+    for(uint32 i = 0; i < state->environmentCount; i++){
+        avFree(state->environment[i]);
+    }
+    avFree(state->environment);
+}
+
+// whatever a request changed of the process is put back before the next one
+static void restoreServer(struct ServerState* state){
+    setEnvironment(state->environmentCount, state->environment);
+    if(fchdir(state->workingDir) != 0){
+        printf("unable to return to the directory of the server\n");
+    }
+}
+
+// runs one request with the standard streams of the client
+static uint32 serveRequest(struct ServerState* state, AvString projectFilePath, AvDynamicArray arguments){
+    struct ProjectOptions options = {0};
+    if(!parseProjectOptions(&options, arguments)){
+        return -1;
+    }
+    if(options.jobCount != state->jobCount){
+        jobPoolDestroy();
+        jobPoolCreate(options.jobCount);
+        state->jobCount = options.jobCount;
+    }
+    if(options.cacheSize != state->cacheSize){
+        actionCacheClose();
+        actionCacheOpen(options.cacheSize * 1024 * 1024);
+        state->cacheSize = options.cacheSize;
+    }
+
+    if(options.trace.len){
+        traceOpen(options.trace);
+    }
+    // project files changed since the last request are loaded again
+    moduleRegistryRefresh();
+    uint64 key = 0;
+    Project* project = moduleRegistryLoad(projectFilePath, &key);
+    if(project == nullptr){
+        traceClose();
+        return -1;
+    }
+    moduleRegistryPrefetch(project);
+    if(options.profile.len){
+        profileOpen();
+    }
+    uint64 traceStarted = traceStart();
+    uint32 result = runModule(key, &options, arguments);
+    traceSpan("project", AV_CSTR("run"), projectFilePath, traceStarted);
+    profileClose(options.profile);
+    traceClose();
+
+    // listings read by this request are reused by the next one
+    directoryCacheClose();
+    directoryCacheOpen(DIRECTORY_CACHE_FILE);
+    return result;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wjump-misses-init"
+static void handleClient(struct ServerState* state, int client){
+    struct BuildServerRequest request = {0};
+    int streams[BUILD_SERVER_STREAM_COUNT];
+    char control[CMSG_SPACE(sizeof(streams))];
+    struct iovec vector = {
+        .iov_base = &request,
+        .iov_len = sizeof(request),
+    };
+    struct msghdr message = {
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    ssize_t received = recvmsg(client, &message, MSG_CMSG_CLOEXEC);
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if(header == nullptr || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS
+        || header->cmsg_len != CMSG_LEN(sizeof(streams))){
+        return;
+    }
+    memcpy(streams, CMSG_DATA(header), sizeof(streams));
+
+    char* payload = nullptr;
+    int32 result = -1;
+    if(received != sizeof(request) || request.magic != BUILD_SERVER_MAGIC || request.version != BUILD_SERVER_VERSION
+        || request.argumentCount == 0 || request.size == 0){
+        goto invalidRequest;
+    }
+    payload = avAllocate(request.size, "build server request");
+    if(!readAll(client, payload, request.size) || payload[request.size - 1] != '\0'){
+        goto invalidRequest;
+    }
+
+    AvDynamicArray arguments = NULL;
+    avDynamicArrayCreate(request.argumentCount, sizeof(AvString), &arguments);
+    AvString projectFilePath = AV_CSTR(payload);
+    char* at = payload + projectFilePath.len + 1;
+    for(uint32 i = 1; i < request.argumentCount && at < payload + request.size; i++){
+        AvString argument = AV_CSTR(at);
+        avDynamicArrayAdd(&argument, arguments);
+        at += argument.len + 1;
+    }
+    char** environment = avAllocate(sizeof(char*) * (request.environmentCount + 1), "client environment");
+    uint32 environmentCount = 0;
+    while(environmentCount < request.environmentCount && at < payload + request.size){
+        environment[environmentCount++] = at;
+        at += strlen(at) + 1;
+    }
+    avStringPrintf(AV_CSTR("Running %s\n"), projectFilePath);
+    fflush(stdout);
+
+    int saved[BUILD_SERVER_STREAM_COUNT];
+    for(uint32 i = 0; i < BUILD_SERVER_STREAM_COUNT; i++){
+        saved[i] = dup(i);
+        dup2(streams[i], i);
+    }
+    setEnvironment(environmentCount, environment);
+    result = serveRequest(state, projectFilePath, arguments);
+    restoreServer(state);
+    fflush(stdout);
+    fflush(stderr);
+    for(uint32 i = 0; i < BUILD_SERVER_STREAM_COUNT; i++){
+        dup2(saved[i], i);
+        close(saved[i]);
+    }
+    avFree(environment);
+    avDynamicArrayDestroy(arguments);
+    avStringPrintf(AV_CSTR("Finished %s with %i\n"), projectFilePath, result);
+    fflush(stdout);
+    writeAll(client, &result, sizeof(result));
+
+invalidRequest:
+    if(payload){
+        avFree(payload);
+    }
+    for(uint32 i = 0; i < BUILD_SERVER_STREAM_COUNT; i++){
+        close(streams[i]);
+    }
+}
+#pragma GCC diagnostic pop
+#endif
+
+// keeps the projects, the caches and the job pool of the workspace in the working directory loaded and
+// runs the projects clients ask for, one after the other
+uint32 runBuildServer(AvDynamicArray arguments){
+#ifndef _WIN32
+    struct ProjectOptions options = {0};
+    if(!parseProjectOptions(&options, arguments)){
+        return -1;
+    }
+
+    int existing = connectServer();
+    if(existing != -1){
+        close(existing);
+        printf("a build server is already running in this directory\n");
+        return -1;
+    }
+    struct sockaddr_un address;
+    if(!serverAddress(&address)){
+        return -1;
+    }
+    workspaceOpen();
+    buildDatabaseOpen();
+    // a server that did not shut down cleanly leaves its socket behind
+    unlink(BUILD_SERVER_SOCKET);
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listener == -1 || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 16) != 0){
+        printf("unable to listen on %s\n", BUILD_SERVER_SOCKET);
+        if(listener != -1){
+            close(listener);
+        }
+        buildDatabaseClose();
+        return -1;
+    }
+
+    struct sigaction action = {0};
+    sigemptyset(&action.sa_mask);
+    struct sigaction previousInterrupt;
+    struct sigaction previousTerminate;
+    struct sigaction previousPipe;
+    action.sa_handler = stopServer;
+    sigaction(SIGINT, &action, &previousInterrupt);
+    sigaction(SIGTERM, &action, &previousTerminate);
+    action.sa_handler = ignoreSignal;
+    sigaction(SIGPIPE, &action, &previousPipe);
+
+    directoryCacheOpen(DIRECTORY_CACHE_FILE);
+    actionCacheOpen(options.cacheSize * 1024 * 1024);
+    jobPoolCreate(options.jobCount);
+    struct ServerState state = {
+        .jobCount = options.jobCount,
+        .cacheSize = options.cacheSize,
+        .workingDir = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC),
+    };
+    saveEnvironment(&state);
+    printf("Serving builds on %s\n", BUILD_SERVER_SOCKET);
+    fflush(stdout);
+
+    while(!serverStopped){
+        struct pollfd descriptor = {
+            .fd = listener,
+            .events = POLLIN,
+        };
+        if(poll(&descriptor, 1, -1) <= 0){
+            continue;
+        }
+        int client = accept(listener, nullptr, nullptr);
+        if(client == -1){
+            continue;
+        }
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+        handleClient(&state, client);
+        close(client);
+    }
+
+    close(listener);
+    unlink(BUILD_SERVER_SOCKET);
+    freeEnvironment(&state);
+    if(state.workingDir != -1){
+        close(state.workingDir);
+    }
+    moduleRegistryClear();
+    commandTemplatesClear();
+    jobPoolDestroy();
+    actionCacheClose();
+    directoryCacheClose();
+    fileWalkPoolDestroy();
+    buildDatabaseClose();
+    sigaction(SIGINT, &previousInterrupt, nullptr);
+    sigaction(SIGTERM, &previousTerminate, nullptr);
+    sigaction(SIGPIPE, &previousPipe, nullptr);
+    return 0;
+#else
+    printf("the build server is not supported on this platform\n");
+    return -1;
+#endif
+}
+
+// hands the project to the build server of the working directory if one is running, returns false
+// when the project has to be run here
+bool32 buildServerForward(const int argC, const char* argV[], uint32* result){
+#ifndef _WIN32
+    int server = connectServer();
+    if(server == -1){
+        return false;
+    }
+    uint32 environmentCount = 0;
+    uint64 size = 0;
+    for(int i = 0; i < argC; i++){
+        size += strlen(argV[i]) + 1;
+    }
+    for(; environ[environmentCount]; environmentCount++){
+        size += strlen(environ[environmentCount]) + 1;
+    }
+    char* payload = avAllocate(size, "build server request");
+    char* at = payload;
+    for(int i = 0; i < argC; i++){
+        uint64 length = strlen(argV[i]) + 1;
+        memcpy(at, argV[i], length);
+        at += length;
+    }
+    for(uint32 i = 0; i < environmentCount; i++){
+        uint64 length = strlen(environ[i]) + 1;
+        memcpy(at, environ[i], length);
+        at += length;
+    }
+
+    struct BuildServerRequest request = {
+        .magic = BUILD_SERVER_MAGIC,
+        .version = BUILD_SERVER_VERSION,
+        .argumentCount = argC,
+        .environmentCount = environmentCount,
+        .size = size,
+    };
+    int streams[BUILD_SERVER_STREAM_COUNT] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(streams))];
+    memset(control, 0, sizeof(control));
+    struct iovec vector = {
+        .iov_base = &request,
+        .iov_len = sizeof(request),
+    };
+    struct msghdr message = {
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(streams));
+    memcpy(CMSG_DATA(header), streams, sizeof(streams));
+
+    fflush(stdout);
+    bool32 sent = sendmsg(server, &message, MSG_NOSIGNAL) == sizeof(request) && writeAll(server, payload, size);
+    avFree(payload);
+    if(!sent){
+        // nothing ran yet
+        close(server);
+        return false;
+    }
+    int32 code = -1;
+    if(!readAll(server, &code, sizeof(code))){
+        printf("lost the connection to the build server\n");
+    }
+    close(server);
+    *result = code;
+    return true;
+#else
+    return false;
+#endif
+}
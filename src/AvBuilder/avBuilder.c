@@ -39,29 +39,174 @@ const uint32 punctuatorCount = sizeof(punctuators)/sizeof(AvString);
 
 const AvString configPath = AV_CSTRA(".config/AvBuilder/");  
 const AvString templatePath = AV_CSTRA("templates/"); 
+#define TEMPLATE_DIRECTORY_CACHE_FILE "dirs"
+
+// digits only, so script arguments that merely start like an option are left alone
+static bool32 parseOptionNumber(AvString digits, uint64* value){
+    if(digits.len == 0){
+        return false;
+    }
+    uint64 number = 0;
+    for(uint64 i = 0; i < digits.len; i++){
+        if(digits.chrs[i] < '0' || digits.chrs[i] > '9'){
+            return false;
+        }
+        number = number * 10 + (digits.chrs[i] - '0');
+    }
+    *value = number;
+    return true;
+}
+
+static bool32 optionValue(AvString argument, AvString flag, uint64* value){
+    AvString digits = {
+        .chrs = argument.chrs + flag.len,
+        .len = argument.len - flag.len,
+    };
+    if(!parseOptionNumber(digits, value)){
+        avStringPrintf(AV_CSTR("invalid value for %s: '%s'\n"), flag, digits);
+        return false;
+    }
+    return true;
+}
+
+// takes the project options out of the arguments, the rest is passed to the entry function. Returns false
+// when an option has an invalid value
+bool32 parseProjectOptions(struct ProjectOptions* options, AvDynamicArray arguments){
+    memset(options, 0, sizeof(struct ProjectOptions));
+    options->jobCount = 1;
+    options->cacheSize = 1024;
+    options->responseFileSize = 32;
+    avDynamicArraySetAllowRelocation(true, arguments);
+
+    for(uint32 i = 0; i < avDynamicArrayGetSize(arguments); i++){
+        AvString argument = AV_EMPTY;
+        avDynamicArrayRead(&argument, i, arguments);
+        AvString entryFlag = AV_CSTR("--entry=");
+        AvString commandDebugFlag = AV_CSTR("--debugCommands");
+        AvString teeOutputFlag = AV_CSTR("--teeOutput");
+        AvString jobsFlag = AV_CSTR("--jobs=");
+        AvString jobsShortFlag = AV_CSTR("-j");
+        AvString cacheSizeFlag = AV_CSTR("--cacheSize=");
+        AvString responseFileSizeFlag = AV_CSTR("--responseFileSize=");
+        AvString traceFlag = AV_CSTR("--trace=");
+        AvString profileFlag = AV_CSTR("--profile");
+        if(avStringStartsWith(argument, entryFlag)){
+            AvString entry = {
+                .chrs = argument.chrs + entryFlag.len,
+                .len = argument.len - entryFlag.len,
+            };
+            memcpy(&options->entry, &entry, sizeof(AvString));
+            avDynamicArrayRemove(i, arguments);
+            i--;
+        }
+        if(avStringEquals(argument, commandDebugFlag)){
+            options->commandDebug = true;
+            avDynamicArrayRemove(i, arguments);
+            i--;
+        }
+        if(avStringEquals(argument, teeOutputFlag)){
+            options->teeOutput = true;
+            avDynamicArrayRemove(i, arguments);
+            i--;
+        }
+        uint64 value = 0;
+        if(avStringStartsWith(argument, jobsFlag)){
+            if(!optionValue(argument, jobsFlag, &value)){
+                return false;
+            }
+            options->jobCount = value;
+            avDynamicArrayRemove(i, arguments);
+            i--;
+        }
+        if(avStringStartsWith(argument, jobsShortFlag) && parseOptionNumber((AvString){
+                .chrs = argument.chrs + jobsShortFlag.len,
+                .len = argument.len - jobsShortFlag.len,
+            }, &value)){
+            options->jobCount = value;
+            avDynamicArrayRemove(i, arguments);
+            i--;
+        }
+        if(avStringStartsWith(argument, cacheSizeFlag)){
+            if(!optionValue(argument, cacheSizeFlag, &value)){
+                return false;
+            }
+            options->cacheSize = value;
+            avDynamicArrayRemove(i, arguments);
+            i--;
+        }
+        if(avStringStartsWith(argument, responseFileSizeFlag)){
+            if(!optionValue(argument, responseFileSizeFlag, &value)){
+                return false;
+            }
+            options->responseFileSize = value;
+            avDynamicArrayRemove(i, arguments);
+            i--;
+        }
+        if(avStringStartsWith(argument, traceFlag)){
+            options->trace = (AvString){
+                .chrs = argument.chrs + traceFlag.len,
+                .len = argument.len - traceFlag.len,
+            };
+            avDynamicArrayRemove(i, arguments);
+            i--;
+        }
+        if(avStringEquals(argument, profileFlag)){
+            options->profile = AV_CSTR(PROFILE_DEFAULT_FILE);
+            avDynamicArrayRemove(i, arguments);
+            i--;
+        }
+        if(avStringStartsWith(argument, profileFlag) && argument.len > profileFlag.len + 1 && argument.chrs[profileFlag.len] == '='){
+            options->profile = (AvString){
+                .chrs = argument.chrs + profileFlag.len + 1,
+                .len = argument.len - profileFlag.len - 1,
+            };
+            avDynamicArrayRemove(i, arguments);
+            i--;
+        }
+        
+    }
+    return true;
+}
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wjump-misses-init"
-uint32 processProjectFile(const AvString projectFilePath, AvDynamicArray arguments){
+uint32 processProjectFile(const AvString projectFilePath, AvDynamicArray arguments, bool32 watch){
     avStringDebugContextStart;
     uint32 result = true;
 
+    // the options are known before loading, so the trace covers it
+    struct ProjectOptions options = {0};
+    if(!parseProjectOptions(&options, arguments)){
+        avStringDebugContextEnd;
+        return -1;
+    }
+    if(options.trace.len){
+        traceOpen(options.trace);
+    }
+    workspaceOpen();
+
     AvString projectFileContent = AV_EMPTY;
     AvString projectFileName = AV_EMPTY;
-    if(!loadProjectFile(projectFilePath, &projectFileContent, &projectFileName)){
+    uint64 traceStarted = traceStart();
+    bool32 loaded = loadProjectFile(projectFilePath, &projectFileContent, &projectFileName);
+    traceSpan("project", AV_CSTR("load"), projectFilePath, traceStarted);
+    if(!loaded){
         avStringPrintf(AV_CSTR("Failed to load project file %s\n"), projectFilePath);
         result = -1;
-        avStringFree(&projectFileContent);
+        unloadProjectFile(&projectFileContent);
         avStringFree(&projectFileName); 
         goto loadingFailed;
     }
 
     AV_DS(AvDynamicArray, Token) tokens = AV_EMPTY;
     avDynamicArrayCreate(0, sizeof(Token), &tokens);
-    if(!tokenizeProject(projectFileContent, projectFileContent, tokens)){
+    traceStarted = traceStart();
+    bool32 tokenized = tokenizeProject(projectFileContent, projectFileContent, tokens);
+    traceSpan("project", AV_CSTR("tokenize"), projectFilePath, traceStarted);
+    if(!tokenized){
         avStringPrintf(AV_CSTR("Failed to tokenize project file %s\n"), projectFilePath);
         result = -1;
-        avStringFree(&projectFileContent);
+        unloadProjectFile(&projectFileContent);
         avStringFree(&projectFileName); 
         goto tokenizingFailed;
     }
@@ -70,70 +215,133 @@ uint32 processProjectFile(const AvString projectFilePath, AvDynamicArray argumen
     Project project = AV_EMPTY;
     projectCreate(&project, projectFileName, projectFilePath, projectFileContent);
     struct ProjectStatementList* statements = nullptr;
-    if(!parseProject(tokens, (void**)&statements, &project)){
+    traceStarted = traceStart();
+    bool32 parsed = parseProject(tokens, (void**)&statements, &project);
+    traceSpan("project", AV_CSTR("parse"), projectFilePath, traceStarted);
+    if(!parsed){
         avStringPrintf(AV_CSTR("Failed to parse project file %s\n"), projectFilePath);
         result = -1;
         goto parsingFailed;
     }
     
-    if(!processProject(statements, &project)){
+    traceStarted = traceStart();
+    bool32 processed = processProject(statements, &project);
+    traceSpan("project", AV_CSTR("process"), projectFilePath, traceStarted);
+    if(!processed){
         avStringPrintf(AV_CSTR("Failed to perform processing on project file %s\n"), projectFilePath);
         result = -1;
         goto processingFailed;
     }
 
-    struct ProjectOptions options = {0};
-    avDynamicArraySetAllowRelocation(true, arguments);
-
-    for(uint32 i = 0; i < avDynamicArrayGetSize(arguments); i++){
-        AvString argument = AV_EMPTY;
-        avDynamicArrayRead(&argument, i, arguments);
-        AvString entryFlag = AV_CSTR("--entry=");
-        AvString commandDebugFlag = AV_CSTR("--debugCommands");
-        if(avStringStartsWith(argument, entryFlag)){
-            AvString entry = {
-                .chrs = argument.chrs + entryFlag.len,
-                .len = argument.len - entryFlag.len,
-            };
-            memcpy(&options.entry, &entry, sizeof(AvString));
-            avDynamicArrayRemove(i, arguments);
-            i--;
-        }
-        if(avStringEquals(argument, commandDebugFlag)){
-            options.commandDebug = true;
-            avDynamicArrayRemove(i, arguments);
-            i--;
-        }
-        
-    }
     memcpy(&project.options, &options, sizeof(struct ProjectOptions));
-    uint32 returnCode = runProject(&project, arguments);
+    buildDatabaseOpen();
+    directoryCacheOpen(DIRECTORY_CACHE_FILE);
+    actionCacheOpen(options.cacheSize * 1024 * 1024);
+    jobPoolCreate(options.jobCount);
+    moduleRegistryPrefetch(&project);
+    if(options.profile.len){
+        profileOpen();
+    }
+    traceStarted = traceStart();
+    uint32 returnCode = watch ? runProjectWatched(&project, arguments) : runProject(&project, arguments);
+    jobPoolDestroy();
+    traceSpan("project", AV_CSTR("run"), projectFilePath, traceStarted);
+    profileClose(options.profile);
+    actionCacheClose();
+    directoryCacheClose();
+    fileWalkPoolDestroy();
+    buildDatabaseClose();
     result = returnCode;
 
 processingFailed:
 parsingFailed:
     projectDestroy(&project);
+    moduleRegistryClear();
+    commandTemplatesClear();
 tokenizingFailed:
     avDynamicArrayDestroy(tokens);
 loadingFailed:
     avStringFree(&projectFileName);
+    traceClose();
     avStringDebugContextEnd;
     return result;
 }
 #pragma GCC diagnostic pop
 
+static void* growStack(void* data, uint32 count, uint32* capacity, uint64 elementSize, const char* message){
+    if(count < *capacity){
+        return data;
+    }
+    *capacity = *capacity ? *capacity * 2 : 16;
+    void* newData = avAllocate(elementSize * *capacity, message);
+    if(data){
+        memcpy(newData, data, elementSize * count);
+        avFree(data);
+    }
+    return newData;
+}
+
 void startLocalContext(struct Project* project, bool32 inherit){
-    LocalContext* context = avAllocate(sizeof(LocalContext), "local context");
-    context->previous = project->localContext;
-    avDynamicArrayCreate(0, sizeof(struct VariableDescription), &context->variables);
-    project->localContext = context;
-    context->inherit = inherit;
+    LocalContext* context = &project->localContext;
+    context->frames = growStack(context->frames, context->frameCount, &context->frameCapacity, sizeof(struct LocalFrame), "local frames");
+    context->frames[context->frameCount++] = (struct LocalFrame){
+        .base = context->variableCount,
+        .inherit = inherit,
+    };
 }
 void endLocalContext(struct Project* project){
-    LocalContext* context = project->localContext;
-    avDynamicArrayDestroy(context->variables);
-    project->localContext = context->previous;
-    avFree(context);
+    LocalContext* context = &project->localContext;
+    avAssert(context->frameCount, "no local context to end");
+    context->variableCount = context->frames[--context->frameCount].base;
+}
+
+// index of the first variable visible from the current frame
+uint32 localContextVisibleBase(struct Project* project){
+    LocalContext* context = &project->localContext;
+    uint32 frame = context->frameCount;
+    while(frame--){
+        if(!context->frames[frame].inherit){
+            return context->frames[frame].base;
+        }
+    }
+    return 0;
+}
+
+// the returned pointer is only valid until the next variable is added
+struct VariableDescription* findLocalVariable(AvString identifier, struct Project* project){
+    LocalContext* context = &project->localContext;
+    if(context->frameCount == 0){
+        return nullptr;
+    }
+    uint32 base = localContextVisibleBase(project);
+    for(uint32 i = context->variableCount; i > base; i--){
+        if(avStringEquals(identifier, context->variables[i - 1].identifier)){
+            return context->variables + i - 1;
+        }
+    }
+    return nullptr;
+}
+
+// only the variables of the innermost frame, not the ones it inherits
+struct VariableDescription* findFrameVariable(AvString identifier, struct Project* project){
+    LocalContext* context = &project->localContext;
+    if(context->frameCount == 0){
+        return nullptr;
+    }
+    uint32 base = context->frames[context->frameCount - 1].base;
+    for(uint32 i = context->variableCount; i > base; i--){
+        if(avStringEquals(identifier, context->variables[i - 1].identifier)){
+            return context->variables + i - 1;
+        }
+    }
+    return nullptr;
+}
+
+void addLocalVariable(struct VariableDescription description, struct Project* project){
+    LocalContext* context = &project->localContext;
+    avAssert(context->frameCount, "no local context to add to");
+    context->variables = growStack(context->variables, context->variableCount, &context->variableCapacity, sizeof(struct VariableDescription), "local variables");
+    context->variables[context->variableCount++] = description;
 }
 
 void projectCreate(struct Project* project, AvString name, AvString file, AvString content){
@@ -145,18 +353,28 @@ void projectCreate(struct Project* project, AvString name, AvString file, AvStri
     avDynamicArrayCreate(0, sizeof(struct ImportDescription), &project->libraryAliases);
     avDynamicArrayCreate(0, sizeof(Project*), &project->importedProjects);
     avDynamicArrayCreate(0, sizeof(struct ConstValue*), &project->arrays);
+    symbolTableCreate(&project->symbols);
     avStringClone(&project->name, name);
     memcpy(&project->projectFileContent, &content, sizeof(AvString));
     avStringClone(&project->projectFileName, file);
+    project->statementOwner = project;
     
-    project->localContext = NULL;
+    memset(&project->localContext, 0, sizeof(LocalContext));
 }
 void projectDestroy(struct Project* project){
+    forgetCachedValues(project);
     avDynamicArrayDestroy(project->variables);
     avDynamicArrayDestroy(project->constants);
     avDynamicArrayDestroy(project->functions);
     avDynamicArrayDestroy(project->externals);
     avDynamicArrayDestroy(project->libraryAliases);
+    symbolTableDestroy(&project->symbols);
+    if(project->localContext.variables){
+        avFree(project->localContext.variables);
+    }
+    if(project->localContext.frames){
+        avFree(project->localContext.frames);
+    }
     avDynamicArrayForEachElement(Project*, project->importedProjects, {
         projectDestroy(element);
     });
@@ -164,22 +382,35 @@ void projectDestroy(struct Project* project){
     avDynamicArrayDestroy(project->arrays);
     avAllocatorDestroy(&(project->allocator));
     avStringFree(&project->name);
-    avStringFree(&project->projectFileContent);
+    unloadProjectFile(&project->projectFileContent);
     avStringFree(&project->projectFileName); 
+    projectCacheRelease(project);
 }
 
 static uint32 printUsage(const int argC, const char* argV[]){
     printf("Usage: avBuilder (options) [project file] (args)\n\n");
     printf("Options:\n");
     printf("  [project file] [args]                 Specify a project file to be processed\n");
+    printf("  --server (project options)            Keep serving the projects run in this directory from a resident process\n");
+    printf("  watch [project file] [args]           Process a project file and again whenever one of its inputs changes\n");
     printf("  save [project file] (location)        Save the specified file to the local templates directory within the specified subdirectory\n");
     printf("  find [project file]                   Print the location of a saved project file\n");
     printf("  open [project file] [editor]          Opens the project file with a specified editor\n");
     printf("  remove [project file]                 Removes the specified project file\n");
     printf("  list                                  List the saved project files in the templates directory\n");
     printf("  help                                  Display this help message and exit\n");
+    printf("\nProject options:\n");
+    printf("  --entry=[function]                    Run the specified function instead of the default entry\n");
+    printf("  --debugCommands                       Print every executed command with its return code\n");
+    printf("  --teeOutput                           Print the output of commands captured into variables as well\n");
+    printf("  --jobs=[N], -j[N]                     Run commands issued from foreach loops on N parallel jobs (0 = number of cores)\n");
+    printf("  --cacheSize=[MB]                      Limit the size of the local action cache (default 1024, 0 = disabled)\n");
+    printf("  --trace=[file]                        Write a trace of the run to file, to be opened with chrome://tracing or Perfetto\n");
+    printf("  --profile(=[file])                    Print the time and memory spent in each script function, write folded stacks to file (default %s)\n", PROFILE_DEFAULT_FILE);
+    printf("  --responseFileSize=[KB]               Pass longer command lines of gcc, ld and ar in a response file (default 32, 0 = never)\n");
     printf("\nExamples:\n");
     printf("  avBuilder myproject.project                   Process the myproject.project project file\n");
+    printf("  avBuilder watch myproject.project             Rebuild myproject.project on every change until interrupted\n");
     printf("  avBuilder save myproject.project myproject    Saves the myproject.project file in the myproject subdirectory\n");
     printf("  avBuilder find myproject.project              Find the location of the myproject.project project file\n");
     printf("  avBuilder open myproject.project vim          Opens myproject.project with vim\n");
@@ -215,34 +446,39 @@ static void checkConfigFolder(){
     avStringDebugContextEnd;
 }
 
-static bool32 listInTree(AvPath path, AvString file, AvDynamicArray files){
-    bool32 ret=  false;
-    for(uint32 i = 0; i < path.contentCount; i++){
-        AvPathNode node = path.content[i];
-        if(node.type == AV_PATH_NODE_TYPE_FILE){
-            if(avStringEndsWith(node.fullName, file)){
-                AvString fileStr = AV_EMPTY;
-                avStringClone(&fileStr, node.fullName);
-                avDynamicArrayAdd(&fileStr, files);
-                ret = true;
-            }
-            continue;
-        }else if(node.type == AV_PATH_NODE_TYPE_DIRECTORY){
-            AvPath child = AV_EMPTY;
-            if(!avDirectoryOpen(node.name, &path, &child)){
-                continue;
-            }
-            if(listInTree(child, file, files)){
-                ret = true;
-            }
-            avDirectoryClose(&child);
-            continue;
-        }else{
-            continue;
+// walks the tree below directory, calling found for every file ending in file (or every file if file is empty)
+static bool32 walkTree(AvString directory, AvString file, void (*found)(AvString, void*), void* data){
+    struct FileWalk* walk = fileWalkCreate(true, false, file.len ? 1 : 0, &file);
+    fileWalkAdd(walk, directory);
+    fileWalkRun(walk);
+    uint32 failure = 0;
+    AvString failedDirectory = AV_EMPTY;
+    bool32 ret = !fileWalkNextFailure(walk, &failure, &failedDirectory);
+
+    uint64 size = 0;
+    uint32 count = fileWalkCount(walk, &size);
+    if(count){
+        char* block = avAllocate(size, "file names");
+        struct ConstValue* files = avAllocate(sizeof(struct ConstValue) * count, "files");
+        fileWalkWrite(walk, block, files);
+        for(uint32 i = 0; i < count; i++){
+            found(files[i].asString, data);
         }
+        avFree(files);
+        avFree(block);
     }
-    return ret;
+    fileWalkDestroy(walk);
+    return ret && (count || file.len == 0);
+}
+
+static void addFoundFile(AvString file, void* files){
+    AvString fileStr = AV_EMPTY;
+    avStringClone(&fileStr, file);
+    avDynamicArrayAdd(&fileStr, files);
+}
 
+static bool32 listInTree(AvString directory, AvString file, AvDynamicArray files){
+    return walkTree(directory, file, addFoundFile, files);
 }
 
 void freeString(void* data, uint64 size){
@@ -262,16 +498,10 @@ static uint32 openProject(const int argC, const char* argV[]){
         ret = -1;
         goto dirDoesNotExist;
     }
-    AvPath templates = AV_EMPTY;
-    if(!avDirectoryOpen(templatesDir, nullptr, &templates)){
-        avStringPrintf(AV_CSTR("Unable to find %s\n"), projectFile);
-        ret = -1;
-        goto unableToOpen;
-    }
     AvDynamicArray files = AV_EMPTY;
     avDynamicArrayCreate(0, sizeof(AvString), &files);
     avDynamicArraySetDeallocateElementCallback(freeString, files);
-    if(!listInTree(templates, projectFile, files)){
+    if(!listInTree(templatesDir, projectFile, files)){
         avStringPrintf(AV_CSTR("Unable to find %s\n"), projectFile);
         ret = -1;
         goto noFilesFound;
@@ -303,8 +533,6 @@ openFile:
     ret = system(buffer);
 noFilesFound:
     avDynamicArrayDestroy(files);
-unableToOpen:
-    avDirectoryClose(&templates);
 dirDoesNotExist:
     avStringFree(&templatesDir);
 
@@ -324,16 +552,10 @@ static uint32 removeProject(const int argC, const char* argV[]){
         ret = -1;
         goto dirDoesNotExist;
     }
-    AvPath templates = AV_EMPTY;
-    if(!avDirectoryOpen(templatesDir, nullptr, &templates)){
-        avStringPrintf(AV_CSTR("Unable to find %s\n"), projectFile);
-        ret = -1;
-        goto unableToOpen;
-    }
     AvDynamicArray files = AV_EMPTY;
     avDynamicArrayCreate(0, sizeof(AvString), &files);
     avDynamicArraySetDeallocateElementCallback(freeString, files);
-    if(!listInTree(templates, projectFile, files)){
+    if(!listInTree(templatesDir, projectFile, files)){
         avStringPrintf(AV_CSTR("Unable to find %s\n"), projectFile);
         ret = -1;
         goto noFilesFound;
@@ -362,8 +584,6 @@ openFile:
     ret = remove(fileStr.chrs);
 noFilesFound:
     avDynamicArrayDestroy(files);
-unableToOpen:
-    avDirectoryClose(&templates);
 dirDoesNotExist:
     avStringFree(&templatesDir);
 
@@ -450,37 +670,17 @@ openSrcFileFailed:
     return ret;
 }
 
-static bool32 findInTree(AvPath path, AvString file, uint32 offset){
-    bool32 ret=  false;
-    for(uint32 i = 0; i < path.contentCount; i++){
-        AvPathNode node = path.content[i];
-        if(node.type == AV_PATH_NODE_TYPE_FILE){
-            if(avStringEndsWith(node.fullName, file)){
-                AvString str = {
-                    .chrs = node.fullName.chrs + offset,
-                    .len = node.fullName.len - offset,
-                    .memory = nullptr,
-                };
-                avStringPrintln(str);
-                ret = true;
-            }
-            continue;
-        }else if(node.type == AV_PATH_NODE_TYPE_DIRECTORY){
-            AvPath child = AV_EMPTY;
-            if(!avDirectoryOpen(node.name, &path, &child)){
-                continue;
-            }
-            if(findInTree(child, file, offset)){
-                ret = true;
-            }
-            avDirectoryClose(&child);
-            continue;
-        }else{
-            continue;
-        }
-    }
-    return ret;
+static void printFoundFile(AvString file, void* offset){
+    AvString str = {
+        .chrs = file.chrs + *(uint32*)offset,
+        .len = file.len - *(uint32*)offset,
+        .memory = nullptr,
+    };
+    avStringPrintln(str);
+}
 
+static bool32 findInTree(AvString directory, AvString file, uint32 offset){
+    return walkTree(directory, file, printFoundFile, &offset);
 }
 
 static uint32 findProject(const int argC, const char* argV[]){
@@ -495,42 +695,22 @@ static uint32 findProject(const int argC, const char* argV[]){
         ret = -1;
         goto dirDoesNotExist;
     }
-    AvPath templates = AV_EMPTY;
-    if(!avDirectoryOpen(templatesDir, nullptr, &templates)){
-        avStringPrintf(AV_CSTR("Unable to find %s\n"), projectFile);
-        ret = -1;
-        goto unableToOpen;
-    }
-    if(!findInTree(templates, projectFile, templatesDir.len)){
+    if(!findInTree(templatesDir, projectFile, templatesDir.len)){
         avStringPrintf(AV_CSTR("Unable to find %s\n"), projectFile);
         ret = -1;
     }
-unableToOpen:
-    avDirectoryClose(&templates);
 dirDoesNotExist:
     avStringFree(&templatesDir);
     avStringDebugContextEnd;
     return ret;
 }
 
-static bool32 printTree(AvPath path){
-    for(uint32 i = 0; i < path.contentCount; i++){
-        AvPathNode node = path.content[i];
-        if(node.type == AV_PATH_NODE_TYPE_FILE){
-            avStringPrintf(AV_CSTR("%s\n"), node.fullName);
-        }else if(node.type == AV_PATH_NODE_TYPE_DIRECTORY){
-            AvPath child = AV_EMPTY;
-            if(!avDirectoryOpen(node.name, &path, &child)){
-                return false;
-            }
-            printTree(child);
-            avDirectoryClose(&child);
+static void printFile(AvString file, void* data){
+    avStringPrintf(AV_CSTR("%s\n"), file);
+}
 
-        }else{
-            continue;
-        }
-    }
-    return true;
+static bool32 printTree(AvString directory){
+    return walkTree(directory, (AvString)AV_EMPTY, printFile, nullptr);
 }
 
 static uint32 listProjects(const int argC, const char* argV[]){
@@ -543,19 +723,11 @@ static uint32 listProjects(const int argC, const char* argV[]){
         ret = 0;
         goto dirDoesNotExist;
     }
-    AvPath templates = AV_EMPTY;
-    if(!avDirectoryOpen(templatesDir, nullptr, &templates)){
-        ret = -1;
-        goto unableToOpen;
-    }
-
-    if(!printTree(templates)){
+    if(!printTree(templatesDir)){
         avStringPrintf(AV_CSTR("something went wrong enumerating files\n"));
         ret = -1;
     }
 
-unableToOpen:
-    avDirectoryClose(&templates);
 dirDoesNotExist:
     avStringFree(&templatesDir);
     avStringDebugContextEnd;
@@ -563,18 +735,62 @@ dirDoesNotExist:
 }
 
 static uint32 performProject(const int argC, const char* argV[]){
+    uint32 result = 0;
+    if(buildServerForward(argC, argV, &result)){
+        return result;
+    }
     AvDynamicArray arguments = NULL;
     avDynamicArrayCreate(argC, sizeof(AvString), &arguments);
     for(uint32 i = 1; i < argC; i++){
         AvString arg = AV_CSTR(argV[i]);
         avDynamicArrayAdd(&arg, arguments);
     }
-    uint32 result = processProjectFile(AV_CSTR(argV[0]), arguments);
+    result = processProjectFile(AV_CSTR(argV[0]), arguments, false);
+    avDynamicArrayDestroy(arguments);
+    avStringDebugContextEnd;
+    return result;
+}
+
+static uint32 serveProjects(const int argC, const char* argV[]){
+    avStringDebugContextStart;
+    AvDynamicArray arguments = NULL;
+    avDynamicArrayCreate(argC + 1, sizeof(AvString), &arguments);
+    for(uint32 i = 0; i < argC; i++){
+        AvString arg = AV_CSTR(argV[i]);
+        avDynamicArrayAdd(&arg, arguments);
+    }
+    uint32 result = runBuildServer(arguments);
     avDynamicArrayDestroy(arguments);
     avStringDebugContextEnd;
     return result;
 }
 
+// keeps the project loaded and runs it again whenever one of its inputs changes
+static uint32 watchProject(const int argC, const char* argV[]){
+    avStringDebugContextStart;
+    if(!watchOpen()){
+        printf("watching for changes is not supported on this platform\n");
+        avStringDebugContextEnd;
+        return -1;
+    }
+    uint32 result = 0;
+    do{
+        AvDynamicArray arguments = NULL;
+        avDynamicArrayCreate(argC, sizeof(AvString), &arguments);
+        for(uint32 i = 1; i < argC; i++){
+            AvString arg = AV_CSTR(argV[i]);
+            avDynamicArrayAdd(&arg, arguments);
+        }
+        // watched before loading, a project file that fails to load is tried again once it changes
+        watchProjectFile(AV_CSTR(argV[0]));
+        result = processProjectFile(AV_CSTR(argV[0]), arguments, true);
+        avDynamicArrayDestroy(arguments);
+    }while(watchWait());
+    watchClose();
+    avStringDebugContextEnd;
+    return result;
+}
+
 const struct Option{
     AvString tag;
     uint32 (*execute)(const int, const char*[]);
@@ -599,6 +815,17 @@ int main(int argC, const char* argV[]){
     }
 
     AvString option = AV_CSTR(argV[1]);
+    if(avStringEquals(option, AV_CSTR("--server"))){
+        return serveProjects(argC-2, argV+2);
+    }
+    if(avStringEquals(option, AV_CSTR("watch"))){
+        if(argC < 3){
+            printf("not enough arguments specified\n");
+            printUsage(argC, argV);
+            return -1;
+        }
+        return watchProject(argC-2, argV+2);
+    }
     for(uint32 i = 0; i < (sizeof(options)/sizeof(struct Option)); i++){
         if(avStringEquals(options[i].tag, option)){
             if(argC < 2 + options[i].argCount){
@@ -606,7 +833,18 @@ int main(int argC, const char* argV[]){
                 printUsage(argC, argV);
                 return -1;
             }
-            return options[i].execute(argC-2, argV+2);
+            // the template commands keep their own directory cache next to the templates
+            AvString cacheFile = AV_EMPTY;
+            getInConfigFolder(&cacheFile, (AvString)AV_EMPTY);
+            char cacheFileName[cacheFile.len + sizeof(TEMPLATE_DIRECTORY_CACHE_FILE)];
+            memset(cacheFileName, 0, sizeof(cacheFileName));
+            avStringPrintfToBuffer(cacheFileName, sizeof(cacheFileName) - 1, AV_CSTR("%s" TEMPLATE_DIRECTORY_CACHE_FILE), cacheFile);
+            avStringFree(&cacheFile);
+            directoryCacheOpen(cacheFileName);
+            uint32 result = options[i].execute(argC-2, argV+2);
+            directoryCacheClose();
+            fileWalkPoolDestroy();
+            return result;
         }
     }
     return performProject(argC-1, argV+1);
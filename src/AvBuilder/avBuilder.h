@@ -4,6 +4,7 @@
 #include <AvUtils/avString.h>
 #include <AvUtils/dataStructures/avDynamicArray.h>
 #include <AvUtils/memory/avAllocator.h>
+#include <setjmp.h>
 #include "avProjectLang.h"
 
 #define TOKEN_TEXT(type, token, symbol)
@@ -92,15 +93,52 @@ typedef enum ProcessState{
     PROCESS_STATE_SCEMANTIC_ERROR,
 }ProcessState;
 
-typedef struct LocalContext {
-    AV_DS(AvDynamicArray, struct VariableDescription) variables;
-    struct LocalContext* previous;
+struct LocalFrame {
+    uint32 base; // index of the first variable of the frame
     bool32 inherit;
+};
+
+// the variables of all local frames live on one stack, frames only mark where they start
+typedef struct LocalContext {
+    struct VariableDescription* variables;
+    uint32 variableCount;
+    uint32 variableCapacity;
+    struct LocalFrame* frames;
+    uint32 frameCount;
+    uint32 frameCapacity;
 } LocalContext;
 
+enum SymbolKind {
+    SYMBOL_KIND_VARIABLE,
+    SYMBOL_KIND_CONSTANT,
+    SYMBOL_KIND_FUNCTION,
+    SYMBOL_KIND_EXTERNAL,
+    SYMBOL_KIND_PROJECT,
+    SYMBOL_KIND_LOCAL_PROJECT,
+};
+
+struct Symbol {
+    uint64 hash; // hash of the kind and identifier, 0 for empty slots
+    AvString identifier;
+    enum SymbolKind kind;
+    uint32 index; // index into the array of the kind
+};
+
+struct SymbolTable {
+    uint32 count;
+    uint32 capacity;
+    struct Symbol* symbols;
+};
+
 struct ProjectOptions {
     AvString entry;
     bool32 commandDebug;
+    bool32 teeOutput; // captured output is printed as well
+    uint32 jobCount;
+    uint64 cacheSize;
+    uint64 responseFileSize; // in KB, longer command lines are passed in a response file
+    AvString trace; // file the trace events of the run are written to
+    AvString profile; // file the folded stacks of the profiled script functions are written to
 };
 typedef struct Project {
     AvString name;
@@ -116,10 +154,14 @@ typedef struct Project {
     AV_DS(AvDynamicArray, Project*) importedProjects;
     AV_DS(AvDynamicArray, struct ImportDescription) libraryAliases;
     AV_DS(AvDynamicArray, struct ConstValue*) arrays;
+    struct SymbolTable symbols;
     uint32 statementCount;
+    void* cacheImage; // mapped statement image the statements point into, if loaded from the cache
+    uint64 cacheImageSize;
     struct Statement_S** statements;
+    struct Project* statementOwner; // project the statements were loaded by, their compiled code lives in its allocator
 
-    LocalContext* localContext;
+    LocalContext localContext;
 
     ProcessState processState;
     struct ProjectOptions options;
@@ -130,14 +172,198 @@ extern const AvString templatePath;
 
 
 bool32 loadProjectFile(const AvString projectFilePath, AvStringRef projectFileContent, AvStringRef projectFileName);
+void unloadProjectFile(AvStringRef projectFileContent);
 bool32 tokenizeProject(const AvString projectFileContent, const AvString projectFileName, AvDynamicArray tokens);
 bool32 parseProject(AV_DS(AvDynamicArray, Token) tokenList, void** statements, Project* project);
 bool32 processProject(void* statements, Project* project);
+bool32 registerProjectStatements(Project* project);
 bool32 runProject(Project* project, AvDynamicArray arguments);
+jmp_buf* runtimeErrorRecover(jmp_buf* recovery);
+void runtimeErrorAbandon();
+void invalidatePathReaders(AvString path);
+void invalidateFileSystemReaders();
+void forgetCachedValues(Project* project);
+void commandTemplatesClear();
+
+
+#define BUILD_DATABASE_DIR ".avbuilder"
+#define BUILD_DATABASE_FILE BUILD_DATABASE_DIR "/db"
+#define DEPENDENCY_DATABASE_FILE BUILD_DATABASE_DIR "/deps"
+#define HASH_SEED 0xcbf29ce484222325ull
+
+struct BuildRecord {
+    uint64 key;         // hash of the working directory and the outputs
+    uint64 commandHash; // hash of the expanded command
+    uint64 inputHash;   // hash of the input paths, sizes and modification times
+};
+
+struct CommandBuild {
+    struct BuildRecord record;
+    char* depfile;    // absolute path of the depfile written by the command, if any
+    uint64 actionKey; // hash of the command and the content of its inputs, 0 if it can not be cached
+    uint32 outputCount;
+    char** outputs;   // absolute paths of the outputs
+};
+
+uint64 hashBytes(const void* data, uint64 size, uint64 hash);
+uint64 hashString(AvString str, uint64 hash);
+void workspaceOpen();
+void workspacePath(char* path, uint64 size, const char* relative);
+void buildDatabaseOpen();
+void buildDatabaseClose();
+bool32 buildDatabaseFind(uint64 key, struct BuildRecord* record);
+void buildDatabaseRecord(struct BuildRecord record);
+bool32 buildDatabaseFindDependencies(uint64 key, const char** paths, uint32* count);
+void buildDatabaseRecordDependencies(uint64 key, uint32 count, AvString* dependencies);
+void commitCommandBuild(const struct CommandBuild* build);
+bool32 fileStatus(AvString path, uint64* time, uint64* size);
+bool32 hashFile(AvString path, uint64* hash, uint64* time);
+void actionCacheOpen(uint64 maxSize);
+void actionCacheClose();
+bool32 actionCacheEnabled();
+bool32 actionCacheRestore(const struct CommandBuild* build);
+void actionCacheStore(const struct CommandBuild* build);
+void actionCacheDetachOutputs(const struct CommandBuild* build);
+bool32 hashFileContent(AvString path, uint64* hash);
+bool32 parseDepfile(char* data, uint64 size, AvDynamicArray dependencies);
+char* readDepfile(const char* fileName, uint64* size);
+
+void jobPoolCreate(uint32 jobCount);
+void jobPoolDestroy();
+bool32 jobPoolIsParallel();
+bool32 jobPoolInLoop();
+uint32 jobPoolBeginIteration();
+void jobPoolEndLoop(uint32 previousIteration);
+
+// files the standard output and error of a command are written to, -1 keeps the stream of avBuilder
+struct CommandRedirection {
+    int32 output;
+    int32 error;
+};
+
+bool32 jobPoolDispatch(uint32 argCount, AvString* args, const char* command, struct CommandRedirection redirection, char* responseFile, struct Value* retCodeTarget, bool32 indexed, uint32 retCodeIndex, bool32 debug, const struct CommandBuild* build);
+void jobPoolWaitForValue(struct Value* value);
+void jobPoolWaitForIteration();
+void jobPoolWaitAll();
+
+struct CommandOutputLine {
+    uint64 start;
+    uint64 length;
+};
+
+// output of a captured command, split into its non empty lines while it is read
+struct CommandOutput {
+    char* data;
+    uint64 size;
+    uint64 capacity;
+    uint64 lineStart; // start of the line still being read
+    uint32 lineCount;
+    uint32 lineCapacity;
+    struct CommandOutputLine* lines;
+};
+
+int32 runCapturedCommand(uint32 argCount, AvString* args, int32 errorFile, bool32 tee, struct CommandOutput* output);
+int32 runRedirectedCommand(uint32 argCount, AvString* args, struct CommandRedirection redirection);
+void commandOutputDestroy(struct CommandOutput* output);
+char* responseFileWrite(uint32 argCount, AvString* args, uint64 threshold);
+void responseFileRemove(char* argument);
+
+void traceOpen(AvString fileName);
+void traceClose();
+uint64 traceStart();
+void traceSpan(const char* category, AvString name, AvString file, uint64 start);
+void traceNameJob(uint32 job);
+void traceCommand(const char* command, int32 retCode, uint64 start, int32 job);
+uint64 monotonicTime();
+
+#define PROFILE_DEFAULT_FILE "profile.folded"
+
+void profileOpen();
+void profileClose(AvString fileName);
+void profileEnter(AvString name);
+void profileLeave();
+
+// the bytes allocated from project allocators by the calling thread, the profiler attributes them to
+// the script function running while they were allocated
+extern _Thread_local uint64 profileAllocatedBytes;
+static inline void* projectAllocate(Project* project, uint64 size){
+    profileAllocatedBytes += size;
+    return avAllocatorAllocate(size, &project->allocator);
+}
+
+bool32 projectCacheLoad(AvString projectFilePath, Project* project);
+void projectCacheStore(AvString projectFilePath, Project* project);
+void projectCacheRelease(Project* project);
+
+#ifndef _WIN32
+#define HOME_ENVIRONMENT_VARIABLE "HOME"
+#else
+#define HOME_ENVIRONMENT_VARIABLE "USERPROFILE"
+#endif
+
+bool32 resolveImportPath(AvString projectFile, bool32 local, AvStringRef projectFilePath);
+bool32 loadProjectModule(AvString projectFilePath, Project* project);
+uint64 projectFileKey(AvString projectFilePath);
+bool32 moduleRegistryInstantiate(uint64 key, Project* project);
+void moduleRegistryAdd(uint64 key, Project* project);
+void moduleRegistryPrefetch(Project* project);
+void moduleRegistryClear();
+uint32 moduleRegistryCount();
+void moduleRegistryRewind(uint32 count);
+Project* moduleRegistryLoad(AvString projectFilePath, uint64* key);
+void moduleRegistryRefresh();
+uint32 runModule(uint64 key, const struct ProjectOptions* options, AvDynamicArray arguments);
+
+#define DIRECTORY_CACHE_FILE BUILD_DATABASE_DIR "/dirs"
+
+// identifies the state of a directory, a listing is reused as long as it is unchanged
+struct DirectoryStatus {
+    uint64 time;
+    uint64 inode;
+    uint64 device;
+};
+
+void directoryCacheOpen(const char* fileName);
+void directoryCacheClose();
+bool32 directoryCacheFind(const char* path, uint64 pathLength, struct DirectoryStatus status, const char** listing, uint64* size);
+void directoryCacheStore(const char* path, uint64 pathLength, struct DirectoryStatus status, const char* listing, uint64 size);
+
+#define BUILD_SERVER_SOCKET BUILD_DATABASE_DIR "/server"
+
+bool32 parseProjectOptions(struct ProjectOptions* options, AvDynamicArray arguments);
+uint32 runBuildServer(AvDynamicArray arguments);
+bool32 buildServerForward(const int argC, const char* argV[], uint32* result);
+
+bool32 watchOpen();
+void watchClose();
+void watchFile(AvString path);
+void watchProjectFile(AvString path);
+void watchDirectory(const char* path);
+bool32 watchWait();
+bool32 watchReloadPending();
+uint32 runProjectWatched(Project* project, AvDynamicArray arguments);
+
+struct FileWalk;
+struct FileWalk* fileWalkCreate(bool32 recursive, bool32 dirs, uint32 suffixCount, const AvString* suffixes);
+void fileWalkAdd(struct FileWalk* walk, AvString directory);
+void fileWalkRun(struct FileWalk* walk);
+bool32 fileWalkNextFailure(struct FileWalk* walk, uint32* iterator, AvString* path);
+uint32 fileWalkCount(struct FileWalk* walk, uint64* size);
+void fileWalkWrite(struct FileWalk* walk, char* block, struct ConstValue* values);
+void fileWalkDestroy(struct FileWalk* walk);
+void fileWalkPoolDestroy();
 
+void symbolTableCreate(struct SymbolTable* table);
+void symbolTableDestroy(struct SymbolTable* table);
+bool32 symbolTableFind(struct SymbolTable* table, enum SymbolKind kind, AvString identifier, uint32* index);
+void symbolTableAdd(struct SymbolTable* table, enum SymbolKind kind, AvString identifier, uint32 index);
 
 void startLocalContext(struct Project* project, bool32 inherit);
 void endLocalContext(struct Project* project);
+uint32 localContextVisibleBase(struct Project* project);
+struct VariableDescription* findLocalVariable(AvString identifier, struct Project* project);
+struct VariableDescription* findFrameVariable(AvString identifier, struct Project* project);
+void addLocalVariable(struct VariableDescription description, struct Project* project);
 void projectCreate(struct Project* project, AvString name, AvString file, AvString content);
 void projectDestroy(struct Project* project);
 
@@ -31,5 +31,38 @@ enum Syscalls {
 	SYSCALL_MALLOC,
 };
 
+// operations of the expression vm, these work on a stack of values. Only expressions are compiled, the statements
+// of function bodies are still run from the syntax tree. Identifiers, calls, enumerations and filters keep their
+// expression as operand and are resolved when they run
+enum ExpressionOperations {
+	OP_CST = 0b100000, // CST [constant]   -- CONSTANT                 -- pushes the constant
+	OP_VAR,            // VAR [expression] -- VARIABLE                 -- pushes the value of the identifier
+	OP_ARR,            // ARR [count]      -- ARRAY                    -- pops count values and pushes them as array
+	OP_ADD,            // ADD              -- ADD                      -- pops b and a, pushes a+b
+	OP_SBT,            // SBT              -- SUBTRACT                 -- pops b and a, pushes a-b
+	OP_MLT,            // MLT              -- MULTIPLY                 -- pops b and a, pushes a*b
+	OP_DVD,            // DVD              -- DIVIDE                   -- pops b and a, pushes a/b
+	OP_NEG,            // NEG              -- NEGATE                   -- pops a, pushes -a
+	OP_NOT,            // NOT              -- NOT                      -- pops a, pushes !a
+	OP_CMP,            // CMP [operator]   -- COMPARE                  -- pops b and a, pushes the comparison of a and b
+	OP_CLL,            // CLL [expression] -- CALL                     -- pushes the return value of the call
+	OP_ENM,            // ENM [expression] -- ENUMERATE                -- pushes the enumerated files
+	OP_FLT,            // FLT [expression] -- FILTER                   -- pushes the filtered values
+	OP_RET,            // RET              -- RETURN                   -- returns the top of the stack
+};
+
+struct Instruction {
+	enum ExpressionOperations operation;
+	uint32 operand;
+	struct Expression_S* expression;
+};
+
+struct ExpressionByteCode {
+	uint32 instructionCount;
+	uint32 stackSize;
+	struct Instruction* instructions;
+	struct Value* constants;
+};
+
 
 #endif//__AV_BUILDER_BYTE_CODE__
\ No newline at end of file
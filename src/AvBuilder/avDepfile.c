@@ -0,0 +1,110 @@
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <AvUtils/dataStructures/avDynamicArray.h>
+#include <string.h>
+#include <stdio.h>
+
+static bool32 isDepfileWhitespace(char c){
+    return c == ' ' || c == '\t';
+}
+
+static bool32 isDepfileNewline(char c){
+    return c == '\n' || c == '\r';
+}
+
+// a colon followed by whitespace ends the targets of a rule, "C:\path" does not
+static bool32 isDepfileSeparator(const char* data, uint64 index, uint64 size){
+    if(data[index] != ':'){
+        return false;
+    }
+    return index + 1 == size || isDepfileWhitespace(data[index + 1]) || isDepfileNewline(data[index + 1]);
+}
+
+// parses the makefile style rules written by gcc -MD / clang -MD. The prerequisites are
+// unescaped in place and added to dependencies as strings pointing into data
+bool32 parseDepfile(char* data, uint64 size, AV_DS(AvDynamicArray, AvString) dependencies){
+    bool32 inTargets = true;
+    bool32 foundRule = false;
+    uint64 read = 0;
+    while(read < size){
+        char c = data[read];
+        if(isDepfileWhitespace(c)){
+            read++;
+            continue;
+        }
+        if(c == '\\' && read + 1 < size && isDepfileNewline(data[read + 1])){
+            read += 2;
+            if(data[read - 1] == '\r' && read < size && data[read] == '\n'){
+                read++;
+            }
+            continue;
+        }
+        if(isDepfileNewline(c)){
+            inTargets = true;
+            read++;
+            continue;
+        }
+        if(isDepfileSeparator(data, read, size)){
+            inTargets = false;
+            foundRule = true;
+            read++;
+            continue;
+        }
+
+        uint64 start = read;
+        uint64 write = read;
+        while(read < size){
+            c = data[read];
+            if(isDepfileWhitespace(c) || isDepfileNewline(c) || isDepfileSeparator(data, read, size)){
+                break;
+            }
+            if(c == '\\' && read + 1 < size){
+                char next = data[read + 1];
+                if(isDepfileWhitespace(next) || next == '#'){
+                    data[write++] = next;
+                    read += 2;
+                    continue;
+                }
+                if(isDepfileNewline(next)){
+                    break;
+                }
+            }
+            if(c == '$' && read + 1 < size && data[read + 1] == '$'){
+                data[write++] = '$';
+                read += 2;
+                continue;
+            }
+            data[write++] = c;
+            read++;
+        }
+
+        if(!inTargets && write > start){
+            AvString dependency = {
+                .chrs = data + start,
+                .len = write - start,
+                .memory = nullptr,
+            };
+            avDynamicArrayAdd(&dependency, dependencies);
+        }
+    }
+    return foundRule;
+}
+
+char* readDepfile(const char* fileName, uint64* size){
+    FILE* file = fopen(fileName, "rb");
+    if(file == nullptr){
+        return nullptr;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if(fileSize < 0){
+        fclose(file);
+        return nullptr;
+    }
+    char* data = avAllocate(fileSize + 1, "depfile");
+    *size = fread(data, 1, fileSize, file);
+    data[*size] = '\0';
+    fclose(file);
+    return data;
+}
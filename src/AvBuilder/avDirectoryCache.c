@@ -0,0 +1,366 @@
+// clock_gettime and st_mtim are not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#define DIRECTORY_CACHE_MAGIC 0x53524944766158ull // "XavDIRS"
+#define DIRECTORY_CACHE_VERSION 2
+// once the cache holds this many records, the ones least recently listed or read are dropped
+#define DIRECTORY_CACHE_MAX_RECORDS (1 << 20)
+// a listing is only stored once its directory has not been modified for this long, changes within
+// the resolution of the modification time would otherwise go unnoticed
+#define DIRECTORY_CACHE_SETTLE_TIME 2000000000ull
+
+// the file is a header, an open addressing table of records and the listings they point to
+struct DirectoryCacheHeader {
+    uint64 magic;
+    uint64 version;
+    uint64 tableSize; // power of two
+    uint64 recordCount;
+    uint64 run; // counts the runs that wrote the cache
+};
+
+struct DirectoryCacheRecord {
+    uint64 key; // hash of the path, 0 for empty slots
+    struct DirectoryStatus status;
+    uint64 listing; // offset of the listing in the file
+    uint64 size;
+    uint64 lastUse; // run that last listed or read the directory
+};
+
+#ifndef _WIN32
+static struct DirectoryCache {
+    char* fileName;
+    char* mapping;
+    uint64 mappingSize;
+    const struct DirectoryCacheHeader* header;
+    const struct DirectoryCacheRecord* records;
+
+    // listings read during this run, written when the cache is closed
+    pthread_mutex_t mutex;
+    uint32 pendingCount;
+    uint32 pendingCapacity;
+    struct DirectoryCacheRecord* pending;
+    char** pendingListings;
+    // keys of records of the file read during this run
+    uint32 usedCount;
+    uint32 usedCapacity;
+    uint64* used;
+} directoryCache = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64 directoryKey(const char* path, uint64 pathLength){
+    uint64 key = hashBytes(path, pathLength, HASH_SEED);
+    return key ? key : 1;
+}
+
+static const struct DirectoryCacheRecord* findRecord(const struct DirectoryCacheRecord* records, uint64 tableSize, uint64 key){
+    uint64 mask = tableSize - 1;
+    for(uint64 i = key & mask;; i = (i + 1) & mask){
+        if(records[i].key == key || records[i].key == 0){
+            return records + i;
+        }
+    }
+}
+#endif
+
+void directoryCacheOpen(const char* fileName){
+#ifndef _WIN32
+    directoryCacheClose();
+    // written when closing, by then a script might have changed directories
+    char path[PATH_MAX];
+    if(fileName[0] != '/'){
+        workspacePath(path, sizeof(path), fileName);
+        fileName = path;
+    }
+    uint64 length = strlen(fileName);
+    directoryCache.fileName = avAllocate(length + 1, "directory cache file name");
+    memcpy(directoryCache.fileName, fileName, length + 1);
+
+    int fd = open(fileName, O_RDONLY);
+    if(fd == -1){
+        return;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || (uint64)info.st_size < sizeof(struct DirectoryCacheHeader)){
+        close(fd);
+        return;
+    }
+    char* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED){
+        return;
+    }
+    const struct DirectoryCacheHeader* header = (const struct DirectoryCacheHeader*)mapping;
+    uint64 tableSize = header->tableSize;
+    if(header->magic != DIRECTORY_CACHE_MAGIC || header->version != DIRECTORY_CACHE_VERSION
+        || tableSize == 0 || (tableSize & (tableSize - 1)) != 0
+        || sizeof(struct DirectoryCacheHeader) + tableSize * sizeof(struct DirectoryCacheRecord) > (uint64)info.st_size){
+        munmap(mapping, info.st_size);
+        return;
+    }
+    directoryCache.mapping = mapping;
+    directoryCache.mappingSize = info.st_size;
+    directoryCache.header = header;
+    directoryCache.records = (const struct DirectoryCacheRecord*)(header + 1);
+#endif
+}
+
+bool32 directoryCacheFind(const char* path, uint64 pathLength, struct DirectoryStatus status, const char** listing, uint64* size){
+#ifndef _WIN32
+    if(directoryCache.header == nullptr){
+        return false;
+    }
+    const struct DirectoryCacheRecord* record = findRecord(directoryCache.records, directoryCache.header->tableSize, directoryKey(path, pathLength));
+    if(record->key == 0 || memcmp(&record->status, &status, sizeof(struct DirectoryStatus)) != 0){
+        return false;
+    }
+    if(record->listing > directoryCache.mappingSize || record->size > directoryCache.mappingSize - record->listing){
+        return false;
+    }
+    *listing = directoryCache.mapping + record->listing;
+    *size = record->size;
+
+    pthread_mutex_lock(&directoryCache.mutex);
+    if(directoryCache.usedCount == directoryCache.usedCapacity){
+        uint32 capacity = directoryCache.usedCapacity ? directoryCache.usedCapacity * 2 : 64;
+        uint64* used = avAllocate(sizeof(uint64) * capacity, "directory cache used keys");
+        if(directoryCache.used){
+            memcpy(used, directoryCache.used, sizeof(uint64) * directoryCache.usedCount);
+            avFree(directoryCache.used);
+        }
+        directoryCache.used = used;
+        directoryCache.usedCapacity = capacity;
+    }
+    directoryCache.used[directoryCache.usedCount++] = record->key;
+    pthread_mutex_unlock(&directoryCache.mutex);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void directoryCacheStore(const char* path, uint64 pathLength, struct DirectoryStatus status, const char* listing, uint64 size){
+#ifndef _WIN32
+    if(directoryCache.fileName == nullptr){
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if(status.time + DIRECTORY_CACHE_SETTLE_TIME > (uint64)now.tv_sec * 1000000000ull + now.tv_nsec){
+        return;
+    }
+    char* copy = avAllocate(size ? size : 1, "directory listing");
+    memcpy(copy, listing, size);
+
+    pthread_mutex_lock(&directoryCache.mutex);
+    if(directoryCache.pendingCount == directoryCache.pendingCapacity){
+        uint32 capacity = directoryCache.pendingCapacity ? directoryCache.pendingCapacity * 2 : 64;
+        struct DirectoryCacheRecord* pending = avAllocate(sizeof(struct DirectoryCacheRecord) * capacity, "directory cache records");
+        char** listings = avAllocate(sizeof(char*) * capacity, "directory cache listings");
+        if(directoryCache.pending){
+            memcpy(pending, directoryCache.pending, sizeof(struct DirectoryCacheRecord) * directoryCache.pendingCount);
+            memcpy(listings, directoryCache.pendingListings, sizeof(char*) * directoryCache.pendingCount);
+            avFree(directoryCache.pending);
+            avFree(directoryCache.pendingListings);
+        }
+        directoryCache.pending = pending;
+        directoryCache.pendingListings = listings;
+        directoryCache.pendingCapacity = capacity;
+    }
+    directoryCache.pending[directoryCache.pendingCount] = (struct DirectoryCacheRecord){
+        .key = directoryKey(path, pathLength),
+        .status = status,
+        .listing = 0,
+        .size = size,
+    };
+    directoryCache.pendingListings[directoryCache.pendingCount++] = copy;
+    pthread_mutex_unlock(&directoryCache.mutex);
+#endif
+}
+
+#ifndef _WIN32
+static bool32 writeAll(int fd, const void* data, uint64 size){
+    const char* bytes = data;
+    while(size){
+        ssize_t written = write(fd, bytes, size);
+        if(written <= 0){
+            if(written < 0 && errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+static int compareKeys(const void* a, const void* b){
+    uint64 keyA = *(const uint64*)a;
+    uint64 keyB = *(const uint64*)b;
+    return (keyA > keyB) - (keyA < keyB);
+}
+
+static int compareRecentRecords(const void* a, const void* b){
+    const struct DirectoryCacheRecord* recordA = a;
+    const struct DirectoryCacheRecord* recordB = b;
+    return (recordA->lastUse < recordB->lastUse) - (recordA->lastUse > recordB->lastUse);
+}
+
+// rewrites the cache with the listings of this run and the most recently used earlier ones that were not replaced
+static void writeDirectoryCache(){
+    uint64 run = directoryCache.header ? directoryCache.header->run + 1 : 1;
+    uint64 recordCount = directoryCache.pendingCount;
+
+    // valid records of the file, those read during this run count as used by it
+    uint64 oldCount = 0;
+    struct DirectoryCacheRecord* oldRecords = nullptr;
+    if(directoryCache.header){
+        qsort(directoryCache.used, directoryCache.usedCount, sizeof(uint64), compareKeys);
+        const struct DirectoryCacheRecord* records = directoryCache.records;
+        oldRecords = avAllocate(sizeof(struct DirectoryCacheRecord) * directoryCache.header->tableSize, "directory cache old records");
+        for(uint64 i = 0; i < directoryCache.header->tableSize; i++){
+            if(records[i].key == 0 || records[i].listing > directoryCache.mappingSize
+                || records[i].size > directoryCache.mappingSize - records[i].listing){
+                continue;
+            }
+            oldRecords[oldCount] = records[i];
+            if(directoryCache.usedCount && bsearch(&records[i].key, directoryCache.used, directoryCache.usedCount, sizeof(uint64), compareKeys)){
+                oldRecords[oldCount].lastUse = run;
+            }
+            oldCount++;
+        }
+    }
+    if(recordCount + oldCount > DIRECTORY_CACHE_MAX_RECORDS){
+        qsort(oldRecords, oldCount, sizeof(struct DirectoryCacheRecord), compareRecentRecords);
+        oldCount = recordCount < DIRECTORY_CACHE_MAX_RECORDS ? DIRECTORY_CACHE_MAX_RECORDS - recordCount : 0;
+    }
+    uint64 tableSize = 64;
+    while(tableSize < (recordCount + oldCount) * 2){
+        tableSize *= 2;
+    }
+    struct DirectoryCacheRecord* table = avCallocate(tableSize, sizeof(struct DirectoryCacheRecord), "directory cache table");
+    const char** listings = avCallocate(tableSize, sizeof(char*), "directory cache listings");
+    uint64 offset = sizeof(struct DirectoryCacheHeader) + tableSize * sizeof(struct DirectoryCacheRecord);
+    uint64 count = 0;
+
+    // the latest listing of a directory wins
+    for(uint32 i = directoryCache.pendingCount; i-- > 0;){
+        struct DirectoryCacheRecord* slot = (struct DirectoryCacheRecord*)findRecord(table, tableSize, directoryCache.pending[i].key);
+        if(slot->key){
+            continue;
+        }
+        *slot = directoryCache.pending[i];
+        slot->lastUse = run;
+        listings[slot - table] = directoryCache.pendingListings[i];
+        count++;
+    }
+    for(uint64 i = 0; i < oldCount; i++){
+        struct DirectoryCacheRecord* slot = (struct DirectoryCacheRecord*)findRecord(table, tableSize, oldRecords[i].key);
+        if(slot->key){
+            continue;
+        }
+        *slot = oldRecords[i];
+        listings[slot - table] = directoryCache.mapping + oldRecords[i].listing;
+        count++;
+    }
+    if(oldRecords){
+        avFree(oldRecords);
+    }
+
+    // listings follow the table in slot order
+    for(uint64 i = 0; i < tableSize; i++){
+        if(table[i].key){
+            table[i].listing = offset;
+            offset += table[i].size;
+        }
+    }
+
+    struct DirectoryCacheHeader header = {
+        .magic = DIRECTORY_CACHE_MAGIC,
+        .version = DIRECTORY_CACHE_VERSION,
+        .tableSize = tableSize,
+        .recordCount = count,
+        .run = run,
+    };
+    char tmpFileName[strlen(directoryCache.fileName) + 32];
+    snprintf(tmpFileName, sizeof(tmpFileName), "%s.tmp%i", directoryCache.fileName, (int)getpid());
+    int fd = open(tmpFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd != -1){
+        bool32 written = writeAll(fd, &header, sizeof(header)) && writeAll(fd, table, tableSize * sizeof(struct DirectoryCacheRecord));
+        for(uint64 i = 0; written && i < tableSize; i++){
+            if(table[i].key){
+                written = writeAll(fd, listings[i], table[i].size);
+            }
+        }
+        close(fd);
+        if(!written || rename(tmpFileName, directoryCache.fileName) != 0){
+            unlink(tmpFileName);
+        }
+    }
+    avFree(listings);
+    avFree(table);
+}
+
+// a run that only read from the cache rewrites it once eviction gets close, until then the records keep
+// the run that last wrote them
+static bool32 directoryCacheNeedsWrite(){
+    if(directoryCache.pendingCount){
+        return true;
+    }
+    return directoryCache.usedCount && directoryCache.header->recordCount > DIRECTORY_CACHE_MAX_RECORDS / 2;
+}
+#endif
+
+// writes the listings read in this run and releases the cache
+void directoryCacheClose(){
+#ifndef _WIN32
+    if(directoryCache.fileName && directoryCacheNeedsWrite()){
+        writeDirectoryCache();
+    }
+    for(uint32 i = 0; i < directoryCache.pendingCount; i++){
+        avFree(directoryCache.pendingListings[i]);
+    }
+    if(directoryCache.pending){
+        avFree(directoryCache.pending);
+        avFree(directoryCache.pendingListings);
+    }
+    if(directoryCache.used){
+        avFree(directoryCache.used);
+    }
+    if(directoryCache.mapping){
+        munmap(directoryCache.mapping, directoryCache.mappingSize);
+    }
+    if(directoryCache.fileName){
+        avFree(directoryCache.fileName);
+    }
+    directoryCache.fileName = nullptr;
+    directoryCache.mapping = nullptr;
+    directoryCache.mappingSize = 0;
+    directoryCache.header = nullptr;
+    directoryCache.records = nullptr;
+    directoryCache.pendingCount = 0;
+    directoryCache.pendingCapacity = 0;
+    directoryCache.pending = nullptr;
+    directoryCache.pendingListings = nullptr;
+    directoryCache.usedCount = 0;
+    directoryCache.usedCapacity = 0;
+    directoryCache.used = nullptr;
+#endif
+}
@@ -0,0 +1,680 @@
+// getdents64 goes through syscall, the d_type constants, openat, fstatat and st_mtim are not part of strict c11
+#define _GNU_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <AvUtils/logging/avAssert.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "avProjectLang.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#define WALK_LOCK(walk) pthread_mutex_lock(&(walk)->mutex)
+#define WALK_UNLOCK(walk) pthread_mutex_unlock(&(walk)->mutex)
+#define WALK_WAIT(walk) pthread_cond_wait(&(walk)->changed, &(walk)->mutex)
+#define WALK_SIGNAL(walk) pthread_cond_broadcast(&(walk)->changed)
+#else
+#include <AvUtils/filesystem/avDirectoryV2.h>
+
+// directories are read on the calling thread
+#define WALK_LOCK(walk)
+#define WALK_UNLOCK(walk)
+#define WALK_WAIT(walk)
+#define WALK_SIGNAL(walk)
+#endif
+
+#define WALK_BUFFER_SIZE (64 * 1024)
+
+#ifdef __linux__
+// layout of the records returned by getdents64
+struct LinuxDirent64 {
+    uint64 inode;
+    int64 offset;
+    unsigned short recordLength;
+    unsigned char type;
+    char name[];
+};
+#endif
+
+// a listing is the raw content of a directory as it is kept in the directory cache,
+// one type byte followed by the null terminated name per entry
+enum WalkEntryType {
+    WALK_ENTRY_FILE = 1,
+    WALK_ENTRY_DIRECTORY,
+    WALK_ENTRY_LINK, // resolved every time it is walked, the target may change without touching the directory
+};
+
+struct WalkBuffer {
+    uint64 size;
+    uint64 capacity;
+    char* listing;
+    char* records;
+};
+
+// entries are kept in the order the directory returned them, the result is assembled afterwards
+// so the walk order does not depend on which thread read which directory
+struct WalkEntry {
+    uint64 name;   // offset into the names of the directory
+    uint32 length;
+    uint32 child;  // index of the subdirectory + 1 if it is walked, 0 otherwise
+    bool32 listed; // part of the result
+};
+
+struct WalkDirectory {
+    char* path;
+    uint32 pathLength;
+    bool32 failed;
+    uint32 entryCount;
+    uint32 entryCapacity;
+    struct WalkEntry* entries;
+    uint64 namesSize;
+    uint64 namesCapacity;
+    char* names;
+};
+
+struct FileWalk {
+    bool32 recursive;
+    bool32 dirs;
+    uint32 suffixCount;
+    const AvString* suffixes;
+
+#ifndef _WIN32
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+#endif
+    uint32 rootCount;
+    uint32 count;
+    uint32 capacity;
+    uint32 next;
+    uint32 active;
+    struct WalkDirectory** directories;
+};
+
+static struct WalkDirectory* createDirectory(const char* parent, uint32 parentLength, const char* name, uint32 nameLength){
+    struct WalkDirectory* directory = avCallocate(1, sizeof(struct WalkDirectory), "walked directory");
+    bool32 separator = parentLength && parent[parentLength - 1] != '/';
+    directory->pathLength = parentLength + separator + nameLength;
+    directory->path = avAllocate(directory->pathLength + 1, "walked directory path");
+    memcpy(directory->path, parent, parentLength);
+    if(separator){
+        directory->path[parentLength] = '/';
+    }
+    memcpy(directory->path + parentLength + separator, name, nameLength);
+    directory->path[directory->pathLength] = '\0';
+    return directory;
+}
+
+static void destroyDirectory(struct WalkDirectory* directory){
+    avFree(directory->path);
+    if(directory->entries){
+        avFree(directory->entries);
+    }
+    if(directory->names){
+        avFree(directory->names);
+    }
+    avFree(directory);
+}
+
+// the caller holds the lock
+static uint32 appendDirectory(struct FileWalk* walk, struct WalkDirectory* directory){
+    if(walk->count == walk->capacity){
+        walk->capacity = walk->capacity ? walk->capacity * 2 : 64;
+        struct WalkDirectory** directories = avCallocate(walk->capacity, sizeof(struct WalkDirectory*), "walked directories");
+        if(walk->directories){
+            memcpy(directories, walk->directories, sizeof(struct WalkDirectory*) * walk->count);
+            avFree(walk->directories);
+        }
+        walk->directories = directories;
+    }
+    walk->directories[walk->count] = directory;
+    return walk->count++;
+}
+
+// matches the suffixes against the path the entry will have in the result
+static bool32 matchesSuffix(struct FileWalk* walk, struct WalkDirectory* directory, const char* name, uint32 length){
+    if(walk->suffixCount == 0){
+        return true;
+    }
+    for(uint32 i = 0; i < walk->suffixCount; i++){
+        AvString suffix = walk->suffixes[i];
+        if(suffix.len <= length){
+            if(memcmp(name + length - suffix.len, suffix.chrs, suffix.len) == 0){
+                return true;
+            }
+            continue;
+        }
+        uint64 rest = suffix.len - length;
+        if(memcmp(name, suffix.chrs + rest, length) != 0){
+            continue;
+        }
+        // the suffix reaches into the directory path
+        bool32 separator = directory->pathLength && directory->path[directory->pathLength - 1] != '/';
+        if(separator){
+            if(suffix.chrs[--rest] != '/'){
+                continue;
+            }
+        }
+        if(rest <= directory->pathLength && memcmp(directory->path + directory->pathLength - rest, suffix.chrs, rest) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+static void addEntry(struct WalkDirectory* directory, const char* name, uint32 length, bool32 listed){
+    if(directory->entryCount == directory->entryCapacity){
+        directory->entryCapacity = directory->entryCapacity ? directory->entryCapacity * 2 : 32;
+        struct WalkEntry* entries = avAllocate(sizeof(struct WalkEntry) * directory->entryCapacity, "walked entries");
+        if(directory->entries){
+            memcpy(entries, directory->entries, sizeof(struct WalkEntry) * directory->entryCount);
+            avFree(directory->entries);
+        }
+        directory->entries = entries;
+    }
+    if(directory->namesSize + length > directory->namesCapacity){
+        while(directory->namesSize + length > directory->namesCapacity){
+            directory->namesCapacity = directory->namesCapacity ? directory->namesCapacity * 2 : 1024;
+        }
+        char* names = avAllocate(directory->namesCapacity, "walked names");
+        if(directory->names){
+            memcpy(names, directory->names, directory->namesSize);
+            avFree(directory->names);
+        }
+        directory->names = names;
+    }
+    memcpy(directory->names + directory->namesSize, name, length);
+    directory->entries[directory->entryCount++] = (struct WalkEntry){
+        .name = directory->namesSize,
+        .length = length,
+        .child = 0,
+        .listed = listed,
+    };
+    directory->namesSize += length;
+}
+
+static bool32 isLinkedDirectory(struct WalkDirectory* directory, const char* name, uint32 length){
+#ifndef _WIN32
+    char path[directory->pathLength + length + 2];
+    bool32 separator = directory->pathLength && directory->path[directory->pathLength - 1] != '/';
+    memcpy(path, directory->path, directory->pathLength);
+    if(separator){
+        path[directory->pathLength] = '/';
+    }
+    memcpy(path + directory->pathLength + separator, name, length);
+    path[directory->pathLength + separator + length] = '\0';
+    // dangling links are listed like files
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#else
+    return false;
+#endif
+}
+
+static void addName(struct FileWalk* walk, struct WalkDirectory* directory, const char* name, uint32 length, enum WalkEntryType type){
+    bool32 isDirectory = type == WALK_ENTRY_DIRECTORY;
+    if(type == WALK_ENTRY_LINK){
+        isDirectory = isLinkedDirectory(directory, name, length);
+    }
+    if(isDirectory){
+        // linked directories are listed but not walked, so links can not form cycles
+        bool32 walked = walk->recursive && type != WALK_ENTRY_LINK;
+        bool32 listed = walk->dirs && matchesSuffix(walk, directory, name, length);
+        if(walked || listed){
+            addEntry(directory, name, length, listed);
+            // marked as a subdirectory to walk once the directory is read
+            directory->entries[directory->entryCount - 1].child = walked;
+        }
+        return;
+    }
+    if(!walk->dirs && matchesSuffix(walk, directory, name, length)){
+        addEntry(directory, name, length, true);
+    }
+}
+
+static void addListing(struct FileWalk* walk, struct WalkDirectory* directory, const char* listing, uint64 size){
+    const char* end = listing + size;
+    while(listing < end){
+        enum WalkEntryType type = (uint8)*listing++;
+        const char* terminator = memchr(listing, '\0', end - listing);
+        if(terminator == nullptr){
+            break;
+        }
+        addName(walk, directory, listing, terminator - listing, type);
+        listing = terminator + 1;
+    }
+}
+
+static void appendListing(struct WalkBuffer* buffer, enum WalkEntryType type, const char* name, uint64 length){
+    if(name[0] == '.' && (length == 1 || (length == 2 && name[1] == '.'))){
+        return;
+    }
+    if(buffer->size + length + 2 > buffer->capacity){
+        while(buffer->size + length + 2 > buffer->capacity){
+            buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        }
+        char* listing = avAllocate(buffer->capacity, "directory listing");
+        if(buffer->listing){
+            memcpy(listing, buffer->listing, buffer->size);
+            avFree(buffer->listing);
+        }
+        buffer->listing = listing;
+    }
+    buffer->listing[buffer->size++] = type;
+    memcpy(buffer->listing + buffer->size, name, length);
+    buffer->size += length;
+    buffer->listing[buffer->size++] = '\0';
+}
+
+#ifndef _WIN32
+static enum WalkEntryType entryType(int fd, const char* name, uint8 type){
+    if(type == DT_UNKNOWN){
+        struct stat info;
+        if(fstatat(fd, name, &info, AT_SYMLINK_NOFOLLOW) != 0){
+            return WALK_ENTRY_FILE;
+        }
+        type = S_ISDIR(info.st_mode) ? DT_DIR : S_ISLNK(info.st_mode) ? DT_LNK : DT_REG;
+    }
+    switch(type){
+        case DT_DIR:
+            return WALK_ENTRY_DIRECTORY;
+        case DT_LNK:
+            return WALK_ENTRY_LINK;
+        default:
+            return WALK_ENTRY_FILE;
+    }
+}
+#endif
+
+static bool32 listDirectory(struct WalkDirectory* directory, struct WalkBuffer* buffer){
+    buffer->size = 0;
+#ifndef _WIN32
+    int fd = openat(AT_FDCWD, directory->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd == -1){
+        return false;
+    }
+#ifdef __linux__
+    while(true){
+        long size = syscall(SYS_getdents64, fd, buffer->records, WALK_BUFFER_SIZE);
+        if(size < 0){
+            close(fd);
+            return false;
+        }
+        if(size == 0){
+            break;
+        }
+        for(long offset = 0; offset < size;){
+            struct LinuxDirent64* entry = (struct LinuxDirent64*)(buffer->records + offset);
+            appendListing(buffer, entryType(fd, entry->name, entry->type), entry->name, strlen(entry->name));
+            offset += entry->recordLength;
+        }
+    }
+    close(fd);
+#else
+    DIR* stream = fdopendir(fd);
+    if(stream == nullptr){
+        close(fd);
+        return false;
+    }
+    struct dirent* entry = nullptr;
+    while((entry = readdir(stream))){
+        appendListing(buffer, entryType(dirfd(stream), entry->d_name, entry->d_type), entry->d_name, strlen(entry->d_name));
+    }
+    closedir(stream);
+#endif
+#else
+    AvPath path = AV_EMPTY;
+    AvString directoryPath = {
+        .chrs = directory->path,
+        .len = directory->pathLength,
+        .memory = nullptr,
+    };
+    if(!avDirectoryOpen(directoryPath, nullptr, &path)){
+        return false;
+    }
+    for(uint32 i = 0; i < path.contentCount; i++){
+        AvPathNode node = path.content[i];
+        if(node.type == AV_PATH_NODE_TYPE_FILE || node.type == AV_PATH_NODE_TYPE_DIRECTORY){
+            appendListing(buffer, node.type == AV_PATH_NODE_TYPE_FILE ? WALK_ENTRY_FILE : WALK_ENTRY_DIRECTORY, node.name.chrs, node.name.len);
+        }
+    }
+    avDirectoryClose(&path);
+#endif
+    return true;
+}
+
+// unchanged directories are answered from the directory cache, which only costs a stat
+static void readDirectory(struct FileWalk* walk, struct WalkDirectory* directory, struct WalkBuffer* buffer){
+#ifndef _WIN32
+    // watched before it is read, so a change made while reading is not missed
+    watchDirectory(directory->path);
+    struct stat info;
+    if(stat(directory->path, &info) != 0 || !S_ISDIR(info.st_mode)){
+        directory->failed = true;
+        return;
+    }
+    struct DirectoryStatus status = {
+#ifdef __linux__
+        .time = (uint64)info.st_mtim.tv_sec * 1000000000ull + info.st_mtim.tv_nsec,
+#else
+        .time = (uint64)info.st_mtime * 1000000000ull,
+#endif
+        .inode = info.st_ino,
+        .device = info.st_dev,
+    };
+    const char* listing = nullptr;
+    uint64 size = 0;
+    if(directoryCacheFind(directory->path, directory->pathLength, status, &listing, &size)){
+        addListing(walk, directory, listing, size);
+        return;
+    }
+#endif
+    uint64 traceStarted = traceStart();
+    bool32 listed = listDirectory(directory, buffer);
+    traceSpan("filesystem", AV_CSTR("read directory"), (AvString){ .chrs = directory->path, .len = directory->pathLength }, traceStarted);
+    if(!listed){
+        directory->failed = true;
+        return;
+    }
+    addListing(walk, directory, buffer->listing, buffer->size);
+#ifndef _WIN32
+    // the status was taken before reading, a change during the read invalidates the listing next time
+    directoryCacheStore(directory->path, directory->pathLength, status, buffer->listing, buffer->size);
+#endif
+}
+
+static void walkDirectories(struct FileWalk* walk, struct WalkBuffer* buffer){
+    WALK_LOCK(walk);
+    while(true){
+        while(walk->next == walk->count && walk->active){
+            WALK_WAIT(walk);
+        }
+        if(walk->next == walk->count){
+            break;
+        }
+        struct WalkDirectory* directory = walk->directories[walk->next++];
+        walk->active++;
+        WALK_UNLOCK(walk);
+
+        readDirectory(walk, directory, buffer);
+        uint32 childCount = 0;
+        for(uint32 i = 0; i < directory->entryCount; i++){
+            childCount += directory->entries[i].child;
+        }
+        struct WalkDirectory** children = nullptr;
+        if(childCount){
+            children = avAllocate(sizeof(struct WalkDirectory*) * childCount, "walked children");
+        }
+        for(uint32 i = 0, child = 0; i < directory->entryCount; i++){
+            struct WalkEntry* entry = directory->entries + i;
+            if(entry->child){
+                children[child++] = createDirectory(directory->path, directory->pathLength, directory->names + entry->name, entry->length);
+            }
+        }
+
+        WALK_LOCK(walk);
+        for(uint32 i = 0, child = 0; i < directory->entryCount; i++){
+            struct WalkEntry* entry = directory->entries + i;
+            if(entry->child){
+                entry->child = appendDirectory(walk, children[child++]) + 1;
+            }
+        }
+        if(children){
+            avFree(children);
+        }
+        walk->active--;
+        WALK_SIGNAL(walk);
+    }
+    WALK_UNLOCK(walk);
+}
+
+static void createBuffer(struct WalkBuffer* buffer){
+    memset(buffer, 0, sizeof(struct WalkBuffer));
+#ifdef __linux__
+    buffer->records = avAllocate(WALK_BUFFER_SIZE, "directory buffer");
+#endif
+}
+
+static void destroyBuffer(struct WalkBuffer* buffer){
+    if(buffer->records){
+        avFree(buffer->records);
+    }
+    if(buffer->listing){
+        avFree(buffer->listing);
+    }
+}
+
+#ifndef _WIN32
+// threads helping with recursive walks, started by the first one and kept until fileWalkPoolDestroy
+static struct WalkPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    pthread_mutex_t running; // held by the walk using the threads, other walks read on their own thread
+    bool32 started;
+    bool32 stopping;
+    uint32 threadCount;
+    pthread_t* threads;
+    struct FileWalk* walk; // cleared once the walk is done, so late threads do not join it
+    uint32 generation;     // counts the walks handed to the threads
+    uint32 busy;
+} walkPool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .changed = PTHREAD_COND_INITIALIZER,
+    .running = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void* walkPoolWorker(void* data){
+    struct WalkBuffer buffer;
+    createBuffer(&buffer);
+    pthread_mutex_lock(&walkPool.mutex);
+    uint32 generation = walkPool.generation;
+    while(true){
+        while(!walkPool.stopping && walkPool.generation == generation){
+            pthread_cond_wait(&walkPool.changed, &walkPool.mutex);
+        }
+        if(walkPool.stopping){
+            break;
+        }
+        generation = walkPool.generation;
+        struct FileWalk* walk = walkPool.walk;
+        if(walk == nullptr){
+            continue;
+        }
+        walkPool.busy++;
+        pthread_mutex_unlock(&walkPool.mutex);
+        walkDirectories(walk, &buffer);
+        pthread_mutex_lock(&walkPool.mutex);
+        walkPool.busy--;
+        pthread_cond_broadcast(&walkPool.changed);
+    }
+    pthread_mutex_unlock(&walkPool.mutex);
+    destroyBuffer(&buffer);
+    return nullptr;
+}
+
+// the calling thread takes part in every walk, so one thread less than there are cores is started
+static void startWalkPool(){
+    if(walkPool.started){
+        return;
+    }
+    walkPool.started = true;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if(cores <= 1){
+        return;
+    }
+    walkPool.threads = avAllocate(sizeof(pthread_t) * (cores - 1), "walk threads");
+    for(long i = 0; i < cores - 1; i++){
+        if(pthread_create(walkPool.threads + walkPool.threadCount, nullptr, walkPoolWorker, nullptr) == 0){
+            walkPool.threadCount++;
+        }
+    }
+}
+#endif
+
+void fileWalkPoolDestroy(){
+#ifndef _WIN32
+    pthread_mutex_lock(&walkPool.mutex);
+    walkPool.stopping = true;
+    pthread_cond_broadcast(&walkPool.changed);
+    pthread_mutex_unlock(&walkPool.mutex);
+    for(uint32 i = 0; i < walkPool.threadCount; i++){
+        pthread_join(walkPool.threads[i], nullptr);
+    }
+    if(walkPool.threads){
+        avFree(walkPool.threads);
+    }
+    walkPool.started = false;
+    walkPool.stopping = false;
+    walkPool.threadCount = 0;
+    walkPool.threads = nullptr;
+    walkPool.walk = nullptr;
+    walkPool.generation = 0;
+#endif
+}
+
+struct FileWalk* fileWalkCreate(bool32 recursive, bool32 dirs, uint32 suffixCount, const AvString* suffixes){
+    struct FileWalk* walk = avCallocate(1, sizeof(struct FileWalk), "file walk");
+    walk->recursive = recursive;
+    walk->dirs = dirs;
+    walk->suffixCount = suffixCount;
+    walk->suffixes = suffixes;
+#ifndef _WIN32
+    pthread_mutex_init(&walk->mutex, nullptr);
+    pthread_cond_init(&walk->changed, nullptr);
+#endif
+    return walk;
+}
+
+void fileWalkAdd(struct FileWalk* walk, AvString directory){
+    avAssert(walk->count == walk->rootCount, "directories have to be added before the walk");
+    appendDirectory(walk, createDirectory("", 0, directory.chrs, directory.len));
+    walk->rootCount++;
+}
+
+// reads every directory of the walk, subtrees are read in parallel when walking recursively
+void fileWalkRun(struct FileWalk* walk){
+    struct WalkBuffer buffer;
+    createBuffer(&buffer);
+#ifndef _WIN32
+    if(walk->recursive && pthread_mutex_trylock(&walkPool.running) == 0){
+        pthread_mutex_lock(&walkPool.mutex);
+        startWalkPool();
+        walkPool.walk = walk;
+        walkPool.generation++;
+        pthread_cond_broadcast(&walkPool.changed);
+        pthread_mutex_unlock(&walkPool.mutex);
+
+        walkDirectories(walk, &buffer);
+
+        pthread_mutex_lock(&walkPool.mutex);
+        walkPool.walk = nullptr;
+        while(walkPool.busy){
+            pthread_cond_wait(&walkPool.changed, &walkPool.mutex);
+        }
+        pthread_mutex_unlock(&walkPool.mutex);
+        pthread_mutex_unlock(&walkPool.running);
+        destroyBuffer(&buffer);
+        return;
+    }
+#endif
+    walkDirectories(walk, &buffer);
+    destroyBuffer(&buffer);
+}
+
+bool32 fileWalkNextFailure(struct FileWalk* walk, uint32* iterator, AvString* path){
+    while(*iterator < walk->count){
+        struct WalkDirectory* directory = walk->directories[(*iterator)++];
+        if(directory->failed){
+            *path = (AvString){
+                .chrs = directory->path,
+                .len = directory->pathLength,
+                .memory = nullptr,
+            };
+            return true;
+        }
+    }
+    return false;
+}
+
+static void countDirectory(struct FileWalk* walk, struct WalkDirectory* directory, uint32* count, uint64* size){
+    for(uint32 i = 0; i < directory->entryCount; i++){
+        struct WalkEntry entry = directory->entries[i];
+        if(entry.child){
+            countDirectory(walk, walk->directories[entry.child - 1], count, size);
+        }
+        if(entry.listed){
+            bool32 separator = directory->pathLength && directory->path[directory->pathLength - 1] != '/';
+            (*count)++;
+            *size += directory->pathLength + separator + entry.length + 1;
+        }
+    }
+}
+
+uint32 fileWalkCount(struct FileWalk* walk, uint64* size){
+    uint32 count = 0;
+    *size = 0;
+    for(uint32 i = 0; i < walk->rootCount; i++){
+        countDirectory(walk, walk->directories[i], &count, size);
+    }
+    return count;
+}
+
+static void writeDirectory(struct FileWalk* walk, struct WalkDirectory* directory, char** block, struct ConstValue** values){
+    for(uint32 i = 0; i < directory->entryCount; i++){
+        struct WalkEntry entry = directory->entries[i];
+        if(entry.child){
+            writeDirectory(walk, walk->directories[entry.child - 1], block, values);
+        }
+        if(!entry.listed){
+            continue;
+        }
+        char* path = *block;
+        bool32 separator = directory->pathLength && directory->path[directory->pathLength - 1] != '/';
+        memcpy(path, directory->path, directory->pathLength);
+        if(separator){
+            path[directory->pathLength] = '/';
+        }
+        memcpy(path + directory->pathLength + separator, directory->names + entry.name, entry.length);
+        uint64 length = directory->pathLength + separator + entry.length;
+        path[length] = '\0';
+        **values = (struct ConstValue){
+            .type = VALUE_TYPE_STRING,
+            .asString = {
+                .chrs = path,
+                .len = length,
+                .memory = nullptr,
+            },
+        };
+        (*values)++;
+        *block += length + 1;
+    }
+}
+
+// writes the paths into one block of the size returned by fileWalkCount, in the order a depth first walk lists them
+void fileWalkWrite(struct FileWalk* walk, char* block, struct ConstValue* values){
+    for(uint32 i = 0; i < walk->rootCount; i++){
+        writeDirectory(walk, walk->directories[i], &block, &values);
+    }
+}
+
+void fileWalkDestroy(struct FileWalk* walk){
+    for(uint32 i = 0; i < walk->count; i++){
+        destroyDirectory(walk->directories[i]);
+    }
+    if(walk->directories){
+        avFree(walk->directories);
+    }
+#ifndef _WIN32
+    pthread_cond_destroy(&walk->changed);
+    pthread_mutex_destroy(&walk->mutex);
+#endif
+    avFree(walk);
+}
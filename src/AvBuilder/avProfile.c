@@ -0,0 +1,251 @@
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PROFILE_BUCKET_COUNT 256
+#define PROFILE_NONE ((uint32)-1)
+
+// counted by projectAllocate, see avBuilder.h
+_Thread_local uint64 profileAllocatedBytes = 0;
+
+struct ProfileFunction {
+    char* name;
+    uint64 nameLength;
+    uint64 hash;
+    uint32 next; // in the same bucket
+    uint32 depth; // calls currently running, a recursive call only counts towards the inclusive totals once
+    uint64 calls;
+    uint64 inclusiveTime;
+    uint64 exclusiveTime;
+    uint64 inclusiveBytes;
+    uint64 exclusiveBytes;
+};
+
+// a function reached through a particular chain of callers, its exclusive time is a line of the folded stacks
+struct ProfileNode {
+    uint32 function;
+    uint32 parent;
+    uint32 child;
+    uint32 sibling;
+    uint64 time;
+};
+
+struct ProfileFrame {
+    uint32 node;
+    uint64 start;
+    uint64 bytes;
+    uint64 childTime;
+    uint64 childBytes;
+};
+
+// only the thread running the scripts enters functions, commands of the job pool are not part of the profile
+static struct {
+    bool32 enabled;
+    uint32 buckets[PROFILE_BUCKET_COUNT];
+    uint32 functionCount;
+    uint32 functionCapacity;
+    struct ProfileFunction* functions;
+    uint32 nodeCount;
+    uint32 nodeCapacity;
+    struct ProfileNode* nodes;
+    uint32 frameCount;
+    uint32 frameCapacity;
+    struct ProfileFrame* frames;
+} profile = {0};
+
+static void* growArray(void* data, uint32 count, uint32* capacity, uint64 elementSize, const char* name){
+    if(count < *capacity){
+        return data;
+    }
+    uint32 newCapacity = *capacity ? *capacity * 2 : 64;
+    void* newData = avAllocate(newCapacity * elementSize, name);
+    if(data){
+        memcpy(newData, data, count * elementSize);
+        avFree(data);
+    }
+    *capacity = newCapacity;
+    return newData;
+}
+
+static uint32 findProfiledFunction(AvString name){
+    uint64 hash = hashString(name, HASH_SEED);
+    uint32* bucket = profile.buckets + hash % PROFILE_BUCKET_COUNT;
+    for(uint32 index = *bucket; index != PROFILE_NONE; index = profile.functions[index].next){
+        struct ProfileFunction* function = profile.functions + index;
+        if(function->hash == hash && function->nameLength == name.len && memcmp(function->name, name.chrs, name.len) == 0){
+            return index;
+        }
+    }
+    profile.functions = growArray(profile.functions, profile.functionCount, &profile.functionCapacity, sizeof(struct ProfileFunction), "profiled functions");
+    uint32 index = profile.functionCount++;
+    struct ProfileFunction* function = profile.functions + index;
+    memset(function, 0, sizeof(struct ProfileFunction));
+    // the names point into projects, which might be unloaded before the profile is written
+    function->name = avAllocate(name.len + 1, "profiled function name");
+    memcpy(function->name, name.chrs, name.len);
+    function->name[name.len] = '\0';
+    function->nameLength = name.len;
+    function->hash = hash;
+    function->next = *bucket;
+    *bucket = index;
+    return index;
+}
+
+static uint32 findNode(uint32 parent, uint32 function){
+    uint32* link = &profile.nodes[parent].child;
+    for(uint32 index = *link; index != PROFILE_NONE; index = profile.nodes[index].sibling){
+        if(profile.nodes[index].function == function){
+            return index;
+        }
+    }
+    profile.nodes = growArray(profile.nodes, profile.nodeCount, &profile.nodeCapacity, sizeof(struct ProfileNode), "profile call tree");
+    uint32 index = profile.nodeCount++;
+    profile.nodes[index] = (struct ProfileNode){
+        .function = function,
+        .parent = parent,
+        .child = PROFILE_NONE,
+        .sibling = profile.nodes[parent].child,
+        .time = 0,
+    };
+    profile.nodes[parent].child = index;
+    return index;
+}
+
+static void profileClear(){
+    for(uint32 i = 0; i < profile.functionCount; i++){
+        avFree(profile.functions[i].name);
+    }
+    if(profile.functions){
+        avFree(profile.functions);
+    }
+    if(profile.nodes){
+        avFree(profile.nodes);
+    }
+    if(profile.frames){
+        avFree(profile.frames);
+    }
+    memset(&profile, 0, sizeof(profile));
+}
+
+void profileOpen(){
+    profileClear();
+    memset(profile.buckets, 0xff, sizeof(profile.buckets));
+    profile.nodes = growArray(profile.nodes, 0, &profile.nodeCapacity, sizeof(struct ProfileNode), "profile call tree");
+    // the root of the call tree, above the entry function
+    profile.nodes[0] = (struct ProfileNode){
+        .function = PROFILE_NONE,
+        .parent = PROFILE_NONE,
+        .child = PROFILE_NONE,
+        .sibling = PROFILE_NONE,
+    };
+    profile.nodeCount = 1;
+    profile.enabled = true;
+}
+
+void profileEnter(AvString name){
+    if(!profile.enabled){
+        return;
+    }
+    uint32 parent = profile.frameCount ? profile.frames[profile.frameCount - 1].node : 0;
+    uint32 function = findProfiledFunction(name);
+    profile.functions[function].depth++;
+    profile.frames = growArray(profile.frames, profile.frameCount, &profile.frameCapacity, sizeof(struct ProfileFrame), "profile frames");
+    profile.frames[profile.frameCount++] = (struct ProfileFrame){
+        .node = findNode(parent, function),
+        .bytes = profileAllocatedBytes,
+        .start = monotonicTime(),
+    };
+}
+
+void profileLeave(){
+    if(!profile.enabled || profile.frameCount == 0){
+        return;
+    }
+    uint64 end = monotonicTime();
+    struct ProfileFrame frame = profile.frames[--profile.frameCount];
+    uint64 time = end - frame.start;
+    uint64 bytes = profileAllocatedBytes - frame.bytes;
+    struct ProfileNode* node = profile.nodes + frame.node;
+    struct ProfileFunction* function = profile.functions + node->function;
+    function->calls++;
+    function->exclusiveTime += time - frame.childTime;
+    function->exclusiveBytes += bytes - frame.childBytes;
+    if(--function->depth == 0){
+        function->inclusiveTime += time;
+        function->inclusiveBytes += bytes;
+    }
+    node->time += time - frame.childTime;
+    if(profile.frameCount){
+        profile.frames[profile.frameCount - 1].childTime += time;
+        profile.frames[profile.frameCount - 1].childBytes += bytes;
+    }
+}
+
+static int compareFunctions(const void* a, const void* b){
+    const struct ProfileFunction* left = *(const struct ProfileFunction**)a;
+    const struct ProfileFunction* right = *(const struct ProfileFunction**)b;
+    if(left->exclusiveTime != right->exclusiveTime){
+        return left->exclusiveTime < right->exclusiveTime ? 1 : -1;
+    }
+    return left->inclusiveTime < right->inclusiveTime ? 1 : left->inclusiveTime > right->inclusiveTime ? -1 : 0;
+}
+
+static void writeStack(FILE* file, uint32 node){
+    if(profile.nodes[node].parent != 0){
+        writeStack(file, profile.nodes[node].parent);
+        putc(';', file);
+    }
+    fputs(profile.functions[profile.nodes[node].function].name, file);
+}
+
+// one line per call chain, "entry;caller;function <microseconds>", as read by flamegraph.pl and speedscope
+static void writeFoldedStacks(AvString fileName){
+    char path[fileName.len + 1];
+    memcpy(path, fileName.chrs, fileName.len);
+    path[fileName.len] = '\0';
+    FILE* file = fopen(path, "w");
+    if(file == nullptr){
+        avStringPrintf(AV_CSTR("unable to write profile to %s\n"), fileName);
+        return;
+    }
+    for(uint32 i = 1; i < profile.nodeCount; i++){
+        uint64 time = profile.nodes[i].time / 1000;
+        if(time == 0){
+            continue;
+        }
+        writeStack(file, i);
+        fprintf(file, " %llu\n", (unsigned long long)time);
+    }
+    fclose(file);
+}
+
+// prints the functions by their exclusive time and writes the folded stacks to fileName
+void profileClose(AvString fileName){
+    if(!profile.enabled){
+        return;
+    }
+    // functions still running when the run failed
+    while(profile.frameCount){
+        profileLeave();
+    }
+    if(profile.functionCount){
+        struct ProfileFunction** sorted = avAllocate(sizeof(struct ProfileFunction*) * profile.functionCount, "profile table");
+        for(uint32 i = 0; i < profile.functionCount; i++){
+            sorted[i] = profile.functions + i;
+        }
+        qsort(sorted, profile.functionCount, sizeof(struct ProfileFunction*), compareFunctions);
+        printf("\nProfile:\n");
+        printf("%10s %14s %14s %14s %14s  %s\n", "calls", "inclusive ms", "exclusive ms", "inclusive KB", "exclusive KB", "function");
+        for(uint32 i = 0; i < profile.functionCount; i++){
+            struct ProfileFunction* function = sorted[i];
+            printf("%10llu %14.3f %14.3f %14.1f %14.1f  %s\n", (unsigned long long)function->calls,
+                function->inclusiveTime / 1000000.0, function->exclusiveTime / 1000000.0,
+                function->inclusiveBytes / 1024.0, function->exclusiveBytes / 1024.0, function->name);
+        }
+        avFree(sorted);
+        writeFoldedStacks(fileName);
+    }
+    profileClear();
+}
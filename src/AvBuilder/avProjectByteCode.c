@@ -0,0 +1,364 @@
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <AvUtils/logging/avAssert.h>
+#include <AvUtils/memory/avAllocator.h>
+#include <string.h>
+
+#define AV_DYNAMIC_ARRAY_EXPOSE_MEMORY_LAYOUT
+#include <AvUtils/dataStructures/avDynamicArray.h>
+
+#include "avProjectLang.h"
+#include "avBuilderByteCode.h"
+
+#define NULL_VALUE (struct Value){0}
+
+void runtimeError(Project* project, const char* message, ...);
+uint32 parseNumber(AvString string);
+void sanitizeString(AvStringRef str, Project* project);
+struct Value retrieveVariableValue(struct IdentifierExpression_S identifier, Project* project);
+struct Value enumerateFiles(struct EnumerationExpression_S enumeration, Project* project);
+struct Value filterValues(struct FilterExpression_S filter, Project* project);
+struct Value callFunction(struct CallExpression_S call, Project* project);
+struct ArrayValue makeArray(uint32 count, struct Value* elements, Project* project);
+struct Value applyUnary(enum UnaryOperator operator, struct Value value, Project* project);
+struct Value applySummation(struct Value left, enum SummationOperator operator, struct Value right, Project* project);
+struct Value applyMultiplication(struct Value left, enum MultiplicationOperator operator, struct Value right, Project* project);
+struct Value applyComparison(struct Value left, enum ComparisonOperator operator, struct Value right, Project* project);
+
+struct ExpressionCompiler {
+    AV_DS(AvDynamicArray, struct Instruction) instructions;
+    AV_DS(AvDynamicArray, struct Value) constants;
+    uint32 depth;
+    uint32 maxDepth;
+    Project* project;
+};
+
+static void emit(struct ExpressionCompiler* compiler, enum ExpressionOperations operation, uint32 operand, struct Expression_S* expression, int32 stackEffect){
+    struct Instruction instruction = {
+        .operation = operation,
+        .operand = operand,
+        .expression = expression,
+    };
+    avDynamicArrayAdd(&instruction, compiler->instructions);
+    compiler->depth += stackEffect;
+    if(compiler->depth > compiler->maxDepth){
+        compiler->maxDepth = compiler->depth;
+    }
+}
+
+static void emitConstant(struct ExpressionCompiler* compiler, struct Value value){
+    uint32 index = avDynamicArrayGetSize(compiler->constants);
+    avDynamicArrayAdd(&value, compiler->constants);
+    emit(compiler, OP_CST, index, nullptr, 1);
+}
+
+// expressions made of literals and operators only, their value never changes
+static bool32 isConstant(struct Expression_S* expression){
+    switch(expression->type){
+        case EXPRESSION_TYPE_NONE:
+        case EXPRESSION_TYPE_LITERAL:
+        case EXPRESSION_TYPE_NUMBER:
+            return true;
+        case EXPRESSION_TYPE_ARRAY:
+            for(uint32 i = 0; i < expression->array.length; i++){
+                if(!isConstant(expression->array.elements + i)){
+                    return false;
+                }
+            }
+            return true;
+        case EXPRESSION_TYPE_GROUPING:
+            return isConstant(expression->grouping.expression);
+        case EXPRESSION_TYPE_UNARY:
+            return isConstant(expression->unary.expression);
+        case EXPRESSION_TYPE_SUMMATION:
+            return isConstant(expression->summation.left) && isConstant(expression->summation.right);
+        case EXPRESSION_TYPE_MULTIPLICATION:
+            return isConstant(expression->multiplication.left) && isConstant(expression->multiplication.right);
+        case EXPRESSION_TYPE_COMPARISON:
+            return isConstant(expression->comparison.left) && isConstant(expression->comparison.right);
+        default:
+            return false;
+    }
+}
+
+// evaluates a constant expression once while compiling
+static struct Value foldConstant(struct ExpressionCompiler* compiler, struct Expression_S* expression){
+    Project* project = compiler->project;
+    switch(expression->type){
+        case EXPRESSION_TYPE_LITERAL:{
+            AvString str = {
+                .chrs = expression->literal.value.chrs + 1,
+                .len = expression->literal.value.len - 2,
+                .memory = nullptr,
+            };
+            sanitizeString(&str, project);
+            return (struct Value){
+                .type = VALUE_TYPE_STRING,
+                .asString = str,
+            };
+        }
+        case EXPRESSION_TYPE_NUMBER:
+            return (struct Value){
+                .type = VALUE_TYPE_NUMBER,
+                .asNumber = parseNumber(expression->number.value),
+            };
+        case EXPRESSION_TYPE_ARRAY:{
+            uint32 count = expression->array.length;
+            struct Value elements[count + 1];
+            for(uint32 i = 0; i < count; i++){
+                elements[i] = foldConstant(compiler, expression->array.elements + i);
+            }
+            struct Value value = {
+                .type = VALUE_TYPE_ARRAY,
+                .asArray = makeArray(count, elements, project),
+            };
+            value.asArray.shared = true;
+            return value;
+        }
+        case EXPRESSION_TYPE_GROUPING:
+            return foldConstant(compiler, expression->grouping.expression);
+        case EXPRESSION_TYPE_UNARY:
+            return applyUnary(expression->unary.operator, foldConstant(compiler, expression->unary.expression), project);
+        case EXPRESSION_TYPE_SUMMATION:{
+            struct Value left = foldConstant(compiler, expression->summation.left);
+            struct Value right = foldConstant(compiler, expression->summation.right);
+            return applySummation(left, expression->summation.operator, right, project);
+        }
+        case EXPRESSION_TYPE_MULTIPLICATION:{
+            struct Value left = foldConstant(compiler, expression->multiplication.left);
+            struct Value right = foldConstant(compiler, expression->multiplication.right);
+            return applyMultiplication(left, expression->multiplication.operator, right, project);
+        }
+        case EXPRESSION_TYPE_COMPARISON:{
+            struct Value left = foldConstant(compiler, expression->comparison.left);
+            struct Value right = foldConstant(compiler, expression->comparison.right);
+            return applyComparison(left, expression->comparison.operator, right, project);
+        }
+        default:
+            return (struct Value){
+                .type = VALUE_TYPE_ARRAY,
+                .asArray = {
+                    .count = 0,
+                    .values = nullptr,
+                },
+            };
+    }
+}
+
+static void compile(struct ExpressionCompiler* compiler, struct Expression_S* expression){
+    // constant sub expressions become a single constant, evaluating them is a load without allocations
+    if(isConstant(expression)){
+        emitConstant(compiler, foldConstant(compiler, expression));
+        return;
+    }
+    switch(expression->type){
+        case EXPRESSION_TYPE_NONE:
+        case EXPRESSION_TYPE_LITERAL:
+        case EXPRESSION_TYPE_NUMBER:
+            avAssert(false, "constants are folded");
+            break;
+        case EXPRESSION_TYPE_ARRAY:
+            for(uint32 i = 0; i < expression->array.length; i++){
+                compile(compiler, expression->array.elements + i);
+            }
+            emit(compiler, OP_ARR, expression->array.length, nullptr, 1 - (int32)expression->array.length);
+            break;
+        case EXPRESSION_TYPE_GROUPING:
+            compile(compiler, expression->grouping.expression);
+            break;
+        case EXPRESSION_TYPE_UNARY:
+            compile(compiler, expression->unary.expression);
+            switch(expression->unary.operator){
+                case UNARY_OPERATOR_MINUS:
+                    emit(compiler, OP_NEG, 0, nullptr, 0);
+                    break;
+                case UNARY_OPERATOR_NOT:
+                    emit(compiler, OP_NOT, 0, nullptr, 0);
+                    break;
+                case UNARY_OPERATOR_NONE:
+                    avAssert(false, "should not reach here");
+                    break;
+            }
+            break;
+        case EXPRESSION_TYPE_SUMMATION:
+            compile(compiler, expression->summation.left);
+            compile(compiler, expression->summation.right);
+            switch(expression->summation.operator){
+                case SUMMATION_OPERATOR_ADD:
+                    emit(compiler, OP_ADD, 0, nullptr, -1);
+                    break;
+                case SUMMATION_OPERATOR_SUBTRACT:
+                    emit(compiler, OP_SBT, 0, nullptr, -1);
+                    break;
+                case SUMMATION_OPERATOR_NONE:
+                    avAssert(false, "should not reach here");
+                    break;
+            }
+            break;
+        case EXPRESSION_TYPE_MULTIPLICATION:
+            compile(compiler, expression->multiplication.left);
+            compile(compiler, expression->multiplication.right);
+            switch(expression->multiplication.operator){
+                case MULTIPLICATION_OPERATOR_MULTIPLY:
+                    emit(compiler, OP_MLT, 0, nullptr, -1);
+                    break;
+                case MULTIPLICATION_OPERATOR_DIVIDE:
+                    emit(compiler, OP_DVD, 0, nullptr, -1);
+                    break;
+                case MULTIPLICATION_OPERATOR_NONE:
+                    avAssert(false, "should not reach here");
+                    break;
+            }
+            break;
+        case EXPRESSION_TYPE_COMPARISON:
+            compile(compiler, expression->comparison.left);
+            compile(compiler, expression->comparison.right);
+            emit(compiler, OP_CMP, expression->comparison.operator, nullptr, -1);
+            break;
+        // these evaluate their own sub expressions, which are compiled separately
+        case EXPRESSION_TYPE_IDENTIFIER:
+            emit(compiler, OP_VAR, 0, expression, 1);
+            break;
+        case EXPRESSION_TYPE_ENUMERATION:
+            emit(compiler, OP_ENM, 0, expression, 1);
+            break;
+        case EXPRESSION_TYPE_FILTER:
+            emit(compiler, OP_FLT, 0, expression, 1);
+            break;
+        case EXPRESSION_TYPE_CALL:
+            emit(compiler, OP_CLL, 0, expression, 1);
+            break;
+    }
+}
+
+struct ExpressionByteCode* compileExpression(struct Expression_S* expression, Project* project){
+    struct ExpressionCompiler compiler = {
+        .project = project,
+    };
+    avDynamicArrayCreate(0, sizeof(struct Instruction), &compiler.instructions);
+    avDynamicArrayCreate(0, sizeof(struct Value), &compiler.constants);
+
+    compile(&compiler, expression);
+    emit(&compiler, OP_RET, 0, nullptr, 0);
+
+    struct ExpressionByteCode* byteCode = projectAllocate(project, sizeof(struct ExpressionByteCode));
+    byteCode->instructionCount = avDynamicArrayGetSize(compiler.instructions);
+    byteCode->stackSize = compiler.maxDepth;
+    byteCode->instructions = projectAllocate(project, sizeof(struct Instruction) * byteCode->instructionCount);
+    avDynamicArrayReadRange(byteCode->instructions, byteCode->instructionCount, 0, sizeof(struct Instruction), 0, compiler.instructions);
+    uint32 constantCount = avDynamicArrayGetSize(compiler.constants);
+    byteCode->constants = nullptr;
+    if(constantCount){
+        byteCode->constants = projectAllocate(project, sizeof(struct Value) * constantCount);
+        avDynamicArrayReadRange(byteCode->constants, constantCount, 0, sizeof(struct Value), 0, compiler.constants);
+    }
+
+    avDynamicArrayDestroy(compiler.instructions);
+    avDynamicArrayDestroy(compiler.constants);
+    return byteCode;
+}
+
+// gcc and clang jump straight from one handler to the next through a table of label addresses, other compilers
+// go through the switch
+#if defined(__GNUC__)
+#define BYTE_CODE_COMPUTED_GOTO
+#endif
+
+struct Value runExpressionByteCode(struct ExpressionByteCode* byteCode, Project* project){
+    struct Value stack[byteCode->stackSize + 1];
+    struct Value* top = stack - 1;
+    const struct Instruction* instruction = byteCode->instructions;
+
+#ifdef BYTE_CODE_COMPUTED_GOTO
+    static void* const dispatchTable[] = {
+        [OP_CST - OP_CST] = &&op_cst,
+        [OP_VAR - OP_CST] = &&op_var,
+        [OP_ARR - OP_CST] = &&op_arr,
+        [OP_ADD - OP_CST] = &&op_add,
+        [OP_SBT - OP_CST] = &&op_sbt,
+        [OP_MLT - OP_CST] = &&op_mlt,
+        [OP_DVD - OP_CST] = &&op_dvd,
+        [OP_NEG - OP_CST] = &&op_neg,
+        [OP_NOT - OP_CST] = &&op_not,
+        [OP_CMP - OP_CST] = &&op_cmp,
+        [OP_CLL - OP_CST] = &&op_cll,
+        [OP_ENM - OP_CST] = &&op_enm,
+        [OP_FLT - OP_CST] = &&op_flt,
+        [OP_RET - OP_CST] = &&op_ret,
+    };
+#define HANDLER(operation, label) label
+#define DISPATCH() instruction++; goto *dispatchTable[instruction->operation - OP_CST]
+    goto *dispatchTable[instruction->operation - OP_CST];
+#else
+#define HANDLER(operation, label) case operation
+#define DISPATCH() instruction++; continue
+    for(;;) switch(instruction->operation){
+#endif
+
+HANDLER(OP_CST, op_cst):
+    *(++top) = byteCode->constants[instruction->operand];
+    DISPATCH();
+HANDLER(OP_VAR, op_var):
+    *(++top) = retrieveVariableValue(instruction->expression->identifier, project);
+    DISPATCH();
+HANDLER(OP_ARR, op_arr):{
+    uint32 count = instruction->operand;
+    top -= count;
+    struct ArrayValue array = makeArray(count, top + 1, project);
+    (++top)->type = VALUE_TYPE_ARRAY;
+    top->asArray = array;
+    DISPATCH();
+}
+HANDLER(OP_ADD, op_add):
+    top--;
+    if(top[0].type == VALUE_TYPE_NUMBER && top[1].type == VALUE_TYPE_NUMBER){
+        top->asNumber += top[1].asNumber;
+    }else{
+        *top = applySummation(top[0], SUMMATION_OPERATOR_ADD, top[1], project);
+    }
+    DISPATCH();
+HANDLER(OP_SBT, op_sbt):
+    top--;
+    *top = applySummation(top[0], SUMMATION_OPERATOR_SUBTRACT, top[1], project);
+    DISPATCH();
+HANDLER(OP_MLT, op_mlt):
+    top--;
+    *top = applyMultiplication(top[0], MULTIPLICATION_OPERATOR_MULTIPLY, top[1], project);
+    DISPATCH();
+HANDLER(OP_DVD, op_dvd):
+    top--;
+    *top = applyMultiplication(top[0], MULTIPLICATION_OPERATOR_DIVIDE, top[1], project);
+    DISPATCH();
+HANDLER(OP_NEG, op_neg):
+    *top = applyUnary(UNARY_OPERATOR_MINUS, *top, project);
+    DISPATCH();
+HANDLER(OP_NOT, op_not):
+    *top = applyUnary(UNARY_OPERATOR_NOT, *top, project);
+    DISPATCH();
+HANDLER(OP_CMP, op_cmp):
+    top--;
+    *top = applyComparison(top[0], instruction->operand, top[1], project);
+    DISPATCH();
+HANDLER(OP_CLL, op_cll):
+    *(++top) = callFunction(instruction->expression->call, project);
+    DISPATCH();
+HANDLER(OP_ENM, op_enm):
+    *(++top) = enumerateFiles(instruction->expression->enumeration, project);
+    DISPATCH();
+HANDLER(OP_FLT, op_flt):
+    *(++top) = filterValues(instruction->expression->filter, project);
+    DISPATCH();
+HANDLER(OP_RET, op_ret):
+    if(top < stack){
+        return NULL_VALUE;
+    }
+    return *top;
+#ifndef BYTE_CODE_COMPUTED_GOTO
+    default:
+        avAssert(false, "invalid byte code operation");
+        return NULL_VALUE;
+    }
+#endif
+#undef HANDLER
+#undef DISPATCH
+}
@@ -0,0 +1,598 @@
+// PATH_MAX is not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <AvUtils/memory/avAllocator.h>
+#include <AvUtils/dataStructures/avDynamicArray.h>
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "avProjectLang.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#define PROJECT_CACHE_DIR BUILD_DATABASE_DIR "/ast"
+#define PROJECT_CACHE_MAGIC 0x5453416a6f725061ull // "aProjAST"
+#define PROJECT_CACHE_FILE_NAME_SIZE (PATH_MAX + 64)
+
+// bumped whenever what is written for a statement changes without changing the layout of the structs
+#define PROJECT_CACHE_FORMAT_VERSION 2
+
+// the image is the processed statement tree with every pointer stored as an offset from the start of
+// the image. Loading maps it privately and adds the base address at every offset in the relocation table
+struct ProjectCacheHeader {
+    uint64 magic;
+    uint64 signature;
+    uint64 sourceTime;
+    uint64 sourceSize;
+    uint64 sourceHash;
+    uint64 imageSize;
+    uint64 name;             // offset of the project name
+    uint64 nameLength;
+    uint64 statements;       // offset of the statement pointers
+    uint64 statementCount;
+    uint64 relocations;      // offset of the relocation table
+    uint64 relocationCount;
+};
+
+#ifndef _WIN32
+struct ProjectCacheWriter {
+    char* data;
+    uint64 size;
+    uint64 capacity;
+    AV_DS(AvDynamicArray, uint64) relocations;
+};
+
+#define AT(writer, offset, type) ((type*)((writer)->data + (offset)))
+
+static uint64 reserve(struct ProjectCacheWriter* writer, uint64 size, uint64 alignment){
+    uint64 offset = (writer->size + alignment - 1) & ~(alignment - 1);
+    if(offset + size > writer->capacity){
+        uint64 capacity = writer->capacity ? writer->capacity : 4096;
+        while(offset + size > capacity){
+            capacity *= 2;
+        }
+        char* data = avCallocate(capacity, 1, "project cache image");
+        memcpy(data, writer->data, writer->size);
+        avFree(writer->data);
+        writer->data = data;
+        writer->capacity = capacity;
+    }
+    writer->size = offset + size;
+    return offset;
+}
+
+static void writePointer(struct ProjectCacheWriter* writer, uint64 field, uint64 target){
+    *AT(writer, field, uint64) = target;
+    avDynamicArrayAdd(&field, writer->relocations);
+}
+
+static void writeString(struct ProjectCacheWriter* writer, uint64 field, AvString str){
+    memset(AT(writer, field, AvString), 0, sizeof(AvString));
+    if(str.chrs == nullptr){
+        return;
+    }
+    uint64 chrs = reserve(writer, str.len + 1, 1);
+    memcpy(AT(writer, chrs, char), str.chrs, str.len);
+    AT(writer, field, AvString)->len = str.len;
+    writePointer(writer, field + offsetof(AvString, chrs), chrs);
+}
+
+#define FIELD(at, type, member) ((at) + offsetof(type, member))
+
+static void writeExpression(struct ProjectCacheWriter* writer, uint64 at, const struct Expression_S* expression);
+static void writePerformBody(struct ProjectCacheWriter* writer, uint64 at, const struct PerformStatementBody_S* body);
+static void writeFunctionBody(struct ProjectCacheWriter* writer, uint64 at, const struct FunctionBody_S* body);
+
+static void writeExpressionPointer(struct ProjectCacheWriter* writer, uint64 field, const struct Expression_S* expression){
+    *AT(writer, field, uint64) = 0;
+    if(expression == nullptr){
+        return;
+    }
+    uint64 target = reserve(writer, sizeof(struct Expression_S), 8);
+    writeExpression(writer, target, expression);
+    writePointer(writer, field, target);
+}
+
+static void writeExpressionArray(struct ProjectCacheWriter* writer, uint64 field, const struct Expression_S* expressions, uint32 count){
+    *AT(writer, field, uint64) = 0;
+    if(expressions == nullptr){
+        return;
+    }
+    uint64 target = reserve(writer, sizeof(struct Expression_S) * count, 8);
+    for(uint32 i = 0; i < count; i++){
+        writeExpression(writer, target + sizeof(struct Expression_S) * i, expressions + i);
+    }
+    writePointer(writer, field, target);
+}
+
+static void writeCall(struct ProjectCacheWriter* writer, uint64 at, const struct CallExpression_S* call){
+    writeString(writer, FIELD(at, struct CallExpression_S, function), call->function);
+    writeExpressionArray(writer, FIELD(at, struct CallExpression_S, arguments), call->arguments, call->argumentCount);
+}
+
+static void writeExpression(struct ProjectCacheWriter* writer, uint64 at, const struct Expression_S* expression){
+    memcpy(AT(writer, at, struct Expression_S), expression, sizeof(struct Expression_S));
+    AT(writer, at, struct Expression_S)->byteCode = nullptr;
+    switch(expression->type){
+        case EXPRESSION_TYPE_NONE:
+            break;
+        case EXPRESSION_TYPE_ARRAY:
+            writeExpressionArray(writer, FIELD(at, struct Expression_S, array.elements), expression->array.elements, expression->array.length);
+            break;
+        case EXPRESSION_TYPE_SUMMATION:
+            writeExpressionPointer(writer, FIELD(at, struct Expression_S, summation.left), expression->summation.left);
+            writeExpressionPointer(writer, FIELD(at, struct Expression_S, summation.right), expression->summation.right);
+            break;
+        case EXPRESSION_TYPE_MULTIPLICATION:
+            writeExpressionPointer(writer, FIELD(at, struct Expression_S, multiplication.left), expression->multiplication.left);
+            writeExpressionPointer(writer, FIELD(at, struct Expression_S, multiplication.right), expression->multiplication.right);
+            break;
+        case EXPRESSION_TYPE_ENUMERATION:
+            writeExpressionPointer(writer, FIELD(at, struct Expression_S, enumeration.directory), expression->enumeration.directory);
+            break;
+        case EXPRESSION_TYPE_UNARY:
+            writeExpressionPointer(writer, FIELD(at, struct Expression_S, unary.expression), expression->unary.expression);
+            break;
+        case EXPRESSION_TYPE_FILTER:
+            writeExpressionPointer(writer, FIELD(at, struct Expression_S, filter.expression), expression->filter.expression);
+            writeExpressionArray(writer, FIELD(at, struct Expression_S, filter.filters), expression->filter.filters, expression->filter.filterCount);
+            break;
+        case EXPRESSION_TYPE_CALL:
+            writeCall(writer, FIELD(at, struct Expression_S, call), &expression->call);
+            break;
+        case EXPRESSION_TYPE_GROUPING:
+            writeExpressionPointer(writer, FIELD(at, struct Expression_S, grouping.expression), expression->grouping.expression);
+            break;
+        case EXPRESSION_TYPE_IDENTIFIER:
+            writeString(writer, FIELD(at, struct Expression_S, identifier.identifier), expression->identifier.identifier);
+            break;
+        case EXPRESSION_TYPE_LITERAL:
+            writeString(writer, FIELD(at, struct Expression_S, literal.value), expression->literal.value);
+            break;
+        case EXPRESSION_TYPE_NUMBER:
+            writeString(writer, FIELD(at, struct Expression_S, number.value), expression->number.value);
+            break;
+        case EXPRESSION_TYPE_COMPARISON:
+            writeExpressionPointer(writer, FIELD(at, struct Expression_S, comparison.left), expression->comparison.left);
+            writeExpressionPointer(writer, FIELD(at, struct Expression_S, comparison.right), expression->comparison.right);
+            break;
+    }
+}
+
+static void writeVariableAssignment(struct ProjectCacheWriter* writer, uint64 at, const struct VariableAssignment_S* assignment){
+    writeString(writer, FIELD(at, struct VariableAssignment_S, variableName), assignment->variableName);
+    writeExpressionPointer(writer, FIELD(at, struct VariableAssignment_S, index), assignment->index);
+    writeExpressionPointer(writer, FIELD(at, struct VariableAssignment_S, value), assignment->value);
+}
+
+static void writeVariableDefinition(struct ProjectCacheWriter* writer, uint64 at, const struct VariableDefinition_S* definition){
+    writeString(writer, FIELD(at, struct VariableDefinition_S, identifier), definition->identifier);
+    writeExpressionPointer(writer, FIELD(at, struct VariableDefinition_S, size), definition->size);
+}
+
+static void writeCommandBody(struct ProjectCacheWriter* writer, uint64 at, const struct CommandStatementBody_S* body);
+
+static void writeIfCommand(struct ProjectCacheWriter* writer, uint64 at, const struct IfCommandStatement_S* statement){
+    memcpy(AT(writer, at, struct IfCommandStatement_S), statement, sizeof(struct IfCommandStatement_S));
+    writeExpressionPointer(writer, FIELD(at, struct IfCommandStatement_S, check), statement->check);
+    *AT(writer, FIELD(at, struct IfCommandStatement_S, branch), uint64) = 0;
+    if(statement->branch){
+        uint64 branch = reserve(writer, sizeof(struct CommandStatementBody_S), 8);
+        writeCommandBody(writer, branch, statement->branch);
+        writePointer(writer, FIELD(at, struct IfCommandStatement_S, branch), branch);
+    }
+    *AT(writer, FIELD(at, struct IfCommandStatement_S, alternativeBranch), uint64) = 0;
+    if(statement->alternativeBranch){
+        uint64 alternative = reserve(writer, sizeof(struct IfCommandStatement_S), 8);
+        writeIfCommand(writer, alternative, statement->alternativeBranch);
+        writePointer(writer, FIELD(at, struct IfCommandStatement_S, alternativeBranch), alternative);
+    }
+}
+
+static void writeCommandBody(struct ProjectCacheWriter* writer, uint64 at, const struct CommandStatementBody_S* body){
+    memcpy(AT(writer, at, struct CommandStatementBody_S), body, sizeof(struct CommandStatementBody_S));
+    writeString(writer, FIELD(at, struct CommandStatementBody_S, retCodeVariable), body->retCodeVariable);
+    writeExpressionPointer(writer, FIELD(at, struct CommandStatementBody_S, retCodeIndex), body->retCodeIndex);
+    writeString(writer, FIELD(at, struct CommandStatementBody_S, outputVariable), body->outputVariable);
+    writeExpressionPointer(writer, FIELD(at, struct CommandStatementBody_S, outputVariableIndex), body->outputVariableIndex);
+    writeExpressionPointer(writer, FIELD(at, struct CommandStatementBody_S, pipeFile), body->pipeFile);
+    writeExpressionPointer(writer, FIELD(at, struct CommandStatementBody_S, errorFile), body->errorFile);
+    *AT(writer, FIELD(at, struct CommandStatementBody_S, statements), uint64) = 0;
+    if(body->statements == nullptr){
+        return;
+    }
+    uint64 statements = reserve(writer, sizeof(struct CommandStatement_S) * body->statementCount, 8);
+    for(uint32 i = 0; i < body->statementCount; i++){
+        const struct CommandStatement_S* statement = body->statements + i;
+        uint64 statementAt = statements + sizeof(struct CommandStatement_S) * i;
+        memcpy(AT(writer, statementAt, struct CommandStatement_S), statement, sizeof(struct CommandStatement_S));
+        switch(statement->type){
+            case COMMAND_STATEMENT_VARIABLE_ASSIGNMENT:
+                writeVariableAssignment(writer, FIELD(statementAt, struct CommandStatement_S, variableAssignment), &statement->variableAssignment);
+                break;
+            case COMMAND_STATEMENT_FUNCTION_CALL:
+                writeCall(writer, FIELD(statementAt, struct CommandStatement_S, functionCall), &statement->functionCall);
+                break;
+            case COMMAND_STATEMENT_IF_STATEMENT:
+                writeIfCommand(writer, FIELD(statementAt, struct CommandStatement_S, ifStatement), &statement->ifStatement);
+                break;
+            case COMMAND_STATEMENT_NONE:
+                break;
+        }
+    }
+    writePointer(writer, FIELD(at, struct CommandStatementBody_S, statements), statements);
+}
+
+static void writeIfPerform(struct ProjectCacheWriter* writer, uint64 at, const struct IfPerformStatement_S* statement){
+    memcpy(AT(writer, at, struct IfPerformStatement_S), statement, sizeof(struct IfPerformStatement_S));
+    writeExpressionPointer(writer, FIELD(at, struct IfPerformStatement_S, check), statement->check);
+    *AT(writer, FIELD(at, struct IfPerformStatement_S, branch), uint64) = 0;
+    if(statement->branch){
+        uint64 branch = reserve(writer, sizeof(struct PerformStatementBody_S), 8);
+        writePerformBody(writer, branch, statement->branch);
+        writePointer(writer, FIELD(at, struct IfPerformStatement_S, branch), branch);
+    }
+    *AT(writer, FIELD(at, struct IfPerformStatement_S, alternativeBranch), uint64) = 0;
+    if(statement->alternativeBranch){
+        uint64 alternative = reserve(writer, sizeof(struct IfPerformStatement_S), 8);
+        writeIfPerform(writer, alternative, statement->alternativeBranch);
+        writePointer(writer, FIELD(at, struct IfPerformStatement_S, alternativeBranch), alternative);
+    }
+}
+
+static void writePerformBody(struct ProjectCacheWriter* writer, uint64 at, const struct PerformStatementBody_S* body){
+    memcpy(AT(writer, at, struct PerformStatementBody_S), body, sizeof(struct PerformStatementBody_S));
+    *AT(writer, FIELD(at, struct PerformStatementBody_S, statements), uint64) = 0;
+    if(body->statements == nullptr){
+        return;
+    }
+    uint64 statements = reserve(writer, sizeof(struct PerformStatement_S) * body->statementCount, 8);
+    for(uint32 i = 0; i < body->statementCount; i++){
+        const struct PerformStatement_S* statement = body->statements + i;
+        uint64 statementAt = statements + sizeof(struct PerformStatement_S) * i;
+        memcpy(AT(writer, statementAt, struct PerformStatement_S), statement, sizeof(struct PerformStatement_S));
+        switch(statement->type){
+            case PERFORM_STATEMENT_TYPE_COMMAND:
+                writeCommandBody(writer, FIELD(statementAt, struct PerformStatement_S, commandStatement), &statement->commandStatement);
+                break;
+            case PERFORM_STATEMENT_TYPE_VARIABLE_ASSIGNMENT:
+                writeVariableAssignment(writer, FIELD(statementAt, struct PerformStatement_S, variableAssignment), &statement->variableAssignment);
+                break;
+            case PERFORM_STATEMENT_TYPE_FUNCTION_CALL:
+                writeCall(writer, FIELD(statementAt, struct PerformStatement_S, functionCall), &statement->functionCall);
+                break;
+            case PERFORM_STATEMENT_TYPE_VARIABLE_DEFINITION:
+                writeVariableDefinition(writer, FIELD(statementAt, struct PerformStatement_S, variableDefinition), &statement->variableDefinition);
+                break;
+            case PERFORM_STATEMENT_TYPE_IF_STATEMENT:
+                writeIfPerform(writer, FIELD(statementAt, struct PerformStatement_S, ifStatement), &statement->ifStatement);
+                break;
+            case PERFORM_STATEMENT_TYPE_NONE:
+                break;
+        }
+    }
+    writePointer(writer, FIELD(at, struct PerformStatementBody_S, statements), statements);
+}
+
+static void writeIfFunction(struct ProjectCacheWriter* writer, uint64 at, const struct IfFunctionStatement_S* statement){
+    memcpy(AT(writer, at, struct IfFunctionStatement_S), statement, sizeof(struct IfFunctionStatement_S));
+    writeExpressionPointer(writer, FIELD(at, struct IfFunctionStatement_S, check), statement->check);
+    *AT(writer, FIELD(at, struct IfFunctionStatement_S, branch), uint64) = 0;
+    if(statement->branch){
+        uint64 branch = reserve(writer, sizeof(struct FunctionBody_S), 8);
+        writeFunctionBody(writer, branch, statement->branch);
+        writePointer(writer, FIELD(at, struct IfFunctionStatement_S, branch), branch);
+    }
+    *AT(writer, FIELD(at, struct IfFunctionStatement_S, alternativeBranch), uint64) = 0;
+    if(statement->alternativeBranch){
+        uint64 alternative = reserve(writer, sizeof(struct IfFunctionStatement_S), 8);
+        writeIfFunction(writer, alternative, statement->alternativeBranch);
+        writePointer(writer, FIELD(at, struct IfFunctionStatement_S, alternativeBranch), alternative);
+    }
+}
+
+static void writeFunctionBody(struct ProjectCacheWriter* writer, uint64 at, const struct FunctionBody_S* body){
+    memcpy(AT(writer, at, struct FunctionBody_S), body, sizeof(struct FunctionBody_S));
+    *AT(writer, FIELD(at, struct FunctionBody_S, statements), uint64) = 0;
+    if(body->statements == nullptr){
+        return;
+    }
+    uint64 statements = reserve(writer, sizeof(struct FunctionStatement_S) * body->statementCount, 8);
+    for(uint32 i = 0; i < body->statementCount; i++){
+        const struct FunctionStatement_S* statement = body->statements + i;
+        uint64 statementAt = statements + sizeof(struct FunctionStatement_S) * i;
+        memcpy(AT(writer, statementAt, struct FunctionStatement_S), statement, sizeof(struct FunctionStatement_S));
+        switch(statement->type){
+            case FUNCTION_STATEMENT_TYPE_FOREACH:{
+                uint64 foreach = FIELD(statementAt, struct FunctionStatement_S, foreachStatement);
+                writeString(writer, FIELD(foreach, struct ForeachStatement_S, variable), statement->foreachStatement.variable);
+                writeExpressionPointer(writer, FIELD(foreach, struct ForeachStatement_S, collection), statement->foreachStatement.collection);
+                writeString(writer, FIELD(foreach, struct ForeachStatement_S, index), statement->foreachStatement.index);
+                writePerformBody(writer, FIELD(foreach, struct ForeachStatement_S, performStatement), &statement->foreachStatement.performStatement);
+                break;
+            }
+            case FUNCTION_STATEMENT_TYPE_PERFORM:
+                writePerformBody(writer, FIELD(statementAt, struct FunctionStatement_S, performStatement), &statement->performStatement);
+                break;
+            case FUNCTION_STATEMENT_TYPE_RETURN:
+                writeExpressionPointer(writer, FIELD(statementAt, struct FunctionStatement_S, returnStatement.value), statement->returnStatement.value);
+                break;
+            case FUNCTION_STATEMENT_TYPE_VAR_DEFINITION:
+                writeVariableDefinition(writer, FIELD(statementAt, struct FunctionStatement_S, variableDefinition), &statement->variableDefinition);
+                break;
+            case FUNCTION_STATEMENT_TYPE_IF:
+                writeIfFunction(writer, FIELD(statementAt, struct FunctionStatement_S, ifStatement), &statement->ifStatement);
+                break;
+            case FUNCTION_STATEMENT_TYPE_NONE:
+                break;
+        }
+    }
+    writePointer(writer, FIELD(at, struct FunctionBody_S, statements), statements);
+}
+
+static void writeStatement(struct ProjectCacheWriter* writer, uint64 at, const struct Statement_S* statement){
+    memcpy(AT(writer, at, struct Statement_S), statement, sizeof(struct Statement_S));
+    switch(statement->type){
+        case STATEMENT_TYPE_VARIABLE_ASSIGNMENT:
+            writeVariableAssignment(writer, FIELD(at, struct Statement_S, variableAssignment), &statement->variableAssignment);
+            break;
+        case STATEMENT_TYPE_FUNCTION_DEFINITION:{
+            const struct FunctionDefinition_S* function = &statement->functionDefinition;
+            uint64 functionAt = FIELD(at, struct Statement_S, functionDefinition);
+            writeString(writer, FIELD(functionAt, struct FunctionDefinition_S, functionName), function->functionName);
+            *AT(writer, FIELD(functionAt, struct FunctionDefinition_S, parameters), uint64) = 0;
+            if(function->parameters){
+                uint64 parameters = reserve(writer, sizeof(AvString) * function->parameterCount, 8);
+                for(uint32 i = 0; i < function->parameterCount; i++){
+                    writeString(writer, parameters + sizeof(AvString) * i, function->parameters[i]);
+                }
+                writePointer(writer, FIELD(functionAt, struct FunctionDefinition_S, parameters), parameters);
+            }
+            writeFunctionBody(writer, FIELD(functionAt, struct FunctionDefinition_S, body), &function->body);
+            break;
+        }
+        case STATEMENT_TYPE_IMPORT:{
+            const struct ImportStatement_S* import = &statement->importStatement;
+            uint64 importAt = FIELD(at, struct Statement_S, importStatement);
+            writeString(writer, FIELD(importAt, struct ImportStatement_S, importFile), import->importFile);
+            *AT(writer, FIELD(importAt, struct ImportStatement_S, mappings), uint64) = 0;
+            if(import->mappings){
+                uint64 mappings = reserve(writer, sizeof(struct ImportMapping_S) * import->mappingCount, 8);
+                for(uint32 i = 0; i < import->mappingCount; i++){
+                    uint64 mappingAt = mappings + sizeof(struct ImportMapping_S) * i;
+                    memcpy(AT(writer, mappingAt, struct ImportMapping_S), import->mappings + i, sizeof(struct ImportMapping_S));
+                    writeString(writer, FIELD(mappingAt, struct ImportMapping_S, symbol), import->mappings[i].symbol);
+                    writeString(writer, FIELD(mappingAt, struct ImportMapping_S, alias), import->mappings[i].alias);
+                }
+                writePointer(writer, FIELD(importAt, struct ImportStatement_S, mappings), mappings);
+            }
+            break;
+        }
+        case STATEMENT_TYPE_INHERIT:
+            writeString(writer, FIELD(at, struct Statement_S, inheritStatement.variable), statement->inheritStatement.variable);
+            writeExpressionPointer(writer, FIELD(at, struct Statement_S, inheritStatement.defaultValue), statement->inheritStatement.defaultValue);
+            break;
+        case STATEMENT_TYPE_NONE:
+            break;
+    }
+}
+
+// imports are loaded from whatever directory the script changed to, the images stay in the workspace
+static void cacheFileName(char* fileName, uint64 key){
+    char dir[PATH_MAX];
+    workspacePath(dir, sizeof(dir), PROJECT_CACHE_DIR);
+    snprintf(fileName, PROJECT_CACHE_FILE_NAME_SIZE, "%s/%016llx", dir, (unsigned long long)key);
+}
+
+// the statements are stored in their in memory layout, an image is only read by builds laying them out the same
+static uint64 cacheSignature(){
+    static const uint64 layout[] = {
+        PROJECT_CACHE_FORMAT_VERSION,
+        sizeof(void*),
+        sizeof(AvString), offsetof(AvString, chrs), offsetof(AvString, len),
+        sizeof(struct Statement_S), offsetof(struct Statement_S, variableAssignment),
+        sizeof(struct VariableAssignment_S), offsetof(struct VariableAssignment_S, value), offsetof(struct VariableAssignment_S, cacheable),
+        sizeof(struct FunctionDefinition_S), offsetof(struct FunctionDefinition_S, body),
+        sizeof(struct ImportStatement_S), sizeof(struct ImportMapping_S), sizeof(struct InheritStatement_S),
+        sizeof(struct Expression_S), offsetof(struct Expression_S, byteCode),
+        sizeof(struct ArrayExpression_S), sizeof(struct SummationExpression_S), sizeof(struct MultiplicationExpression_S),
+        sizeof(struct EnumerationExpression_S), sizeof(struct UnaryExpression_S), sizeof(struct FilterExpression_S),
+        sizeof(struct CallExpression_S), sizeof(struct ComparisonExpression_S), sizeof(struct GroupExpression_S),
+        sizeof(struct IdentifierExpression_S), sizeof(struct LiteralExpression_S), sizeof(struct NumberExpression_S),
+        sizeof(struct FunctionBody_S), sizeof(struct FunctionStatement_S), sizeof(struct IfFunctionStatement_S),
+        sizeof(struct ForeachStatement_S), sizeof(struct ReturnStatement_S), sizeof(struct VariableDefinition_S),
+        sizeof(struct PerformStatementBody_S), sizeof(struct PerformStatement_S), sizeof(struct IfPerformStatement_S),
+        sizeof(struct CommandStatementBody_S), sizeof(struct CommandStatement_S), sizeof(struct IfCommandStatement_S),
+    };
+    return hashBytes(layout, sizeof(layout), HASH_SEED);
+}
+#endif
+
+#ifndef _WIN32
+// whether count elements of the given size at offset lie within the image
+static bool32 imageContains(struct ProjectCacheHeader header, uint64 offset, uint64 count, uint64 size){
+    if(offset > header.imageSize){
+        return false;
+    }
+    return count <= (header.imageSize - offset) / size;
+}
+#endif
+
+bool32 projectCacheLoad(AvString projectFilePath, Project* project){
+#ifndef _WIN32
+    uint64 key = projectFileKey(projectFilePath);
+    if(key == 0){
+        return false;
+    }
+    char fileName[PROJECT_CACHE_FILE_NAME_SIZE];
+    cacheFileName(fileName, key);
+    int fd = open(fileName, O_RDONLY);
+    if(fd == -1){
+        return false;
+    }
+    struct ProjectCacheHeader header;
+    struct stat info;
+    if(read(fd, &header, sizeof(header)) != sizeof(header) || fstat(fd, &info) != 0
+        || header.magic != PROJECT_CACHE_MAGIC || header.signature != cacheSignature()
+        || header.imageSize != (uint64)info.st_size){
+        close(fd);
+        return false;
+    }
+
+    uint64 sourceTime = 0;
+    uint64 sourceSize = 0;
+    if(!fileStatus(projectFilePath, &sourceTime, &sourceSize) || sourceSize != header.sourceSize){
+        close(fd);
+        return false;
+    }
+    if(sourceTime != header.sourceTime){
+        // touched but possibly unchanged, the content decides
+        uint64 sourceHash = HASH_SEED;
+        if(!hashFileContent(projectFilePath, &sourceHash) || sourceHash != header.sourceHash){
+            close(fd);
+            return false;
+        }
+    }
+
+    if(!imageContains(header, header.name, header.nameLength, 1)
+        || !imageContains(header, header.statements, header.statementCount, sizeof(uint64))
+        || !imageContains(header, header.relocations, header.relocationCount, sizeof(uint64))){
+        close(fd);
+        return false;
+    }
+
+    char* image = mmap(nullptr, header.imageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(image == MAP_FAILED){
+        return false;
+    }
+    // a truncated or corrupt image is parsed again instead of being followed out of the mapping
+    const uint64* relocations = (const uint64*)(image + header.relocations);
+    for(uint64 i = 0; i < header.relocationCount; i++){
+        if(!imageContains(header, relocations[i], 1, sizeof(uint64))){
+            munmap(image, header.imageSize);
+            return false;
+        }
+        uint64* pointer = (uint64*)(image + relocations[i]);
+        if(*pointer > header.imageSize){
+            munmap(image, header.imageSize);
+            return false;
+        }
+        *pointer += (uint64)image;
+    }
+    for(uint64 i = 0; i < header.statementCount; i++){
+        uint64 statement = ((uint64*)(image + header.statements))[i] - (uint64)image;
+        if(!imageContains(header, statement, 1, sizeof(struct Statement_S))){
+            munmap(image, header.imageSize);
+            return false;
+        }
+    }
+
+    AvString name = {
+        .chrs = image + header.name,
+        .len = header.nameLength,
+        .memory = nullptr,
+    };
+    projectCreate(project, name, projectFilePath, (AvString){0});
+    project->cacheImage = image;
+    project->cacheImageSize = header.imageSize;
+    project->statementCount = header.statementCount;
+    project->statements = (struct Statement_S**)(image + header.statements);
+    project->processState = PROCESS_STATE_OK;
+    if(!registerProjectStatements(project)){
+        projectDestroy(project);
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void projectCacheStore(AvString projectFilePath, Project* project){
+#ifndef _WIN32
+    uint64 key = projectFileKey(projectFilePath);
+    if(key == 0){
+        return;
+    }
+    struct ProjectCacheHeader header = {
+        .magic = PROJECT_CACHE_MAGIC,
+        .signature = cacheSignature(),
+        .sourceHash = HASH_SEED,
+    };
+    if(!fileStatus(projectFilePath, &header.sourceTime, &header.sourceSize)){
+        return;
+    }
+    header.sourceHash = hashBytes(&header.sourceSize, sizeof(uint64), header.sourceHash);
+    header.sourceHash = hashBytes(project->projectFileContent.chrs, project->projectFileContent.len, header.sourceHash);
+    // the file changed since it was loaded, the statements do not belong to its modification time
+    uint64 diskHash = HASH_SEED;
+    if(header.sourceSize != project->projectFileContent.len || !hashFileContent(projectFilePath, &diskHash) || diskHash != header.sourceHash){
+        return;
+    }
+
+    struct ProjectCacheWriter writer = {0};
+    avDynamicArrayCreate(0, sizeof(uint64), &writer.relocations);
+    reserve(&writer, sizeof(struct ProjectCacheHeader), 8);
+
+    header.nameLength = project->name.len;
+    header.name = reserve(&writer, project->name.len + 1, 1);
+    memcpy(AT(&writer, header.name, char), project->name.chrs, project->name.len);
+
+    header.statementCount = project->statementCount;
+    header.statements = reserve(&writer, sizeof(uint64) * project->statementCount, 8);
+    for(uint32 i = 0; i < project->statementCount; i++){
+        uint64 statement = reserve(&writer, sizeof(struct Statement_S), 8);
+        writeStatement(&writer, statement, project->statements[i]);
+        writePointer(&writer, header.statements + sizeof(uint64) * i, statement);
+    }
+
+    header.relocationCount = avDynamicArrayGetSize(writer.relocations);
+    header.relocations = reserve(&writer, sizeof(uint64) * header.relocationCount, 8);
+    if(header.relocationCount){
+        avDynamicArrayReadRange(AT(&writer, header.relocations, uint64), header.relocationCount, 0, sizeof(uint64), 0, writer.relocations);
+    }
+    header.imageSize = writer.size;
+    memcpy(writer.data, &header, sizeof(header));
+
+    char fileName[PROJECT_CACHE_FILE_NAME_SIZE];
+    char tmpFileName[PROJECT_CACHE_FILE_NAME_SIZE + 32];
+    cacheFileName(fileName, key);
+    snprintf(tmpFileName, sizeof(tmpFileName), "%s.tmp%i", fileName, (int)getpid());
+    char dir[PATH_MAX];
+    workspacePath(dir, sizeof(dir), PROJECT_CACHE_DIR);
+    if(mkdir(dir, 0755) == 0 || errno == EEXIST){
+        int fd = open(tmpFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd != -1){
+            bool32 written = write(fd, writer.data, writer.size) == (ssize_t)writer.size;
+            close(fd);
+            if(!written || rename(tmpFileName, fileName) != 0){
+                unlink(tmpFileName);
+            }
+        }
+    }
+
+    avDynamicArrayDestroy(writer.relocations);
+    avFree(writer.data);
+#endif
+}
+
+void projectCacheRelease(Project* project){
+#ifndef _WIN32
+    if(project->cacheImage){
+        munmap(project->cacheImage, project->cacheImageSize);
+    }
+#endif
+    project->cacheImage = nullptr;
+    project->cacheImageSize = 0;
+}
@@ -0,0 +1,520 @@
+// waitid is not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <AvUtils/logging/avAssert.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#else
+#include <AvUtils/avProcess.h>
+#include <AvUtils/process/avPipe.h>
+#include <io.h>
+#include <process.h>
+#include <windows.h>
+#endif
+
+#include "avProjectLang.h"
+
+struct CommandJob {
+    int32 pid;
+    uint32 iteration;
+    struct Value* retCodeTarget;
+    uint32 retCodeIndex;
+    bool32 indexed;
+    bool32 debug;
+    bool32 recordBuild;
+    struct CommandBuild build;
+    char* command;
+    char* responseFile;
+    uint64 traceStarted;
+};
+
+static struct JobPool {
+    uint32 jobCount;
+    uint32 runningCount;
+    uint32 iteration;
+    uint32 iterationCounter;
+    struct CommandJob* jobs;
+} jobPool = {0};
+
+void jobPoolCreate(uint32 jobCount){
+#ifndef _WIN32
+    if(jobCount == 0){
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        jobCount = cores > 0 ? cores : 1;
+    }
+#else
+    jobCount = 1;
+#endif
+    jobPool.jobCount = jobCount;
+    jobPool.runningCount = 0;
+    jobPool.iteration = 0;
+    jobPool.iterationCounter = 0;
+    jobPool.jobs = avCallocate(jobCount, sizeof(struct CommandJob), "job pool");
+    for(uint32 i = 0; i < jobCount; i++){
+        traceNameJob(i);
+    }
+}
+
+void jobPoolDestroy(){
+    jobPoolWaitAll();
+    avFree(jobPool.jobs);
+    memset(&jobPool, 0, sizeof(struct JobPool));
+}
+
+bool32 jobPoolIsParallel(){
+    return jobPool.jobCount > 1;
+}
+
+bool32 jobPoolInLoop(){
+    return jobPool.iteration != 0;
+}
+
+uint32 jobPoolBeginIteration(){
+    uint32 previous = jobPool.iteration;
+    jobPool.iteration = ++jobPool.iterationCounter;
+    if(jobPool.iteration == 0){
+        jobPool.iteration = ++jobPool.iterationCounter;
+    }
+    return previous;
+}
+
+void jobPoolEndLoop(uint32 previousIteration){
+    jobPool.iteration = previousIteration;
+    if(previousIteration == 0){
+        return;
+    }
+    // jobs issued by a nested loop become part of the enclosing iteration
+    for(uint32 i = 0; i < jobPool.jobCount; i++){
+        if(jobPool.jobs[i].pid && jobPool.jobs[i].iteration > previousIteration){
+            jobPool.jobs[i].iteration = previousIteration;
+        }
+    }
+}
+
+#ifndef _WIN32
+static char** createArguments(uint32 argCount, AvString* args){
+    char** argv = avCallocate(argCount + 1, sizeof(char*), "job arguments");
+    for(uint32 i = 0; i < argCount; i++){
+        argv[i] = avCallocate(args[i].len + 1, 1, "job argument");
+        memcpy(argv[i], args[i].chrs, args[i].len);
+    }
+    return argv;
+}
+
+static void destroyArguments(uint32 argCount, char** argv){
+    for(uint32 i = 0; i < argCount; i++){
+        avFree(argv[i]);
+    }
+    avFree(argv);
+}
+
+// the redirected descriptors are handed to the command as they are, its output never passes through avBuilder
+static pid_t startCommand(uint32 argCount, AvString* args, struct CommandRedirection redirection){
+    char** argv = createArguments(argCount, args);
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if(pid == 0){
+        if(redirection.output != -1){
+            dup2(redirection.output, STDOUT_FILENO);
+        }
+        if(redirection.error != -1){
+            dup2(redirection.error, STDERR_FILENO);
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    destroyArguments(argCount, argv);
+    return pid;
+}
+
+static int32 waitCommand(pid_t pid){
+    int status = 0;
+    while(waitpid(pid, &status, 0) == -1){
+        if(errno != EINTR){
+            return -1;
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void completeJob(struct CommandJob* job, int status){
+    int32 retCode = -1;
+    if(WIFEXITED(status)){
+        retCode = WEXITSTATUS(status);
+    }
+
+    struct Value* target = job->retCodeTarget;
+    if(target){
+        struct Value value = { .type = VALUE_TYPE_NUMBER, .asNumber = retCode };
+        if(job->indexed && target->type == VALUE_TYPE_ARRAY){
+            if(job->retCodeIndex < target->asArray.count){
+                target->asArray.values[job->retCodeIndex].type = VALUE_TYPE_NUMBER;
+                target->asArray.values[job->retCodeIndex].asNumber = retCode;
+            }
+        }else{
+            memcpy(target, &value, sizeof(struct Value));
+        }
+    }
+
+    traceCommand(job->command, retCode, job->traceStarted, job - jobPool.jobs);
+    if(job->recordBuild && retCode == 0){
+        commitCommandBuild(&job->build);
+    }
+
+    if(job->debug){
+        avStringPrintf(AV_CSTR("%i = %s\n"), retCode, AV_CSTR(job->command));
+    }
+    avFree(job->command);
+    responseFileRemove(job->responseFile);
+    memset(job, 0, sizeof(struct CommandJob));
+    jobPool.runningCount--;
+}
+
+static struct CommandJob* findJob(pid_t pid){
+    for(uint32 i = 0; i < jobPool.jobCount; i++){
+        if(jobPool.jobs[i].pid != 0 && jobPool.jobs[i].pid == pid){
+            return jobPool.jobs + i;
+        }
+    }
+    return nullptr;
+}
+
+static bool32 waitJob(struct CommandJob* job, int options){
+    int status = 0;
+    pid_t pid = waitpid(job->pid, &status, options);
+    if(pid <= 0){
+        return false;
+    }
+    completeJob(job, status);
+    return true;
+}
+
+// only the children started by the pool are reaped, other children of the process are left to their owners
+static bool32 reapJob(){
+    if(jobPool.runningCount == 0){
+        return false;
+    }
+    for(uint32 i = 0; i < jobPool.jobCount; i++){
+        if(jobPool.jobs[i].pid && waitJob(jobPool.jobs + i, WNOHANG)){
+            return true;
+        }
+    }
+
+    // sleeps until any child exits without reaping it
+    siginfo_t info = {0};
+    if(waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) == -1){
+        return errno == EINTR;
+    }
+    struct CommandJob* job = findJob(info.si_pid);
+    if(job == nullptr){
+        // the exited child is not ours and stays waitable, block on a job instead of seeing it again
+        for(uint32 i = 0; i < jobPool.jobCount && job == nullptr; i++){
+            if(jobPool.jobs[i].pid){
+                job = jobPool.jobs + i;
+            }
+        }
+    }
+    if(!waitJob(job, 0)){
+        return errno == EINTR;
+    }
+    return true;
+}
+#endif
+
+static bool32 isPending(bool32 (*predicate)(struct CommandJob*, void*), void* data){
+    for(uint32 i = 0; i < jobPool.jobCount; i++){
+        if(jobPool.jobs[i].pid && predicate(jobPool.jobs + i, data)){
+            return true;
+        }
+    }
+    return false;
+}
+
+static void waitWhilePending(bool32 (*predicate)(struct CommandJob*, void*), void* data){
+#ifndef _WIN32
+    while(isPending(predicate, data)){
+        if(!reapJob()){
+            break;
+        }
+    }
+#endif
+}
+
+static bool32 jobTargetsValue(struct CommandJob* job, void* value){
+    return job->retCodeTarget == value;
+}
+
+static bool32 jobInIteration(struct CommandJob* job, void* iteration){
+    return job->iteration == *(uint32*)iteration;
+}
+
+static bool32 anyJob(struct CommandJob* job, void* data){
+    return true;
+}
+
+void jobPoolWaitForValue(struct Value* value){
+    if(jobPool.runningCount == 0 || value == nullptr){
+        return;
+    }
+    waitWhilePending(jobTargetsValue, value);
+}
+
+// earlier commands of the current iteration, which might produce the inputs of the next one
+void jobPoolWaitForIteration(){
+    if(jobPool.runningCount == 0){
+        return;
+    }
+    uint32 iteration = jobPool.iteration;
+    waitWhilePending(jobInIteration, &iteration);
+}
+
+void jobPoolWaitAll(){
+    if(jobPool.runningCount == 0){
+        return;
+    }
+    waitWhilePending(anyJob, nullptr);
+}
+
+bool32 jobPoolDispatch(uint32 argCount, AvString* args, const char* command, struct CommandRedirection redirection, char* responseFile, struct Value* retCodeTarget, bool32 indexed, uint32 retCodeIndex, bool32 debug, const struct CommandBuild* build){
+#ifndef _WIN32
+    // commands within a single iteration keep their order
+    uint32 iteration = jobPool.iteration;
+    waitWhilePending(jobInIteration, &iteration);
+
+    while(jobPool.runningCount >= jobPool.jobCount){
+        if(!reapJob()){
+            return false;
+        }
+    }
+
+    uint64 traceStarted = traceStart();
+    pid_t pid = startCommand(argCount, args, redirection);
+    if(pid == -1){
+        return false;
+    }
+
+    struct CommandJob* job = nullptr;
+    for(uint32 i = 0; i < jobPool.jobCount; i++){
+        if(jobPool.jobs[i].pid == 0){
+            job = jobPool.jobs + i;
+            break;
+        }
+    }
+    avAssert(job != nullptr, "job pool overflow");
+
+    uint64 commandLength = strlen(command);
+    job->command = avAllocate(commandLength + 1, "job command");
+    memcpy(job->command, command, commandLength + 1);
+    job->pid = pid;
+    job->responseFile = responseFile;
+    job->traceStarted = traceStarted;
+    job->iteration = iteration;
+    job->retCodeTarget = retCodeTarget;
+    job->indexed = indexed;
+    job->retCodeIndex = retCodeIndex;
+    job->debug = debug;
+    if(build){
+        // the paths are allocated by the project, which outlives its jobs
+        job->recordBuild = true;
+        memcpy(&job->build, build, sizeof(struct CommandBuild));
+    }
+    jobPool.runningCount++;
+    return true;
+#else
+    return false;
+#endif
+}
+
+#define COMMAND_OUTPUT_READ_SIZE (64 * 1024)
+
+static void reserveCommandOutput(struct CommandOutput* output, uint64 size){
+    if(output->capacity - output->size >= size){
+        return;
+    }
+    uint64 capacity = output->capacity ? output->capacity : COMMAND_OUTPUT_READ_SIZE;
+    while(capacity - output->size < size){
+        capacity *= 2;
+    }
+    char* data = avAllocate(capacity, "command output");
+    if(output->data){
+        memcpy(data, output->data, output->size);
+        avFree(output->data);
+    }
+    output->data = data;
+    output->capacity = capacity;
+}
+
+static void addCommandOutputLine(struct CommandOutput* output, uint64 start, uint64 end){
+    // empty lines are dropped
+    if(end == start){
+        return;
+    }
+    if(output->lineCount == output->lineCapacity){
+        uint32 capacity = output->lineCapacity ? output->lineCapacity * 2 : 64;
+        struct CommandOutputLine* lines = avAllocate(sizeof(struct CommandOutputLine) * capacity, "command output lines");
+        if(output->lines){
+            memcpy(lines, output->lines, sizeof(struct CommandOutputLine) * output->lineCount);
+            avFree(output->lines);
+        }
+        output->lines = lines;
+        output->lineCapacity = capacity;
+    }
+    output->lines[output->lineCount++] = (struct CommandOutputLine){
+        .start = start,
+        .length = end - start,
+    };
+}
+
+// splits the bytes just appended to the output into lines, the last one stays open until its newline arrives
+static void appendCommandOutput(struct CommandOutput* output, uint64 size){
+    char* at = output->data + output->size;
+    char* end = at + size;
+    output->size += size;
+    while((at = memchr(at, '\n', end - at))){
+        uint64 lineEnd = at - output->data;
+        addCommandOutputLine(output, output->lineStart, lineEnd);
+        output->lineStart = lineEnd + 1;
+        at++;
+    }
+}
+
+#ifdef _WIN32
+struct CapturedOutputReader {
+    int fd;
+    bool32 tee;
+    struct CommandOutput* output;
+};
+
+// avProcessRun only returns once the command exited, so the pipe is read on a thread of its own until the
+// write channel is closed
+static unsigned __stdcall readCapturedOutput(void* data){
+    struct CapturedOutputReader* reader = data;
+    struct CommandOutput* output = reader->output;
+    while(true){
+        reserveCommandOutput(output, COMMAND_OUTPUT_READ_SIZE);
+        int size = read(reader->fd, output->data + output->size, COMMAND_OUTPUT_READ_SIZE);
+        if(size <= 0){
+            break;
+        }
+        if(reader->tee){
+            fwrite(output->data + output->size, 1, size, stdout);
+        }
+        appendCommandOutput(output, size);
+    }
+    return 0;
+}
+#endif
+
+// runs a command outside of the pool and collects what it writes to its standard output. The pipe is
+// drained while the command runs, so output larger than the pipe buffer does not block it
+int32 runCapturedCommand(uint32 argCount, AvString* args, int32 errorFile, bool32 tee, struct CommandOutput* output){
+    memset(output, 0, sizeof(struct CommandOutput));
+    if(argCount == 0){
+        return -1;
+    }
+#ifndef _WIN32
+    int channel[2];
+    if(pipe(channel) != 0){
+        return -1;
+    }
+    fcntl(channel[0], F_SETFD, FD_CLOEXEC);
+    fcntl(channel[1], F_SETFD, FD_CLOEXEC);
+    pid_t pid = startCommand(argCount, args, (struct CommandRedirection){
+        .output = channel[1],
+        .error = errorFile,
+    });
+    close(channel[1]);
+    if(pid == -1){
+        close(channel[0]);
+        return -1;
+    }
+
+    while(true){
+        reserveCommandOutput(output, COMMAND_OUTPUT_READ_SIZE);
+        ssize_t size = read(channel[0], output->data + output->size, output->capacity - output->size);
+        if(size < 0 && errno == EINTR){
+            continue;
+        }
+        if(size <= 0){
+            break;
+        }
+        if(tee){
+            for(ssize_t written = 0; written < size;){
+                ssize_t count = write(STDOUT_FILENO, output->data + output->size + written, size - written);
+                if(count < 0 && errno == EINTR){
+                    continue;
+                }
+                if(count <= 0){
+                    break;
+                }
+                written += count;
+            }
+        }
+        appendCommandOutput(output, size);
+    }
+    close(channel[0]);
+    addCommandOutputLine(output, output->lineStart, output->size);
+    return waitCommand(pid);
+#else
+    AvProcessStartInfo info = AV_EMPTY;
+    avProcessStartInfoPopulateARR(&info, args[0], (AvString)AV_EMPTY, argCount-1, args+1);
+    AvPipe channel = AV_EMPTY;
+    avPipeCreate(&channel);
+    info.output = &channel.write;
+    struct CapturedOutputReader reader = {
+        .fd = channel.read,
+        .tee = tee,
+        .output = output,
+    };
+    HANDLE thread = (HANDLE)_beginthreadex(nullptr, 0, readCapturedOutput, &reader, 0, nullptr);
+    int32 retCode = avProcessRun(info);
+    // closing the write channel ends the reader once everything written is read
+    avPipeConsumeWriteChannel(&channel);
+    avProcessStartInfoDestroy(&info);
+    if(thread){
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+    }else{
+        readCapturedOutput(&reader);
+    }
+    addCommandOutputLine(output, output->lineStart, output->size);
+    avPipeDestroy(&channel);
+    return retCode;
+#endif
+}
+
+// runs a command outside of the pool with its standard output and error written straight to files
+int32 runRedirectedCommand(uint32 argCount, AvString* args, struct CommandRedirection redirection){
+    if(argCount == 0){
+        return -1;
+    }
+#ifndef _WIN32
+    pid_t pid = startCommand(argCount, args, redirection);
+    if(pid == -1){
+        return -1;
+    }
+    return waitCommand(pid);
+#else
+    return -1;
+#endif
+}
+
+void commandOutputDestroy(struct CommandOutput* output){
+    if(output->data){
+        avFree(output->data);
+    }
+    if(output->lines){
+        avFree(output->lines);
+    }
+    memset(output, 0, sizeof(struct CommandOutput));
+}
@@ -195,6 +195,7 @@ struct CommandStatementList {
     AvString outputVariable;
     struct Expression* outputVariableIndex;
     struct Expression* pipeFile;
+    struct Expression* errorFile;
     struct CommandStatement* commandStatement;
     struct CommandStatementList* next;
 };
@@ -410,6 +411,7 @@ struct Expression_S {
         struct NumberExpression_S number;
         struct ComparisonExpression_S comparison;
     };
+    struct ExpressionByteCode* byteCode; // compiled on first evaluation
 };
 
 struct VariableAssignment_S {
@@ -417,6 +419,7 @@ struct VariableAssignment_S {
     enum VariableAccessModifier modifier;
     struct Expression_S* index;
     struct Expression_S* value;
+    bool32 cacheable; // a global whose value does not depend on who reads it, see markCacheableGlobals
 };
 
 struct IfCommandStatement_S {
@@ -446,6 +449,7 @@ struct CommandStatementBody_S{
     AvString outputVariable;
     struct Expression_S* outputVariableIndex;
     struct Expression_S* pipeFile;
+    struct Expression_S* errorFile;
     uint32 statementCount;
     struct CommandStatement_S* statements;
 };
@@ -574,6 +578,7 @@ struct ConstValue {
 struct ArrayValue {
     uint32 count;
     struct ConstValue* values;
+    bool32 shared; // values belong to a folded constant or a cache and are copied before being written
 };
 
 struct Value {
@@ -603,6 +608,7 @@ struct VariableDescription {
     uint32 statement;
     struct Value* value;
     struct Project* project;
+    struct CachedValue* cache; // result of the lazily evaluated statement, until something it read changes
 };
 
 
@@ -1,11 +1,79 @@
+// MAP_ANONYMOUS is not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
 #include "avBuilder.h"
 #include <AvUtils/filesystem/avFile.h>
 #include <AvUtils/memory/avAllocator.h>
 #include <AvUtils/avMemory.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <errno.h>
+
+// reads the file into pages of its own, which are made read only once filled. Tokens and every string taken from
+// the source point straight into them. A mapping of the file itself would take these strings with it when the
+// file is rewritten during a build, and touching a page past its new end raises SIGBUS
+static bool32 readProjectFile(const AvString projectFilePath, AvStringRef projectFileContent){
+    char* fileName = avAllocate(projectFilePath.len + 1, "file name");
+    memcpy(fileName, projectFilePath.chrs, projectFilePath.len);
+    fileName[projectFilePath.len] = '\0';
+    int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+    avFree(fileName);
+    if(fd == -1){
+        return false;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0){
+        close(fd);
+        return false;
+    }
+    memset(projectFileContent, 0, sizeof(AvString));
+    uint64 size = info.st_size;
+    if(size == 0){
+        close(fd);
+        return true;
+    }
+    char* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED){
+        close(fd);
+        return false;
+    }
+    // a file truncated since fstat ends early and is not loaded
+    uint64 offset = 0;
+    while(offset < size){
+        ssize_t received = read(fd, data + offset, size - offset);
+        if(received < 0 && errno == EINTR){
+            continue;
+        }
+        if(received <= 0){
+            munmap(data, size);
+            close(fd);
+            return false;
+        }
+        offset += received;
+    }
+    close(fd);
+    mprotect(data, size, PROT_READ);
+    projectFileContent->chrs = data;
+    projectFileContent->len = size;
+    return true;
+}
+#endif
 
 bool32 loadProjectFile(const AvString projectFilePath, AvStringRef projectFileContent, AvStringRef projectFileName){
+    // the handle only provides the name of the project, the file is opened once to read it
     AvFile file = AV_EMPTY;
     avFileHandleCreate(projectFilePath, &file);
+#ifndef _WIN32
+    // carriage returns are skipped as whitespace by the tokenizer, so the content is used as is
+    if(!readProjectFile(projectFilePath, projectFileContent)){
+        avFileHandleDestroy(file);
+        return false;
+    }
+#else
     if(!avFileOpen(file, AV_FILE_OPEN_READ_DEFAULT)){
         avFileHandleDestroy(file);
         return false;
@@ -21,21 +89,24 @@ bool32 loadProjectFile(const AvString projectFilePath, AvStringRef projectFileCo
     strmem.properties.debugContext = NULL;
     strmem.data = buffer;
 
-    AvString projectFileContentRaw = AV_EMPTY;
-    avStringFromMemory(&projectFileContentRaw, AV_STRING_WHOLE_MEMORY, &strmem);
-    
-    AvString sanitizedProjectFileContent = AV_EMPTY;
-    avStringReplace(&sanitizedProjectFileContent, projectFileContentRaw, AV_CSTR("\r\n"), AV_CSTR("\n"));
+    avStringFromMemory(projectFileContent, AV_STRING_WHOLE_MEMORY, &strmem);
+    avFileClose(file);
+#endif
 
     AvFileNameProperties* fileNameProps = avFileHandleGetFileNameProperties(file);
-    
-    avStringClone(projectFileContent, sanitizedProjectFileContent);
     avStringClone(projectFileName, fileNameProps->fileNameWithoutExtension);
 
-    avStringFree(&sanitizedProjectFileContent);
-    avStringFree(&projectFileContentRaw);
-
-    avFileClose(file);
     avFileHandleDestroy(file);
     return true;
-}
\ No newline at end of file
+}
+
+void unloadProjectFile(AvStringRef projectFileContent){
+#ifndef _WIN32
+    if(projectFileContent->len){
+        munmap((void*)projectFileContent->chrs, projectFileContent->len);
+    }
+    memset(projectFileContent, 0, sizeof(AvString));
+#else
+    avStringFree(projectFileContent);
+#endif
+}
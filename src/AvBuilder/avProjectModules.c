@@ -0,0 +1,443 @@
+// realpath is not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <AvUtils/avEnvironment.h>
+#include <AvUtils/logging/avAssert.h>
+#include <AvUtils/dataStructures/avDynamicArray.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// every project file is parsed once per run. The first import of a file owns its statements,
+// later imports of the same file, from any project, get their own instance borrowing them
+struct Module {
+    uint64 key;
+    Project* project;
+    bool32 owned; // loaded ahead of time, the registry destroys it
+    uint64 time;  // status of the file when it was loaded, owned modules are dropped once it changes
+    uint64 size;
+};
+
+static struct {
+    uint32 count;
+    uint32 capacity;
+    struct Module* modules;
+} moduleRegistry = {0};
+
+uint64 projectFileKey(AvString projectFilePath){
+    char fileName[PATH_MAX];
+    char resolved[PATH_MAX];
+    snprintf(fileName, sizeof(fileName), "%.*s", (int)projectFilePath.len, projectFilePath.chrs);
+#ifndef _WIN32
+    if(realpath(fileName, resolved) == nullptr){
+        return 0;
+    }
+#else
+    if(_fullpath(resolved, fileName, sizeof(resolved)) == nullptr){
+        return 0;
+    }
+#endif
+    uint64 key = hashString(AV_CSTR(resolved), HASH_SEED);
+    return key ? key : 1;
+}
+
+bool32 resolveImportPath(AvString projectFile, bool32 local, AvStringRef projectFilePath){
+    if(local){
+        avStringClone(projectFilePath, projectFile);
+        return true;
+    }
+    AvString homeDir = AV_EMPTY;
+    if(!avGetEnvironmentVariable(AV_CSTR(HOME_ENVIRONMENT_VARIABLE), &homeDir)){
+        return false;
+    }
+    avStringJoin(projectFilePath, homeDir, AV_CSTRA("/"), configPath, templatePath, projectFile);
+    avStringFree(&homeDir);
+    return true;
+}
+
+// loads, tokenizes, parses and processes a project file, or maps it from the statement cache
+bool32 loadProjectModule(AvString projectFilePath, Project* project){
+    watchProjectFile(projectFilePath);
+    uint64 traceStarted = traceStart();
+    if(projectCacheLoad(projectFilePath, project)){
+        traceSpan("project", AV_CSTR("load cached"), projectFilePath, traceStarted);
+        return true;
+    }
+
+    AvString projectFileContent = AV_EMPTY;
+    AvString projectFileName = AV_EMPTY;
+    traceStarted = traceStart();
+    bool32 loaded = loadProjectFile(projectFilePath, &projectFileContent, &projectFileName);
+    traceSpan("project", AV_CSTR("load"), projectFilePath, traceStarted);
+    if(!loaded){
+        avStringPrintf(AV_CSTR("Failed to load project file %s\n"), projectFilePath);
+        avStringFree(&projectFileName);
+        unloadProjectFile(&projectFileContent);
+        return false;
+    }
+
+    AV_DS(AvDynamicArray, Token) tokens = AV_EMPTY;
+    avDynamicArrayCreate(0, sizeof(Token), &tokens);
+    traceStarted = traceStart();
+    bool32 tokenized = tokenizeProject(projectFileContent, projectFileName, tokens);
+    traceSpan("project", AV_CSTR("tokenize"), projectFilePath, traceStarted);
+    if(!tokenized){
+        avStringPrintf(AV_CSTR("Failed to tokenize project file %s\n"), projectFilePath);
+        avDynamicArrayDestroy(tokens);
+        avStringFree(&projectFileName);
+        unloadProjectFile(&projectFileContent);
+        return false;
+    }
+
+    // the project owns the content from here on
+    projectCreate(project, projectFileName, projectFilePath, projectFileContent);
+    avStringFree(&projectFileName);
+    struct ProjectStatementList* statements = nullptr;
+    bool32 result = false;
+    traceStarted = traceStart();
+    bool32 parsed = parseProject(tokens, (void**)&statements, project);
+    traceSpan("project", AV_CSTR("parse"), projectFilePath, traceStarted);
+    bool32 processed = false;
+    if(parsed){
+        traceStarted = traceStart();
+        processed = processProject(statements, project);
+        traceSpan("project", AV_CSTR("process"), projectFilePath, traceStarted);
+    }
+    if(!parsed){
+        avStringPrintf(AV_CSTR("Failed to parse project file %s\n"), projectFilePath);
+    }else if(!processed){
+        avStringPrintf(AV_CSTR("Failed to perform processing on project file %s\n"), projectFilePath);
+    }else{
+        projectCacheStore(projectFilePath, project);
+        result = true;
+    }
+    avDynamicArrayDestroy(tokens);
+    if(!result){
+        projectDestroy(project);
+    }
+    return result;
+}
+
+static struct Module* findModule(uint64 key){
+    for(uint32 i = 0; i < moduleRegistry.count; i++){
+        if(moduleRegistry.modules[i].key == key){
+            return moduleRegistry.modules + i;
+        }
+    }
+    return nullptr;
+}
+
+bool32 moduleRegistryInstantiate(uint64 key, Project* project){
+    if(key == 0){
+        return false;
+    }
+    struct Module* module = findModule(key);
+    if(module == nullptr){
+        return false;
+    }
+    Project* owner = module->project;
+    projectCreate(project, owner->name, owner->projectFileName, (AvString){0});
+    project->statementCount = owner->statementCount;
+    project->statements = owner->statements;
+    project->statementOwner = owner->statementOwner;
+    project->processState = PROCESS_STATE_OK;
+    if(!registerProjectStatements(project)){
+        projectDestroy(project);
+        return false;
+    }
+    return true;
+}
+
+static void registerModule(uint64 key, Project* project, bool32 owned, uint64 time, uint64 size){
+    if(key == 0 || findModule(key)){
+        return;
+    }
+    if(moduleRegistry.count == moduleRegistry.capacity){
+        moduleRegistry.capacity = moduleRegistry.capacity ? moduleRegistry.capacity * 2 : 16;
+        struct Module* modules = avCallocate(moduleRegistry.capacity, sizeof(struct Module), "module registry");
+        if(moduleRegistry.modules){
+            memcpy(modules, moduleRegistry.modules, sizeof(struct Module) * moduleRegistry.count);
+            avFree(moduleRegistry.modules);
+        }
+        moduleRegistry.modules = modules;
+    }
+    moduleRegistry.modules[moduleRegistry.count++] = (struct Module){
+        .key = key,
+        .project = project,
+        .owned = owned,
+        .time = time,
+        .size = size,
+    };
+}
+
+void moduleRegistryAdd(uint64 key, Project* project){
+    registerModule(key, project, false, 0, 0);
+}
+
+// projects registered on import are owned by the projects that imported them, only prefetched ones are destroyed here
+void moduleRegistryClear(){
+    for(uint32 i = 0; i < moduleRegistry.count; i++){
+        if(moduleRegistry.modules[i].owned){
+            projectDestroy(moduleRegistry.modules[i].project);
+            avFree(moduleRegistry.modules[i].project);
+        }
+    }
+    if(moduleRegistry.modules){
+        avFree(moduleRegistry.modules);
+    }
+    memset(&moduleRegistry, 0, sizeof(moduleRegistry));
+}
+
+// keeps the project file loaded for as long as the registry is not cleared
+Project* moduleRegistryLoad(AvString projectFilePath, uint64* key){
+    *key = projectFileKey(projectFilePath);
+    struct Module* module = findModule(*key);
+    if(module){
+        return module->project;
+    }
+    uint64 time = 0;
+    uint64 size = 0;
+    fileStatus(projectFilePath, &time, &size);
+    Project* project = avCallocate(1, sizeof(Project), "resident project");
+    if(!loadProjectModule(projectFilePath, project)){
+        avFree(project);
+        return nullptr;
+    }
+    registerModule(*key, project, true, time, size);
+    return project;
+}
+
+// drops the loaded projects whose files changed since, they are loaded again when used
+void moduleRegistryRefresh(){
+    uint32 kept = 0;
+    for(uint32 i = 0; i < moduleRegistry.count; i++){
+        struct Module module = moduleRegistry.modules[i];
+        avAssert(module.owned, "projects of a finished run are still registered");
+        uint64 time = 0;
+        uint64 size = 0;
+        if(fileStatus(module.project->projectFileName, &time, &size) && time == module.time && size == module.size){
+            moduleRegistry.modules[kept++] = module;
+            continue;
+        }
+        projectDestroy(module.project);
+        avFree(module.project);
+    }
+    moduleRegistry.count = kept;
+}
+
+// runs a fresh instance of a registered project, the projects it imports that were not loaded yet
+// belong to the instance and are forgotten once it is done
+uint32 runModule(uint64 key, const struct ProjectOptions* options, AvDynamicArray arguments){
+    uint32 moduleCount = moduleRegistryCount();
+    // not an automatic variable, its content changes between setjmp and a longjmp back to it
+    Project* run = avCallocate(1, sizeof(Project), "module run");
+
+    // a runtime error ends the run instead of the watch loop or build server running it
+    jmp_buf recovery;
+    jmp_buf* previous = runtimeErrorRecover(&recovery);
+    if(setjmp(recovery) != 0){
+        // errors are only raised once the instance was created
+        runtimeErrorRecover(previous);
+        runtimeErrorAbandon();
+        projectDestroy(run);
+        avFree(run);
+        moduleRegistryRewind(moduleCount);
+        return -1;
+    }
+
+    uint32 result = -1;
+    if(moduleRegistryInstantiate(key, run)){
+        memcpy(&run->options, options, sizeof(struct ProjectOptions));
+        result = runProject(run, arguments);
+        projectDestroy(run);
+    }
+    runtimeErrorRecover(previous);
+    avFree(run);
+    moduleRegistryRewind(moduleCount);
+    return result;
+}
+
+uint32 moduleRegistryCount(){
+    return moduleRegistry.count;
+}
+
+// forgets the modules registered after the first count, used once the projects owning them are destroyed
+void moduleRegistryRewind(uint32 count){
+    avAssert(count <= moduleRegistry.count, "rewinding past the end of the module registry");
+    for(uint32 i = count; i < moduleRegistry.count; i++){
+        if(moduleRegistry.modules[i].owned){
+            projectDestroy(moduleRegistry.modules[i].project);
+            avFree(moduleRegistry.modules[i].project);
+        }
+    }
+    moduleRegistry.count = count;
+}
+
+#ifndef _WIN32
+struct PrefetchEntry {
+    uint64 key;
+    AvString path;
+    Project* project;
+    uint64 time;
+    uint64 size;
+};
+
+// files still to be loaded are taken from the front, imports found while processing are appended
+struct PrefetchQueue {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    uint32 count;
+    uint32 capacity;
+    uint32 next;
+    uint32 active;
+    struct PrefetchEntry* entries;
+};
+
+// the caller holds the lock
+static void queueModule(struct PrefetchQueue* queue, uint64 key, AvString path){
+    if(key == 0 || findModule(key)){
+        avStringFree(&path);
+        return;
+    }
+    for(uint32 i = 0; i < queue->count; i++){
+        if(queue->entries[i].key == key){
+            avStringFree(&path);
+            return;
+        }
+    }
+    if(queue->count == queue->capacity){
+        queue->capacity = queue->capacity ? queue->capacity * 2 : 16;
+        struct PrefetchEntry* entries = avCallocate(queue->capacity, sizeof(struct PrefetchEntry), "prefetch queue");
+        if(queue->entries){
+            memcpy(entries, queue->entries, sizeof(struct PrefetchEntry) * queue->count);
+            avFree(queue->entries);
+        }
+        queue->entries = entries;
+    }
+    queue->entries[queue->count++] = (struct PrefetchEntry){
+        .key = key,
+        .path = path,
+        .project = nullptr,
+    };
+}
+
+// resolves the imports of a project outside of the lock and queues them
+static void queueImports(struct PrefetchQueue* queue, Project* project){
+    AV_DS(AvDynamicArray, struct PrefetchEntry) imports = AV_EMPTY;
+    avDynamicArrayCreate(0, sizeof(struct PrefetchEntry), &imports);
+    for(uint32 i = 0; i < project->statementCount; i++){
+        struct Statement_S* statement = project->statements[i];
+        if(statement->type != STATEMENT_TYPE_IMPORT){
+            continue;
+        }
+        AvString importFile = {
+            .chrs = statement->importStatement.importFile.chrs + 1,
+            .len = statement->importStatement.importFile.len - 2,
+        };
+        struct PrefetchEntry entry = AV_EMPTY;
+        if(!resolveImportPath(importFile, statement->importStatement.local, &entry.path)){
+            continue;
+        }
+        entry.key = projectFileKey(entry.path);
+        avDynamicArrayAdd(&entry, imports);
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    avDynamicArrayForEachElement(struct PrefetchEntry, imports, {
+        queueModule(queue, element.key, element.path);
+    });
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    avDynamicArrayDestroy(imports);
+}
+
+static void* prefetchWorker(void* data){
+    struct PrefetchQueue* queue = data;
+    pthread_mutex_lock(&queue->mutex);
+    while(true){
+        while(queue->next == queue->count && queue->active){
+            pthread_cond_wait(&queue->changed, &queue->mutex);
+        }
+        if(queue->next == queue->count){
+            break;
+        }
+        uint32 index = queue->next++;
+        AvString path = queue->entries[index].path;
+        queue->active++;
+        pthread_mutex_unlock(&queue->mutex);
+
+        // the status is taken before loading, a change while loading drops the module next time
+        uint64 time = 0;
+        uint64 size = 0;
+        fileStatus(path, &time, &size);
+        Project* project = avCallocate(1, sizeof(Project), "prefetched project");
+        if(loadProjectModule(path, project)){
+            queueImports(queue, project);
+        }else{
+            avFree(project);
+            project = nullptr;
+        }
+
+        pthread_mutex_lock(&queue->mutex);
+        queue->entries[index].project = project;
+        queue->entries[index].time = time;
+        queue->entries[index].size = size;
+        queue->active--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return nullptr;
+}
+#endif
+
+// loads the whole import graph of a project on a pool of threads before it runs. Files that fail to load
+// are left to the import, which reports the error where the file is used
+void moduleRegistryPrefetch(Project* project){
+#ifndef _WIN32
+    struct PrefetchQueue queue = AV_EMPTY;
+    pthread_mutex_init(&queue.mutex, nullptr);
+    pthread_cond_init(&queue.changed, nullptr);
+    queueImports(&queue, project);
+
+    if(queue.count){
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        uint32 threadCount = cores > 0 ? cores : 1;
+        pthread_t threads[threadCount];
+        uint32 started = 0;
+        for(uint32 i = 0; i < threadCount; i++){
+            if(pthread_create(threads + started, nullptr, prefetchWorker, &queue) == 0){
+                started++;
+            }
+        }
+        if(started == 0){
+            prefetchWorker(&queue);
+        }
+        for(uint32 i = 0; i < started; i++){
+            pthread_join(threads[i], nullptr);
+        }
+    }
+
+    for(uint32 i = 0; i < queue.count; i++){
+        if(queue.entries[i].project){
+            registerModule(queue.entries[i].key, queue.entries[i].project, true, queue.entries[i].time, queue.entries[i].size);
+        }
+        avStringFree(&queue.entries[i].path);
+    }
+    if(queue.entries){
+        avFree(queue.entries);
+    }
+    pthread_cond_destroy(&queue.changed);
+    pthread_mutex_destroy(&queue.mutex);
+#endif
+}
@@ -533,6 +533,7 @@ static struct PerformOperation* parsePerformOperation(TokenIterator* iterator) {
         struct Expression* retCodeIndex = nullptr;
         struct Expression* outputVariableIndex = nullptr;
         struct Expression* pipeFile = nullptr;
+        struct Expression* errorFile = nullptr;
         if(match(iterator, TOKEN_TYPE_PUNCTUATOR_colon)){
             Token* retVariable = consume(iterator, TOKEN_TYPE_TEXT, "expected variable for return code");
             avStringUnsafeCopy(&retCodeVariable, retVariable->str);
@@ -549,9 +550,12 @@ static struct PerformOperation* parsePerformOperation(TokenIterator* iterator) {
                 consume(iterator, TOKEN_TYPE_PUNCTUATOR_bracket_close, "expected ']'");
             }
         }
-        if(match(iterator, TOKEN_TYPE_SPECIFIER_PUNCTUATOR_pipe)){
+        if(match(iterator, TOKEN_TYPE_PUNCTUATOR_pipe)){
             pipeFile = parseExpression(iterator);
         }
+        if(match(iterator, TOKEN_TYPE_PUNCTUATOR_error_pipe)){
+            errorFile = parseExpression(iterator);
+        }
 
         consume(iterator, TOKEN_TYPE_PUNCTUATOR_brace_open, "expected body");
         operation->commandStatementList = parseCommandStatementList(iterator);
@@ -562,6 +566,7 @@ static struct PerformOperation* parsePerformOperation(TokenIterator* iterator) {
         operation->commandStatementList->retCodeIndex = retCodeIndex;
         operation->commandStatementList->outputVariableIndex = outputVariableIndex;
         operation->commandStatementList->pipeFile = pipeFile;
+        operation->commandStatementList->errorFile = errorFile;
 
         return operation;
     }
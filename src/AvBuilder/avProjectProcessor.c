@@ -410,6 +410,9 @@ bool32 processCommandStatementList(struct CommandStatementBody_S* body, struct C
     if(statement->pipeFile){
         body->pipeFile = processExpression(statement->pipeFile, project);
     }
+    if(statement->errorFile){
+        body->errorFile = processExpression(statement->errorFile, project);
+    }
 
     body->statementCount = statementCount;
     body->statements = statements;
@@ -647,30 +650,179 @@ struct Statement_S* processImportStatement(struct ImportStatement import, Projec
 }
 
 static bool32 checkVariablePreviouslyDefined(AvString symbol, Project* project){
-    avDynamicArrayForEachElement(struct ImportDescription, project->externals, {
-        if(avStringEquals(element.identifier, symbol)){
-            return true;
-        }
-    });
-    avDynamicArrayForEachElement(struct FunctionDescription, project->functions, {
-        if(avStringEquals(element.identifier, symbol)){
-            return true;
-        }
-    });
-    return false;
+    uint32 index = 0;
+    return symbolTableFind(&project->symbols, SYMBOL_KIND_EXTERNAL, symbol, &index)
+        || symbolTableFind(&project->symbols, SYMBOL_KIND_FUNCTION, symbol, &index);
 };
 
 static bool32 checkPreviouslyDefined(AvString symbol, Project* project){
     if(checkVariablePreviouslyDefined(symbol, project)){
         return true;
     }
-    avDynamicArrayForEachElement(struct VariableDescription, project->variables, {
-        if(avStringEquals(element.identifier, symbol)){
+    uint32 index = 0;
+    return symbolTableFind(&project->symbols, SYMBOL_KIND_VARIABLE, symbol, &index);
+};
+
+static void addLocalName(AvString name, AvDynamicArray names){
+    if(name.len){
+        avDynamicArrayAdd(&name, names);
+    }
+}
+
+static void collectCommandLocals(const struct CommandStatementBody_S* body, AvDynamicArray names){
+    addLocalName(body->retCodeVariable, names);
+    addLocalName(body->outputVariable, names);
+    for(uint32 i = 0; i < body->statementCount; i++){
+        const struct CommandStatement_S* statement = body->statements + i;
+        if(statement->type == COMMAND_STATEMENT_VARIABLE_ASSIGNMENT){
+            addLocalName(statement->variableAssignment.variableName, names);
+        }
+        if(statement->type == COMMAND_STATEMENT_IF_STATEMENT){
+            for(const struct IfCommandStatement_S* branch = &statement->ifStatement; branch; branch = branch->alternativeBranch){
+                if(branch->branch){
+                    collectCommandLocals(branch->branch, names);
+                }
+            }
+        }
+    }
+}
+
+static void collectPerformLocals(const struct PerformStatementBody_S* body, AvDynamicArray names){
+    for(uint32 i = 0; i < body->statementCount; i++){
+        const struct PerformStatement_S* statement = body->statements + i;
+        switch(statement->type){
+            case PERFORM_STATEMENT_TYPE_COMMAND:
+                collectCommandLocals(&statement->commandStatement, names);
+                break;
+            case PERFORM_STATEMENT_TYPE_VARIABLE_ASSIGNMENT:
+                addLocalName(statement->variableAssignment.variableName, names);
+                break;
+            case PERFORM_STATEMENT_TYPE_VARIABLE_DEFINITION:
+                addLocalName(statement->variableDefinition.identifier, names);
+                break;
+            case PERFORM_STATEMENT_TYPE_IF_STATEMENT:
+                for(const struct IfPerformStatement_S* branch = &statement->ifStatement; branch; branch = branch->alternativeBranch){
+                    if(branch->branch){
+                        collectPerformLocals(branch->branch, names);
+                    }
+                }
+                break;
+            case PERFORM_STATEMENT_TYPE_FUNCTION_CALL:
+            case PERFORM_STATEMENT_TYPE_NONE:
+                break;
+        }
+    }
+}
+
+static void collectFunctionLocals(const struct FunctionBody_S* body, AvDynamicArray names){
+    for(uint32 i = 0; i < body->statementCount; i++){
+        const struct FunctionStatement_S* statement = body->statements + i;
+        switch(statement->type){
+            case FUNCTION_STATEMENT_TYPE_PERFORM:
+                collectPerformLocals(&statement->performStatement, names);
+                break;
+            case FUNCTION_STATEMENT_TYPE_FOREACH:
+                addLocalName(statement->foreachStatement.variable, names);
+                addLocalName(statement->foreachStatement.index, names);
+                collectPerformLocals(&statement->foreachStatement.performStatement, names);
+                break;
+            case FUNCTION_STATEMENT_TYPE_VAR_DEFINITION:
+                addLocalName(statement->variableDefinition.identifier, names);
+                break;
+            case FUNCTION_STATEMENT_TYPE_IF:
+                for(const struct IfFunctionStatement_S* branch = &statement->ifStatement; branch; branch = branch->alternativeBranch){
+                    if(branch->branch){
+                        collectFunctionLocals(branch->branch, names);
+                    }
+                }
+                break;
+            case FUNCTION_STATEMENT_TYPE_RETURN:
+            case FUNCTION_STATEMENT_TYPE_NONE:
+                break;
+        }
+    }
+}
+
+static bool32 isLocalName(AvString name, AvDynamicArray names){
+    uint32 count = avDynamicArrayGetSize(names);
+    for(uint32 i = 0; i < count; i++){
+        AvString local = AV_EMPTY;
+        avDynamicArrayRead(&local, i, names);
+        if(avStringEquals(name, local)){
             return true;
         }
-    });
+    }
     return false;
-};
+}
+
+static bool32 expressionCacheable(const struct Expression_S* expression, AvDynamicArray names){
+    if(expression == nullptr){
+        return true;
+    }
+    switch(expression->type){
+        case EXPRESSION_TYPE_IDENTIFIER:
+            return !isLocalName(expression->identifier.identifier, names);
+        case EXPRESSION_TYPE_CALL:
+            return false;
+        case EXPRESSION_TYPE_ARRAY:
+            for(uint32 i = 0; i < expression->array.length; i++){
+                if(!expressionCacheable(expression->array.elements + i, names)){
+                    return false;
+                }
+            }
+            return true;
+        case EXPRESSION_TYPE_GROUPING:
+            return expressionCacheable(expression->grouping.expression, names);
+        case EXPRESSION_TYPE_UNARY:
+            return expressionCacheable(expression->unary.expression, names);
+        case EXPRESSION_TYPE_SUMMATION:
+            return expressionCacheable(expression->summation.left, names) && expressionCacheable(expression->summation.right, names);
+        case EXPRESSION_TYPE_MULTIPLICATION:
+            return expressionCacheable(expression->multiplication.left, names) && expressionCacheable(expression->multiplication.right, names);
+        case EXPRESSION_TYPE_COMPARISON:
+            return expressionCacheable(expression->comparison.left, names) && expressionCacheable(expression->comparison.right, names);
+        case EXPRESSION_TYPE_ENUMERATION:
+            return expressionCacheable(expression->enumeration.directory, names);
+        case EXPRESSION_TYPE_FILTER:
+            for(uint32 i = 0; i < expression->filter.filterCount; i++){
+                if(!expressionCacheable(expression->filter.filters + i, names)){
+                    return false;
+                }
+            }
+            return expressionCacheable(expression->filter.expression, names);
+        case EXPRESSION_TYPE_NONE:
+        case EXPRESSION_TYPE_LITERAL:
+        case EXPRESSION_TYPE_NUMBER:
+            return true;
+    }
+    return false;
+}
+
+// lazily evaluated globals are evaluated with the locals of the running function visible. A global reading a name
+// any function of the file declares or assigns as a local, or calling a function, is evaluated on every read
+static void markCacheableGlobals(Project* project){
+    AV_DS(AvDynamicArray, AvString) names = AV_EMPTY;
+    avDynamicArrayCreate(0, sizeof(AvString), &names);
+    for(uint32 i = 0; i < project->statementCount; i++){
+        struct Statement_S* statement = project->statements[i];
+        if(statement->type != STATEMENT_TYPE_FUNCTION_DEFINITION){
+            continue;
+        }
+        struct FunctionDefinition_S* function = &statement->functionDefinition;
+        for(uint32 j = 0; j < function->parameterCount; j++){
+            addLocalName(function->parameters[j], names);
+        }
+        collectFunctionLocals(&function->body, names);
+    }
+    for(uint32 i = 0; i < project->statementCount; i++){
+        struct Statement_S* statement = project->statements[i];
+        if(statement->type == STATEMENT_TYPE_VARIABLE_ASSIGNMENT){
+            statement->variableAssignment.cacheable = statement->variableAssignment.value
+                && expressionCacheable(statement->variableAssignment.value, names);
+        }
+    }
+    avDynamicArrayDestroy(names);
+}
 
 bool32 processProject(void* statements, Project* project){
     struct ProjectStatementList* statementList = statements;
@@ -710,7 +862,16 @@ bool32 processProject(void* statements, Project* project){
         index++;
         statementList = statementList->next;
     }
+    markCacheableGlobals(project);
+
+    if(!registerProjectStatements(project)){
+        return false;
+    }
+    return (project->processState == PROCESS_STATE_OK);
+}
 
+// adds the functions, externals and library aliases declared by the processed statements
+bool32 registerProjectStatements(Project* project){
     for(uint32 i = 0; i < project->statementCount; i++){
         struct Statement_S* statement = (project->statements)[i];
 
@@ -742,6 +903,7 @@ bool32 processProject(void* statements, Project* project){
                         },
                         .isLocalFile = import.local,
                     };
+                    symbolTableAdd(&project->symbols, SYMBOL_KIND_EXTERNAL, external.identifier, avDynamicArrayGetSize(project->externals));
                     avDynamicArrayAdd(&external, project->externals);
                 }
                 break;
@@ -757,6 +919,7 @@ bool32 processProject(void* statements, Project* project){
                     .statement = i,
                     .project = project,
                 };
+                symbolTableAdd(&project->symbols, SYMBOL_KIND_FUNCTION, func.identifier, avDynamicArrayGetSize(project->functions));
                 avDynamicArrayAdd(&func, project->functions);
                 break;
             }
@@ -769,8 +932,5 @@ bool32 processProject(void* statements, Project* project){
         }
 
     }
-
-
-    return (project->processState == PROCESS_STATE_OK);
-
+    return true;
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+// O_CLOEXEC is not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
 #include "avBuilder.h"
 #include <AvUtils/avMemory.h>
 #include <AvUtils/logging/avAssert.h>
@@ -10,6 +12,12 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <limits.h>
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
 #include <AvUtils/avProcess.h>
 #include <AvUtils/avEnvironment.h>
 #include <AvUtils/process/avPipe.h>
@@ -18,12 +26,23 @@
 #include <AvUtils/dataStructures/avDynamicArray.h>
 
 #include "avProjectLang.h"
+#include "avBuilderByteCode.h"
 #include "builtIn/avBuilderBuiltIn.h"
 
 #define NULL_VALUE (struct Value){0}
 
 void printValue(struct Value value);
 
+// set while the watch loop or the build server runs a project, see runModule
+static jmp_buf* runtimeErrorRecovery = nullptr;
+
+// returns the previous recovery point, nullptr makes runtime errors end the process again
+jmp_buf* runtimeErrorRecover(jmp_buf* recovery){
+    jmp_buf* previous = runtimeErrorRecovery;
+    runtimeErrorRecovery = recovery;
+    return previous;
+}
+
 void runtimeError(Project* project, const char* message, ...){
     va_list args;
     va_start(args, message);
@@ -33,30 +52,29 @@ void runtimeError(Project* project, const char* message, ...){
 
     avStringPrintf(AV_CSTR("\nVariables: [\n"));
 
-    LocalContext* context = project->localContext;
-
-    while(context){
-        if(avDynamicArrayGetSize(context->variables) > 0){
-            for(uint32 index = 0; index < avDynamicArrayGetSize(context->variables); index++) { 
-                struct VariableDescription element; avDynamicArrayRead(&element, index, (context->variables)); { 
-                    struct VariableDescription var = element; 
-                    avStringPrintf(AV_CSTR("\t%s = "), var.identifier); 
-                    if(var.value){
-                        printValue(*var.value); 
-                    }else{
-                        avStringPrint(AV_CSTR("NULL"));
-                    }
-                    avStringPrint(AV_CSTR("\n")); 
-                } 
+    LocalContext* context = &project->localContext;
+    uint32 visibleBase = localContextVisibleBase(project);
+    for(uint32 frame = context->frameCount; frame > 0; frame--){
+        uint32 base = context->frames[frame - 1].base;
+        uint32 end = frame == context->frameCount ? context->variableCount : context->frames[frame].base;
+        if(end > base){
+            for(uint32 index = base; index < end; index++){
+                struct VariableDescription var = context->variables[index];
+                avStringPrintf(AV_CSTR("\t%s = "), var.identifier);
+                if(var.value){
+                    printValue(*var.value);
+                }else{
+                    avStringPrint(AV_CSTR("NULL"));
+                }
+                avStringPrint(AV_CSTR("\n"));
             }
-            if(context->previous){
+            if(frame > 1){
                 avStringPrint(AV_CSTR("], [\n"));
             }
         }
-        if(!context->inherit){
+        if(base <= visibleBase){
             break;
         }
-        context = context->previous;
     }
     avStringPrintf(AV_CSTR("]\n"));
 
@@ -97,10 +115,13 @@ void runtimeError(Project* project, const char* message, ...){
     });
     avStringPrintf(AV_CSTR("]\n"));
 
+    if(runtimeErrorRecovery){
+        longjmp(*runtimeErrorRecovery, 1);
+    }
     avAssert(false, "runtime error");
 }
 
-static uint32 parseNumber(AvString string){
+uint32 parseNumber(AvString string){
     
 
     enum NumberType {
@@ -173,6 +194,8 @@ static uint32 parseNumber(AvString string){
 }
 
 struct Value getValue(struct Expression_S* expression, Project* project);
+struct ExpressionByteCode* compileExpression(struct Expression_S* expression, Project* project);
+struct Value runExpressionByteCode(struct ExpressionByteCode* byteCode, Project* project);
 
 void toConstValue(struct Value value, struct ConstValue* val, Project* project){
     val->type = value.type;
@@ -208,24 +231,23 @@ void toValue(struct ConstValue value, struct Value* val){
     }
 }
 
-struct ArrayValue getArray(struct ArrayExpression_S array, Project* project){
+struct ArrayValue makeArray(uint32 count, struct Value* elements, Project* project){
     struct ArrayValue arr = { 
-        .count = array.length, 
-        .values = array.length ? avAllocatorAllocate(sizeof(struct ConstValue)*array.length, &project->allocator) : nullptr,
+        .count = count, 
+        .values = count ? projectAllocate(project, sizeof(struct ConstValue)*count) : nullptr,
     };
     avDynamicArrayAdd(&arr.values, project->arrays);
-    for(uint32 i = 0; i < array.length; i++){
+    for(uint32 i = 0; i < count; i++){
         struct ConstValue value = {0};
-        toConstValue(getValue(array.elements + i, project), &value, project);
+        toConstValue(elements[i], &value, project);
         memcpy(arr.values+i, &value, sizeof(struct ConstValue));
     }
     return arr;
 }
 
-struct Value performUnary(struct UnaryExpression_S expression, Project* project){
-    switch(expression.operator){
+struct Value applyUnary(enum UnaryOperator operator, struct Value value, Project* project){
+    switch(operator){
         case UNARY_OPERATOR_MINUS:{
-            struct Value value = getValue(expression.expression, project);
             if(value.type != VALUE_TYPE_NUMBER){
                 runtimeError( project,"unary minus operator not defined for types other than number");
                 return (struct Value){0};
@@ -234,7 +256,6 @@ struct Value performUnary(struct UnaryExpression_S expression, Project* project)
             return value;
         }
         case UNARY_OPERATOR_NOT:{
-            struct Value value = getValue(expression.expression, project);
             if(value.type == VALUE_TYPE_NUMBER){
                 value.asNumber = !value.asNumber;
                 return value;
@@ -286,7 +307,7 @@ struct Value concatenateStrings(struct Value left, struct Value right, Project*
         memcpy(&rstr, &right.asString, sizeof(AvString));
     }
     uint64 len = lstr.len + rstr.len;
-    char* mem = avAllocatorAllocate(len+1, &project->allocator);
+    char* mem = projectAllocate(project, len+1);
     memcpy(mem, lstr.chrs, lstr.len);
     memcpy(mem+lstr.len, rstr.chrs, rstr.len);
     AvString str = {
@@ -300,9 +321,7 @@ struct Value concatenateStrings(struct Value left, struct Value right, Project*
     };
 }
 
-struct Value performComparison(struct ComparisonExpression_S expression, Project* project){
-    struct Value left = getValue(expression.left, project);
-    struct Value right = getValue(expression.right, project);
+struct Value applyComparison(struct Value left, enum ComparisonOperator operator, struct Value right, Project* project){
 
     if((left.type & (VALUE_TYPE_STRING|VALUE_TYPE_NUMBER)) != (right.type & (VALUE_TYPE_STRING|VALUE_TYPE_NUMBER)) && left.type != VALUE_TYPE_ARRAY){
         runtimeError(project, "Comparing two different types is not allowed");
@@ -341,7 +360,7 @@ struct Value performComparison(struct ComparisonExpression_S expression, Project
                 .asNumber = 0,
             }; 
         }
-        struct ConstValue* values = avAllocatorAllocate(sizeof(struct ConstValue)*array.count, &project->allocator);
+        struct ConstValue* values = projectAllocate(project, sizeof(struct ConstValue)*array.count);
         for(uint32 i = 0; i < array.count; i++){
             struct ConstValue v = array.values[i];
             uint32 value = 0;
@@ -351,7 +370,7 @@ struct Value performComparison(struct ComparisonExpression_S expression, Project
             }
             switch(val.type){
                 case VALUE_TYPE_NUMBER:
-                    switch(expression.operator){
+                    switch(operator){
                         case COMPARISON_OPERATOR_EQUALS:
                             value = v.asNumber==val.asNumber;
                             break;
@@ -378,7 +397,7 @@ struct Value performComparison(struct ComparisonExpression_S expression, Project
                     values[i].asNumber = value;
                     continue;   
                 case VALUE_TYPE_STRING:
-                    switch(expression.operator){
+                    switch(operator){
                         case COMPARISON_OPERATOR_EQUALS:
                             value = avStringEquals(v.asString, val.asString);
                             break;
@@ -411,7 +430,7 @@ struct Value performComparison(struct ComparisonExpression_S expression, Project
 
     if(left.type == VALUE_TYPE_NUMBER){
         uint32 value = 0;
-        switch(expression.operator){
+        switch(operator){
             case COMPARISON_OPERATOR_EQUALS:
                 value = left.asNumber==right.asNumber;
                 break;
@@ -441,7 +460,7 @@ struct Value performComparison(struct ComparisonExpression_S expression, Project
     }
     if(left.type == VALUE_TYPE_STRING){
         uint32 value = 0;
-        switch(expression.operator){
+        switch(operator){
             case COMPARISON_OPERATOR_EQUALS:
                 value = avStringEquals(left.asString, right.asString);
                 break;
@@ -466,12 +485,8 @@ struct Value performComparison(struct ComparisonExpression_S expression, Project
 }
 
 
-struct Value performSummation(struct SummationExpression_S expression, Project* project){
+struct Value applySummation(struct Value left, enum SummationOperator operator, struct Value right, Project* project){
     uint32 value = 0;
-    struct Value left = getValue(expression.left, project);
-    
-    struct Value right = getValue(expression.right, project);
-    
     if(left.type != VALUE_TYPE_NUMBER && left.type != VALUE_TYPE_STRING){
         runtimeError( project,"add operator not defined for types other than number or string");
         return (struct Value){0};
@@ -481,7 +496,7 @@ struct Value performSummation(struct SummationExpression_S expression, Project*
         return (struct Value){0};
     }
 
-    switch(expression.operator){
+    switch(operator){
         case SUMMATION_OPERATOR_ADD:
             if(left.type == VALUE_TYPE_STRING || right.type == VALUE_TYPE_STRING){
                 return concatenateStrings(left, right, project);
@@ -506,19 +521,17 @@ struct Value performSummation(struct SummationExpression_S expression, Project*
 
 }
 
-struct Value performMultiplication(struct MultiplicationExpression_S expression, Project* project){
+struct Value applyMultiplication(struct Value left, enum MultiplicationOperator operator, struct Value right, Project* project){
     uint32 value = 0;
-    struct Value left = getValue(expression.left, project);
     if(left.type != VALUE_TYPE_NUMBER){
         runtimeError( project,"unary minus operator not defined for types other than number");
         return (struct Value){0};
     }
-    struct Value right = getValue(expression.right, project);
     if(right.type != VALUE_TYPE_NUMBER){
         runtimeError( project,"unary minus operator not defined for types other than number");
         return (struct Value){0};
     }
-    switch(expression.operator){
+    switch(operator){
         case MULTIPLICATION_OPERATOR_MULTIPLY:
             value = left.asNumber * right.asNumber;
         break;
@@ -549,55 +562,24 @@ Project* importProject(AvString projectFile, bool32 local, Project* baseProject)
     avStringDebugContextStart;
 
     AvString projectFileStr = AV_EMPTY;
-    if(!local){
-#ifndef _WIN32    
-        AvString homeDir = AV_EMPTY;
-        if(!avGetEnvironmentVariable(AV_CSTR("HOME"), &homeDir)){
-            runtimeError(baseProject, "Could not get HOME environment variable");
+    if(!resolveImportPath(projectFile, local, &projectFileStr)){
+        runtimeError(baseProject, "Could not get " HOME_ENVIRONMENT_VARIABLE " environment variable");
+        avStringDebugContextEnd;
+        return nullptr;
+    }
+
+    Project* project = projectAllocate(baseProject, sizeof(Project));
+    uint64 moduleKey = projectFileKey(projectFileStr);
+    if(!moduleRegistryInstantiate(moduleKey, project)){
+        if(!loadProjectModule(projectFileStr, project)){
+            avStringFree(&projectFileStr);
+            avStringDebugContextEnd;
             return nullptr;
         }
-#else
-        AvString homeDir = AV_EMPTY;
-        if(!avGetEnvironmentVariable(AV_CSTR("USERPROFILE"), &homeDir)){
-            runtimeError(baseProject, "Could not get USERPROFILE environment variable");
-            return nullptr;
-        }
-#endif
-        avStringJoin(&projectFileStr, homeDir, AV_CSTRA("/"), configPath, templatePath, projectFile);
-        avStringFree(&homeDir);
-    }else{
-        avStringClone(&projectFileStr, projectFile);
-    }
-
-    AvString projectFileContent = AV_EMPTY;
-    AvString projectFileName = AV_EMPTY;
-    if(!loadProjectFile(projectFileStr, &projectFileContent, &projectFileName)){
-        avStringPrintf(AV_CSTR("Failed to load project file %s\n"), projectFileStr);
-        goto loadingFailed;
-    }
-
-    AV_DS(AvDynamicArray, Token) tokens = AV_EMPTY;
-    avDynamicArrayCreate(0, sizeof(Token), &tokens);
-    if(!tokenizeProject(projectFileContent, projectFileName, tokens)){
-        avStringPrintf(AV_CSTR("Failed to tokenize project file %s\n"), projectFileStr);
-        goto tokenizingFailed;
+        moduleRegistryAdd(moduleKey, project);
     }
-    //printTokenList(tokens);
-   
-    Project* project = avAllocatorAllocate(sizeof(Project), &baseProject->allocator);
     avDynamicArrayAdd(&project, baseProject->importedProjects);
 
-    projectCreate(project, projectFileName, projectFileStr, projectFileContent);
-    struct ProjectStatementList* statements = nullptr;
-    if(!parseProject(tokens, (void**)&statements, project)){
-        avStringPrintf(AV_CSTR("Failed to parse project file %s\n"), projectFileStr);
-        goto parsingFailed;
-    }
-    
-    if(!processProject(statements, project)){
-        avStringPrintf(AV_CSTR("Failed to perform processing on project file %s\n"), projectFileStr);
-        goto processingFailed;
-    }
     AvDynamicArray tmpArray = AV_EMPTY;
     avDynamicArrayClone(baseProject->libraryAliases, &tmpArray);
     avDynamicArrayAppend(project->libraryAliases, &tmpArray); 
@@ -656,21 +638,13 @@ Project* importProject(AvString projectFile, bool32 local, Project* baseProject)
                 goto processingFailed;
         }
     }
-    avDynamicArrayDestroy(tokens);
     avStringFree(&projectFileStr);
     memcpy(&project->options, &baseProject->options, sizeof(struct ProjectOptions));
-    avStringFree(&projectFileName);
     avStringDebugContextEnd;
     return project;
 
 processingFailed:
-parsingFailed:
-    projectDestroy(project);
-tokenizingFailed:
-    avDynamicArrayDestroy(tokens);
-loadingFailed:
-    avStringFree(&projectFileName); 
-    avStringFree(&projectFileContent);
+    // the project is destroyed along with the importing project
     avStringFree(&projectFileStr);
     avStringDebugContextEnd;
     return nullptr;
@@ -678,25 +652,35 @@ loadingFailed:
 
 
 
-struct VariableDescription importVariable(struct ImportDescription import, Project* project){
-
-    bool32 found = false;
-    Project* extProject = nullptr;
-    for(uint32 index = 0; index < avDynamicArrayGetSize(project->importedProjects); index++) { 
-        Project* element; 
-        avDynamicArrayRead(&element, index, (project->importedProjects)); 
-        { 
-            if(avStringEquals(import.importFile, element->projectFileName)){
-                found = true;
-                extProject = element;
-                break;
-            }
-        }
+// imported projects are registered under the name they were imported by, so each file is loaded once
+static Project* findImportedProject(struct ImportDescription import, Project* project){
+    enum SymbolKind kind = import.isLocalFile ? SYMBOL_KIND_LOCAL_PROJECT : SYMBOL_KIND_PROJECT;
+    uint32 index = 0;
+    if(symbolTableFind(&project->symbols, kind, import.importFile, &index)){
+        Project* extProject = nullptr;
+        avDynamicArrayRead(&extProject, index, project->importedProjects);
+        return extProject;
     }
 
-    if(!found){
-        extProject = importProject(import.importFile, import.isLocalFile, project);
+    uint64 traceStarted = traceStart();
+    Project* extProject = importProject(import.importFile, import.isLocalFile, project);
+    traceSpan("import", import.importFile, AV_EMPTY_STRING, traceStarted);
+    if(!extProject){
+        return nullptr;
     }
+    // the import description may be remapped later on, the key has to outlive it
+    AvString key = {
+        .chrs = projectAllocate(project, import.importFile.len),
+        .len = import.importFile.len,
+        .memory = nullptr,
+    };
+    memcpy((char*)key.chrs, import.importFile.chrs, import.importFile.len);
+    symbolTableAdd(&project->symbols, kind, key, avDynamicArrayGetSize(project->importedProjects) - 1);
+    return extProject;
+}
+
+struct VariableDescription importVariable(struct ImportDescription import, Project* project){
+    Project* extProject = findImportedProject(import, project);
     if(!extProject){
         runtimeError(project, "failed to import project file %s", import.importFile);
         return (struct VariableDescription) {0};
@@ -706,52 +690,306 @@ struct VariableDescription importVariable(struct ImportDescription import, Proje
 }
 
 struct VariableDescription findVariableInGlobalScope(AvString identifier, Project* project){
-    uint32 existingVariableCount = avDynamicArrayGetSize(project->variables);
-    for(uint32 i = 0; i < existingVariableCount; i++){
-        struct VariableDescription var = (struct VariableDescription){0};
-        avDynamicArrayRead(&var, i, project->variables);
-        if(avStringEquals(identifier, var.identifier)){
-            return var;
-        }
+    uint32 index = 0;
+    struct VariableDescription var = (struct VariableDescription){0};
+    if(symbolTableFind(&project->symbols, SYMBOL_KIND_VARIABLE, identifier, &index)){
+        avDynamicArrayRead(&var, index, project->variables);
+        return var;
     }
-    uint32 existingConstantCount = avDynamicArrayGetSize(project->constants);
-    for(uint32 i = 0; i < existingConstantCount; i++){
-        struct VariableDescription var = (struct VariableDescription){0};
-        avDynamicArrayRead(&var, i, project->constants);
-        if(avStringEquals(identifier, var.identifier)){
-            return var;
-        }
+    if(symbolTableFind(&project->symbols, SYMBOL_KIND_CONSTANT, identifier, &index)){
+        avDynamicArrayRead(&var, index, project->constants);
+        return var;
     }
-    uint32 externalCount = avDynamicArrayGetSize(project->externals);
-    for(uint32 i = 0; i < externalCount; i++){
+    if(symbolTableFind(&project->symbols, SYMBOL_KIND_EXTERNAL, identifier, &index)){
         struct ImportDescription ext = (struct ImportDescription){0};
-        avDynamicArrayRead(&ext, i, project->externals);
-        if(avStringEquals(identifier, ext.identifier)){
-            return importVariable(ext, project);
-        }
+        avDynamicArrayRead(&ext, index, project->externals);
+        return importVariable(ext, project);
     }
-    return (struct VariableDescription){0};
+    return var;
 }
 
 struct VariableDescription findVariable(AvString identifier, Project* project){
+    struct VariableDescription* local = findLocalVariable(identifier, project);
+    if(local){
+        return *local;
+    }
+    return findVariableInGlobalScope(identifier, project);
+}
 
-    LocalContext* context = project->localContext;
-    while(context){
-        uint32 localVariableCount = avDynamicArrayGetSize(context->variables);
-        for(uint32 i = 0; i < localVariableCount; i++){
-            struct VariableDescription var = (struct VariableDescription){0};
-            avDynamicArrayRead(&var, i, context->variables);
-            if(avStringEquals(identifier, var.identifier)){
-                return var;
-            }
+// the value of a lazily evaluated global, kept until a variable it read is assigned or a directory it enumerated
+// may have been written to
+struct CachedValue {
+    Project* project;
+    uint32 variable;
+    struct Value value;
+    uint32 readCount;
+    AvString* reads;
+    uint32 directoryCount;
+    char** directories; // absolute
+};
+
+// collects what the global being evaluated depends on, evaluations of other globals nest
+struct LazyEvaluation {
+    struct LazyEvaluation* parent;
+    bool32 uncacheable;
+    AV_DS(AvDynamicArray, AvString) reads;
+    AV_DS(AvDynamicArray, char*) directories;
+};
+
+static struct {
+    uint32 count;
+    uint32 capacity;
+    struct CachedValue** values;
+    struct LazyEvaluation* evaluation;
+} lazyValues = {0};
+
+static void recordVariableRead(AvString identifier){
+    if(lazyValues.evaluation){
+        avDynamicArrayAdd(&identifier, lazyValues.evaluation->reads);
+    }
+}
+
+// a path relative to the working directory made absolute, without . and .. components and trailing slashes
+static void resolveDirectoryPath(AvString path, char* resolved, uint64 size){
+    char joined[PATH_MAX * 2] = {0};
+    uint64 length = 0;
+    if(path.len == 0 || path.chrs[0] != '/'){
+        if(getcwd(joined, PATH_MAX) == nullptr){
+            joined[0] = '\0';
+        }
+        length = strlen(joined);
+        joined[length++] = '/';
+    }
+    uint64 copied = AV_MIN(path.len, sizeof(joined) - length - 1);
+    memcpy(joined + length, path.chrs, copied);
+    length += copied;
+    joined[length] = '\0';
+
+    uint64 written = 0;
+    for(uint64 i = 0; i < length;){
+        while(i < length && joined[i] == '/'){
+            i++;
+        }
+        uint64 start = i;
+        while(i < length && joined[i] != '/'){
+            i++;
+        }
+        uint64 componentLength = i - start;
+        if(componentLength == 0 || (componentLength == 1 && joined[start] == '.')){
+            continue;
         }
-        if(!context->inherit){
+        if(componentLength == 2 && joined[start] == '.' && joined[start+1] == '.'){
+            while(written > 0 && resolved[--written] != '/');
+            continue;
+        }
+        if(written + componentLength + 2 > size){
             break;
         }
-        context = context->previous;
+        resolved[written++] = '/';
+        memcpy(resolved + written, joined + start, componentLength);
+        written += componentLength;
     }
+    if(written == 0){
+        resolved[written++] = '/';
+    }
+    resolved[written] = '\0';
+}
 
-    return findVariableInGlobalScope(identifier, project);
+static void recordEnumeratedDirectory(AvString directory){
+    if(lazyValues.evaluation == nullptr){
+        return;
+    }
+    char resolved[PATH_MAX] = {0};
+    resolveDirectoryPath(directory, resolved, sizeof(resolved));
+    uint64 length = strlen(resolved);
+    char* path = avAllocate(length + 1, "enumerated directory");
+    memcpy(path, resolved, length + 1);
+    avDynamicArrayAdd(&path, lazyValues.evaluation->directories);
+}
+
+static void dropCachedValue(uint32 index){
+    struct CachedValue* cache = lazyValues.values[index];
+    struct VariableDescription* entry = avDynamicArrayGetPtr(cache->variable, cache->project->variables);
+    if(entry && entry->cache == cache){
+        entry->cache = nullptr;
+    }
+    for(uint32 i = 0; i < cache->directoryCount; i++){
+        avFree(cache->directories[i]);
+    }
+    avFree(cache);
+    lazyValues.values[index] = lazyValues.values[--lazyValues.count];
+}
+
+// a global was assigned, the values read from it are evaluated again
+static void invalidateVariableReaders(AvString identifier){
+    for(uint32 i = lazyValues.count; i > 0; i--){
+        struct CachedValue* cache = lazyValues.values[i - 1];
+        for(uint32 j = 0; j < cache->readCount; j++){
+            if(avStringEquals(cache->reads[j], identifier)){
+                dropCachedValue(i - 1);
+                break;
+            }
+        }
+    }
+}
+
+// whether one of the absolute paths is the other or lies within it
+static bool32 pathsOverlap(const char* a, const char* b){
+    uint64 lengthA = strlen(a);
+    uint64 lengthB = strlen(b);
+    uint64 length = AV_MIN(lengthA, lengthB);
+    if(memcmp(a, b, length) != 0){
+        return false;
+    }
+    if(lengthA == lengthB || length == 1){
+        return true;
+    }
+    return (lengthA > lengthB ? a : b)[length] == '/';
+}
+
+// a file or directory was created or written, enumerations of the directories around it are listed again
+void invalidatePathReaders(AvString path){
+    if(lazyValues.count == 0){
+        return;
+    }
+    char resolved[PATH_MAX] = {0};
+    resolveDirectoryPath(path, resolved, sizeof(resolved));
+    for(uint32 i = lazyValues.count; i > 0; i--){
+        struct CachedValue* cache = lazyValues.values[i - 1];
+        for(uint32 j = 0; j < cache->directoryCount; j++){
+            if(pathsOverlap(cache->directories[j], resolved)){
+                dropCachedValue(i - 1);
+                break;
+            }
+        }
+    }
+}
+
+// anything might have been written, or relative paths point somewhere else
+void invalidateFileSystemReaders(){
+    for(uint32 i = lazyValues.count; i > 0; i--){
+        if(lazyValues.values[i - 1]->directoryCount){
+            dropCachedValue(i - 1);
+        }
+    }
+}
+
+// the instance is destroyed, its cached values go with it
+void forgetCachedValues(Project* project){
+    for(uint32 i = lazyValues.count; i > 0; i--){
+        if(lazyValues.values[i - 1]->project == project){
+            dropCachedValue(i - 1);
+        }
+    }
+    if(lazyValues.count == 0 && lazyValues.values){
+        avFree(lazyValues.values);
+        lazyValues.values = nullptr;
+        lazyValues.capacity = 0;
+    }
+}
+
+// a cached value read by an enclosing evaluation makes it depend on the same things
+static void inheritDependencies(const struct CachedValue* cache){
+    struct LazyEvaluation* evaluation = lazyValues.evaluation;
+    if(evaluation == nullptr){
+        return;
+    }
+    avDynamicArrayAddRange(cache->reads, cache->readCount, 0, sizeof(AvString), evaluation->reads);
+    for(uint32 i = 0; i < cache->directoryCount; i++){
+        recordEnumeratedDirectory(AV_CSTR(cache->directories[i]));
+    }
+}
+
+static void cacheValue(struct VariableDescription* entry, uint32 variable, struct Value value, struct LazyEvaluation* evaluation, Project* owner){
+    uint32 readCount = avDynamicArrayGetSize(evaluation->reads);
+    uint32 directoryCount = avDynamicArrayGetSize(evaluation->directories);
+    uint64 readsSize = sizeof(AvString) * readCount;
+    struct CachedValue* cache = avCallocate(1, sizeof(struct CachedValue) + readsSize + sizeof(char*) * directoryCount, "cached value");
+    cache->project = owner;
+    cache->variable = variable;
+    cache->reads = (AvString*)(cache + 1);
+    cache->readCount = readCount;
+    avDynamicArrayReadRange(cache->reads, readCount, 0, sizeof(AvString), 0, evaluation->reads);
+    cache->directories = (char**)((char*)cache->reads + readsSize);
+    cache->directoryCount = directoryCount;
+    avDynamicArrayReadRange(cache->directories, directoryCount, 0, sizeof(char*), 0, evaluation->directories);
+    // readers write to their own copy of a cached array, see unshareArray
+    if(value.type == VALUE_TYPE_ARRAY){
+        value.asArray.shared = true;
+    }
+    cache->value = value;
+
+    if(lazyValues.count == lazyValues.capacity){
+        lazyValues.capacity = lazyValues.capacity ? lazyValues.capacity * 2 : 64;
+        lazyValues.values = avReallocate(lazyValues.values, sizeof(struct CachedValue*) * lazyValues.capacity, "cached values");
+    }
+    lazyValues.values[lazyValues.count++] = cache;
+    entry->cache = cache;
+}
+
+// gives an array its own copy of shared values before an element is written
+void unshareArray(struct Value* value, Project* project){
+    if(value->type != VALUE_TYPE_ARRAY || !value->asArray.shared){
+        return;
+    }
+    struct ConstValue* values = nullptr;
+    if(value->asArray.count){
+        values = projectAllocate(project, sizeof(struct ConstValue)*value->asArray.count);
+        memcpy(values, value->asArray.values, sizeof(struct ConstValue)*value->asArray.count);
+    }
+    value->asArray.values = values;
+    value->asArray.shared = false;
+}
+
+// evaluates a global that was never assigned a value in its own project, with the locals visible there. Whether
+// the value can be kept was decided when the file was processed, see markCacheableGlobals
+static struct Value evaluateLazyVariable(struct VariableDescription var, struct Statement_S* statement, Project* project){
+    Project* owner = var.project;
+    struct Expression_S* expression = statement->variableAssignment.value;
+    uint32 index = 0;
+    bool32 cacheable = statement->variableAssignment.cacheable
+        && symbolTableFind(&owner->symbols, SYMBOL_KIND_VARIABLE, var.identifier, &index);
+    if(cacheable){
+        struct VariableDescription* entry = avDynamicArrayGetPtr(index, owner->variables);
+        cacheable = entry->statement == var.statement && entry->value == nullptr;
+        if(cacheable && entry->cache){
+            inheritDependencies(entry->cache);
+            return entry->cache->value;
+        }
+    }
+    if(!cacheable){
+        // neither can the globals reading this one
+        if(lazyValues.evaluation){
+            lazyValues.evaluation->uncacheable = true;
+        }
+        return getValue(expression, owner);
+    }
+
+    struct LazyEvaluation evaluation = { .parent = lazyValues.evaluation };
+    avDynamicArrayCreate(0, sizeof(AvString), &evaluation.reads);
+    avDynamicArrayCreate(0, sizeof(char*), &evaluation.directories);
+    lazyValues.evaluation = &evaluation;
+    struct Value value = getValue(expression, owner);
+    lazyValues.evaluation = evaluation.parent;
+
+    struct VariableDescription* entry = avDynamicArrayGetPtr(index, owner->variables);
+    if(!evaluation.uncacheable && entry->value == nullptr){
+        cacheValue(entry, index, value, &evaluation, owner);
+        inheritDependencies(entry->cache);
+    }else{
+        if(lazyValues.evaluation){
+            lazyValues.evaluation->uncacheable = true;
+        }
+        uint32 directoryCount = avDynamicArrayGetSize(evaluation.directories);
+        for(uint32 i = 0; i < directoryCount; i++){
+            char* path = nullptr;
+            avDynamicArrayRead(&path, i, evaluation.directories);
+            avFree(path);
+        }
+    }
+    avDynamicArrayDestroy(evaluation.reads);
+    avDynamicArrayDestroy(evaluation.directories);
+    return value;
 }
 
 struct Value retrieveVariableValue(struct IdentifierExpression_S identifier, Project* project){
@@ -760,7 +998,9 @@ struct Value retrieveVariableValue(struct IdentifierExpression_S identifier, Pro
         runtimeError( project,"unable to find variable '%s'", identifier.identifier);
         return NULL_VALUE;
     }
+    recordVariableRead(identifier.identifier);
     if(description.value){
+        jobPoolWaitForValue(description.value);
         return *description.value;
     }
     avAssert(description.statement <= description.project->statementCount, "error in reading import project");
@@ -769,51 +1009,16 @@ struct Value retrieveVariableValue(struct IdentifierExpression_S identifier, Pro
         runtimeError( project,"importing variable of wrong type");
         return NULL_VALUE;
     }
-    return getValue(statement->variableAssignment.value, description.project);
-}
-
-static void addFilesInPath(AvString directory, AvPathRef root, bool32 recursive, bool32 dirs, AvDynamicArray files, Project* project){
-    AvPath path = AV_EMPTY;
-   if(!avDirectoryOpen(directory, root, &path)){
-        runtimeError(project, "unable to open directory %s", directory);
-        return;
-    }
-    
-    for(uint32 i = 0; i <path.contentCount; i++){
-        AvPathNode node = path.content[i];
-        
-        switch(node.type){
-            case AV_PATH_NODE_TYPE_FILE:{
-                if(dirs){
-                    break;
-                }
-                AvString str = {0};
-                avStringCopyToAllocator(node.fullName, &str, &project->allocator);
-                avDynamicArrayAdd(&str, files);
-                break;
-            }
-            case AV_PATH_NODE_TYPE_DIRECTORY:
-                if(recursive){
-                    addFilesInPath(node.name, &path, recursive, dirs, files, project);
-                }
-                if(dirs){
-                    AvString str = {0};
-                    avStringCopyToAllocator(node.fullName, &str, &project->allocator);
-                    avDynamicArrayAdd(&str, files); 
-                }
-                break;
-            case AV_PATH_NODE_TYPE_NONE:
-                runtimeError(project, "unknown type file %s", node.name);
-                break;
-        }
-    }
-    
-    avDirectoryClose(&path);
+    return evaluateLazyVariable(description, statement, project);
 }
 
-struct Value enumerateFiles(struct EnumerationExpression_S enumeration, Project* project){
+// lists the files (or directories) in the directories of the enumeration, keeping only paths ending in one of the suffixes if any are given
+static struct Value enumerateFilteredFiles(struct EnumerationExpression_S enumeration, uint32 suffixCount, const AvString* suffixes, Project* project){
 
+    // running commands might still be producing files
+    jobPoolWaitAll();
     
+    uint64 traceStarted = traceStart();
     struct Value directory = getValue(enumeration.directory, project);
     struct ConstValue constDirectory = (struct ConstValue){0};
 
@@ -830,42 +1035,98 @@ struct Value enumerateFiles(struct EnumerationExpression_S enumeration, Project*
         directories = &constDirectory;
     }
 
-    AvDynamicArray files = AV_EMPTY;
-    avDynamicArrayCreate(0, sizeof(AvString), &files);
+    struct Value value = {
+        .type = VALUE_TYPE_NONE,
+        .asString = AV_EMPTY
+    };
 
+    struct FileWalk* walk = fileWalkCreate(enumeration.recursive, enumeration.dirs, suffixCount, suffixes);
     for(uint32 i = 0; i < directoryCount; i++){
         struct ConstValue dirValue = directories[i];
         if(dirValue.type!=VALUE_TYPE_STRING){
             runtimeError(project, "invalid directory");
             continue;
         }
-        AvString dir = dirValue.asString;
-        addFilesInPath(dir, nullptr, enumeration.recursive, enumeration.dirs, files, project);
+        recordEnumeratedDirectory(dirValue.asString);
+        fileWalkAdd(walk, dirValue.asString);
     }
+    fileWalkRun(walk);
+    traceSpan("filesystem", enumeration.dirs ? AV_CSTR("dirs in") : AV_CSTR("files in"),
+        directoryCount == 1 && directories[0].type == VALUE_TYPE_STRING ? directories[0].asString : AV_EMPTY_STRING, traceStarted);
 
-    uint32 fileCount = avDynamicArrayGetSize(files);
+    uint32 failure = 0;
+    AvString failedDirectory = AV_EMPTY;
+    while(fileWalkNextFailure(walk, &failure, &failedDirectory)){
+        runtimeError(project, "unable to open directory %s", failedDirectory);
+    }
 
-    struct Value value = {
-        .type = VALUE_TYPE_NONE,
-        .asString = AV_EMPTY
-    };
+    // every path goes into one block of the project allocator
+    uint64 size = 0;
+    uint32 fileCount = fileWalkCount(walk, &size);
     if(fileCount == 0){
-        goto end;
+        fileWalkDestroy(walk);
+        return value;
     }
+    char* block = projectAllocate(project, size);
     if(fileCount == 1){
-        value.type = VALUE_TYPE_STRING;
-        avDynamicArrayRead(&value.asString, 0, files);
-        goto end;
+        struct ConstValue file = {0};
+        fileWalkWrite(walk, block, &file);
+        toValue(file, &value);
+        fileWalkDestroy(walk);
+        return value;
     }
     value.type = VALUE_TYPE_ARRAY;
     value.asArray.count = fileCount;
-    value.asArray.values = avAllocatorAllocate(sizeof(struct ConstValue)*fileCount, &project->allocator);
-    avDynamicArrayReadRange(value.asArray.values, fileCount, offsetof(struct ConstValue,asString), sizeof(struct ConstValue), 0, files);
-    avDynamicArrayForEachElement(AvString, files, {
-        value.asArray.values[index].type = VALUE_TYPE_STRING;
-    });
-end:
-    avDynamicArrayDestroy(files);
+    value.asArray.values = projectAllocate(project, sizeof(struct ConstValue)*fileCount);
+    fileWalkWrite(walk, block, value.asArray.values);
+    fileWalkDestroy(walk);
+    return value;
+}
+
+struct Value enumerateFiles(struct EnumerationExpression_S enumeration, Project* project){
+    return enumerateFilteredFiles(enumeration, 0, nullptr, project);
+}
+
+// filter(FILTER_TYPE_ENDS_WITH, suffixes, files in dir) drops the names while the directories are walked,
+// instead of listing every file first. values holds the first two arguments
+static bool32 isFilteredEnumeration(struct CallExpression_S call, struct Value* values, Project* project){
+    struct BuiltInFunctionDescription builtIn = {0};
+    if(call.argumentCount != 3 || call.arguments[2].type != EXPRESSION_TYPE_ENUMERATION
+        || !isBuiltInFunction(&builtIn, call.function, project) || builtIn.function != filter){
+        return false;
+    }
+    if(values[0].type != VALUE_TYPE_NUMBER || values[0].asNumber != FILTER_TYPE_ENDS_WITH){
+        return false;
+    }
+    if(values[1].type == VALUE_TYPE_STRING){
+        return true;
+    }
+    if(values[1].type != VALUE_TYPE_ARRAY || values[1].asArray.count == 0){
+        return false;
+    }
+    for(uint32 i = 0; i < values[1].asArray.count; i++){
+        if(values[1].asArray.values[i].type != VALUE_TYPE_STRING){
+            return false;
+        }
+    }
+    return true;
+}
+
+static struct Value filterEnumeration(struct EnumerationExpression_S enumeration, struct Value filters, Project* project){
+    uint32 suffixCount = filters.type == VALUE_TYPE_ARRAY ? filters.asArray.count : 1;
+    AvString suffixes[suffixCount];
+    for(uint32 i = 0; i < suffixCount; i++){
+        suffixes[i] = filters.type == VALUE_TYPE_ARRAY ? filters.asArray.values[i].asString : filters.asString;
+    }
+    struct Value value = enumerateFilteredFiles(enumeration, suffixCount, suffixes, project);
+    if(value.type == VALUE_TYPE_NONE){
+        // filter returns an empty array when nothing is left
+        return (struct Value){
+            .type = VALUE_TYPE_ARRAY,
+            .asArray.count = 0,
+            .asArray.values = nullptr,
+        };
+    }
     return value;
 }
 
@@ -936,7 +1197,7 @@ struct Value filterValues(struct FilterExpression_S filter, Project* project){
 
     struct ConstValue* filteredValues = nullptr;
     if(allowedCount > 0){
-        filteredValues = avAllocatorAllocate(sizeof(struct ConstValue)*allowedCount, &project->allocator);
+        filteredValues = projectAllocate(project, sizeof(struct ConstValue)*allowedCount);
         avDynamicArrayReadRange(filteredValues, allowedCount, 0, sizeof(struct ConstValue), 0, newValues);
     }
     struct Value filtered = {
@@ -959,23 +1220,7 @@ struct Value filterValues(struct FilterExpression_S filter, Project* project){
 
 struct FunctionDescription findFunction(AvString identifier, Project* project);
 struct FunctionDescription importFunction(struct ImportDescription import, Project* project){
-    bool32 found = false;
-    Project* extProject = nullptr;
-    for(uint32 index = 0; index < avDynamicArrayGetSize(project->importedProjects); index++) { 
-        Project* element; 
-        avDynamicArrayRead(&element, index, (project->importedProjects)); 
-        { 
-            if(avStringEquals(import.importFile, element->projectFileName)){
-                found = true;
-                extProject = element;
-                break;
-            }
-        }
-    }
-
-    if(!found){
-        extProject = importProject(import.importFile, import.isLocalFile, project);
-    }
+    Project* extProject = findImportedProject(import, project);
     if(!extProject){
         runtimeError(project, "failed to import project file %s", import.importFile);
         return (struct FunctionDescription) {0};
@@ -985,21 +1230,16 @@ struct FunctionDescription importFunction(struct ImportDescription import, Proje
 }
 
 struct FunctionDescription findFunction(AvString identifier, Project* project){
-    uint32 existingFunctionCount = avDynamicArrayGetSize(project->functions);
-    for(uint32 i = 0; i < existingFunctionCount; i++){
+    uint32 index = 0;
+    if(symbolTableFind(&project->symbols, SYMBOL_KIND_FUNCTION, identifier, &index)){
         struct FunctionDescription func = (struct FunctionDescription){0};
-        avDynamicArrayRead(&func, i, project->functions);
-        if(avStringEquals(identifier, func.identifier)){
-            return func;
-        }
+        avDynamicArrayRead(&func, index, project->functions);
+        return func;
     }
-    uint32 externalCount = avDynamicArrayGetSize(project->externals);
-    for(uint32 i = 0; i < externalCount; i++){
+    if(symbolTableFind(&project->symbols, SYMBOL_KIND_EXTERNAL, identifier, &index)){
         struct ImportDescription ext = (struct ImportDescription){0};
-        avDynamicArrayRead(&ext, i, project->externals);
-        if(avStringEquals(identifier, ext.identifier)){
-            return importFunction(ext, project);
-        }
+        avDynamicArrayRead(&ext, index, project->externals);
+        return importFunction(ext, project);
     }
     return (struct FunctionDescription){0};
 }
@@ -1039,7 +1279,11 @@ void performForeach(struct ForeachStatement_S foreach, Project* project){
             avAssert(false,"logic error");
             break;
     }
+    uint32 previousIteration = jobPoolBeginIteration();
     for(uint32 i = 0; i < count; i++){
+        if(i != 0){
+            jobPoolBeginIteration();
+        }
         startLocalContext(project, true);
         addVariableToContext(collectionVar, project);
         struct Value value = NULL_VALUE;
@@ -1054,6 +1298,7 @@ void performForeach(struct ForeachStatement_S foreach, Project* project){
 
         endLocalContext(project);
     }
+    jobPoolEndLoop(previousIteration);
     
 
 }
@@ -1076,258 +1321,384 @@ struct CommandDescription {
     char* command;
 };
 
-uint32 processArg(AvString arg, AvDynamicArray chars, Project* project){
-    uint32 start = avDynamicArrayGetSize(chars);
+// command strings are compiled once into the literal text between their variable references. Templates are
+// shared by every scope expanding the same text, so the references are resolved by name while expanding
+enum TemplateSegmentType {
+    TEMPLATE_SEGMENT_LITERAL,
+    TEMPLATE_SEGMENT_VALUE,  // $name, elements of arrays are separated by spaces
+    TEMPLATE_SEGMENT_EXPAND, // *name, every element repeats the word around it
+};
+
+struct TemplateSegment {
+    enum TemplateSegmentType type;
+    bool32 important;
+    AvString text;       // the literal with its escapes removed, or the name of the variable
+    AvString unresolved; // written instead of a variable that has no value
+    bool32 startsWord;
+    uint32 suffixCount;  // segments after an expansion that belong to its word
+};
+
+struct CommandTemplate {
+    uint64 key;
+    AvString source;
+    uint32 segmentCount;
+    struct TemplateSegment* segments;
+    char* literals;
+    struct CommandTemplate* next;
+};
+
+// templates are looked up by their text, strings that never change are compiled again once this many are held
+#define COMMAND_TEMPLATE_MAX_COUNT 4096
+#define COMMAND_TEMPLATE_TABLE_SIZE 1024
+
+static struct {
+    uint32 count;
+    struct CommandTemplate* table[COMMAND_TEMPLATE_TABLE_SIZE];
+} commandTemplates = {0};
+
+struct TemplateOutput {
+    char* data;
+    uint64 size;
+    uint64 capacity;
+};
+
+static void reserveTemplateOutput(struct TemplateOutput* output, uint64 size){
+    if(output->capacity - output->size >= size){
+        return;
+    }
+    uint64 capacity = output->capacity ? output->capacity : 256;
+    while(capacity - output->size < size){
+        capacity *= 2;
+    }
+    char* data = avAllocate(capacity, "command");
+    if(output->data){
+        memcpy(data, output->data, output->size);
+        avFree(output->data);
+    }
+    output->data = data;
+    output->capacity = capacity;
+}
+
+static void appendTemplateOutput(struct TemplateOutput* output, const char* data, uint64 size){
+    if(size == 0){
+        return;
+    }
+    reserveTemplateOutput(output, size);
+    memcpy(output->data + output->size, data, size);
+    output->size += size;
+}
+
+static uint32 scanTemplateName(AvString str, uint32 start, uint32 marker){
+    uint32 j = start;
+    for(; j < str.len; j++){
+        char chr = str.chrs[j];
+        if(!(avCharIsLetter(chr) || (j-marker > 2 && avCharIsNumber(chr)) || chr=='_')){
+            break;
+        }
+    }
+    return j;
+}
+
+static struct CommandTemplate* compileTemplate(AvString str, uint64 key){
+    // a template has at most one segment per character, the literals never grow
+    uint64 size = sizeof(struct CommandTemplate) + sizeof(struct TemplateSegment) * (str.len + 1) + str.len * 2;
+    struct CommandTemplate* template = avCallocate(1, size, "command template");
+    template->key = key;
+    template->segments = (struct TemplateSegment*)(template + 1);
+    template->literals = (char*)(template->segments + str.len + 1);
+    char* source = template->literals + str.len;
+    memcpy(source, str.chrs, str.len);
+    template->source = (AvString){ .chrs = source, .len = str.len, .memory = nullptr };
+
+    char* literal = template->literals;
+    struct TemplateSegment* open = nullptr;
+    // every word starts a segment of its own, so an expansion knows where the expanded word began
+    bool32 wordStart = true;
+    uint32 expansion = -1;
     bool32 ignoreNext = false;
-    for(uint32 i = 0; i < arg.len; i++){
-        char c = arg.chrs[i];
-        if(c=='$' && !ignoreNext){
-            uint32 j = i+1;
+    for(uint32 i = 0; i < str.len; i++){
+        char c = source[i];
+        if((c=='$' || c=='*') && !ignoreNext){
+            struct TemplateSegment* segment = template->segments + template->segmentCount++;
+            segment->startsWord = wordStart;
+            wordStart = false;
+            open = nullptr;
             uint32 w = i;
-            bool32 important = false;
-            if(j < arg.len && (arg.chrs[j] == '!' || arg.chrs[j]=='\\')){
-                if(arg.chrs[j]=='!'){
-                    important = true;
-                }
-                w++;
-                j++;
-                if(arg.chrs[j-1]=='\\' && j < arg.len && arg.chrs[j] == '!'){
-                    important = true;
-                    j++;
+            uint32 j = i+1;
+            if(c=='$'){
+                segment->type = TEMPLATE_SEGMENT_VALUE;
+                if(j < str.len && (source[j] == '!' || source[j]=='\\')){
+                    segment->important = source[j] == '!';
                     w++;
-                }else{
-                }
-            }
-            for(; j < arg.len; j++){
-                char chr = arg.chrs[j];
-                if(!(avCharIsLetter(chr) || (j-w > 2 && avCharIsNumber(chr)) || chr=='_')){
-                    break;
-                }
-            }
-            AvString varName = {
-                .chrs = arg.chrs + w + 1,
-                .len = j - w - 1,
-                .memory = nullptr,
-            };
-            if(varName.len == 0){
-                goto invalidValue;
-            }
-            struct VariableDescription var = findVariable(varName, project);
-            
-            if(!var.value){
-                AvString msg[] = {
-                    AV_CSTRA("but was not found"),
-                    AV_CSTRA("but was invalid"),
-                };
-                uint32 msgIndex = 0;
-                if(!var.project){
-                    msgIndex = 0;
-                    goto invalidValue;
-                }
-                if(var.statement >= var.project->statementCount){
-                    msgIndex = 1;
-                    goto invalidValue;
-                }
-                struct Statement_S* statement = var.project->statements[var.statement];
-                if(statement->type != STATEMENT_TYPE_VARIABLE_ASSIGNMENT){
-                    msgIndex = 1;
-                    goto invalidValue;
-                }
-                if(!statement->variableAssignment.value){
-                    msgIndex = 1;
-                    goto invalidValue;
-                }
-                struct Value* value = avAllocatorAllocate(sizeof(struct Value), &project->allocator);
-                struct Value tmpValue = getValue(statement->variableAssignment.value, project);
-                memcpy(value, &tmpValue, sizeof(struct Value));
-                var.value = value;
-                goto validValue;
-            invalidValue:
-                    if(important){
-                        runtimeError(project,"Variable %s was marked important %s", varName, msg[msgIndex]);
-                    }
-            validValue:
-            }
-            if(!var.project || var.value==nullptr || var.value->type==VALUE_TYPE_NONE){
-                avDynamicArrayAddRange((char*)varName.chrs-1, varName.len+1, 0, 1, chars);
-                i = j-1;
-                continue;
-            }
-            struct Value value = *var.value;
-            if(value.type == VALUE_TYPE_STRING){
-                processArg(value.asString, chars, project);
-                i = j-1;
-                continue;
-            }
-            if(value.type == VALUE_TYPE_NUMBER){
-                char buffer[256] = {0};
-                avStringPrintfToBuffer(buffer, sizeof(buffer)-1, AV_CSTR("%i"), value.asNumber);
-                avDynamicArrayAddRange(buffer, avCStringLength(buffer), 0, 1, chars);
-                i = j-1;
-                continue;
-            }
-            if(value.type == VALUE_TYPE_ARRAY){
-                uint32 count = value.asArray.count;
-                struct ConstValue* values = value.asArray.values;
-                for(uint32 k = 0; k < count; k++){
-                    struct ConstValue val = values[k];
-                    bool32 isEmpty = true;
-                    if(val.type == VALUE_TYPE_STRING){
-                        if(processArg(val.asString, chars, project)){
-                            isEmpty = false;
-                        }
-                    }
-                    if(val.type == VALUE_TYPE_NUMBER){
-                        char buffer[256] = {0};
-                        avStringPrintfToBuffer(buffer, sizeof(buffer)-1, AV_CSTR("%i"), val.asNumber);
-                        avDynamicArrayAddRange(buffer, avCStringLength(buffer), 0, 1, chars);
-                        isEmpty = true;
-                    }
-                    if(k < count -1 && !isEmpty){
-                        char tmpChar = ' ';
-                        avDynamicArrayAdd(&tmpChar, chars);
+                    j++;
+                    if(source[j-1]=='\\' && j < str.len && source[j] == '!'){
+                        segment->important = true;
+                        j++;
+                        w++;
                     }
                 }
-
-                i = j-1;
+            }else if(expansion == -1){
+                segment->type = TEMPLATE_SEGMENT_EXPAND;
+                expansion = segment - template->segments;
+            }else{
+                // a word is repeated for one array, further arrays in it are written into every copy
+                segment->type = TEMPLATE_SEGMENT_VALUE;
             }
-
+            j = scanTemplateName(template->source, j, w);
+            segment->text = (AvString){ .chrs = source + w + 1, .len = j - w - 1 };
+            segment->unresolved = (AvString){ .chrs = source + w, .len = j - w };
+            i = j-1;
             continue;
         }
-        if(c=='*' && !ignoreNext){
-            uint32 j = i+1;
-            for(; j < arg.len; j++){
-                char chr = arg.chrs[j];
-                if(!(avCharIsLetter(chr) || (j-i > 2 && avCharIsNumber(chr)) || chr=='_')){
-                    break;
-                }
-            }
-            AvString varName = {
-                .chrs = arg.chrs + i + 1,
-                .len = j - i - 1,
-                .memory = nullptr,
-            };
-            struct VariableDescription var = findVariable(varName, project);
-            if(!var.project || var.value==nullptr || var.value->type==VALUE_TYPE_NONE){
-                avDynamicArrayAddRange((char*)varName.chrs-1, varName.len+1, 0, 1, chars);
-                i = j-1;
+
+        if(c=='\\'){
+            if(!ignoreNext){
+                ignoreNext = true;
                 continue;
+            }else{
+                ignoreNext = false;
             }
-            struct Value value = *var.value;
-            if(value.type == VALUE_TYPE_STRING){
-                processArg(value.asString, chars, project);
-                i = j-1;
-                continue;
-            }
-            if(value.type == VALUE_TYPE_NUMBER){
-                char buffer[256] = {0};
-                avStringPrintfToBuffer(buffer, sizeof(buffer)-1, AV_CSTR("%i"), value.asNumber);
-                avDynamicArrayAddRange(buffer, avCStringLength(buffer), 0, 1, chars);
-                i = j-1;
-                continue;
+        }else{
+            ignoreNext = false;
+        }
+        if(c==' ' && !wordStart){
+            if(expansion != -1){
+                template->segments[expansion].suffixCount = template->segmentCount - expansion - 1;
+                expansion = -1;
             }
-            if(value.type == VALUE_TYPE_ARRAY){
-                uint32 count = value.asArray.count;
-                struct ConstValue* values = value.asArray.values;
-                uint32 left = i;
-                uint32 right = j;
-                for(; left != -1; left--){
-                    char c = arg.chrs[left];
-                    if(c==' '){
-                        break;
-                    }
-                }
-                for(; right < arg.len; right++){
-                    char c = arg.chrs[right];
-                    if(c==' '){
-                        break;
-                    }
-                }
-                
-                AvString leftMost = {
-                    .chrs = arg.chrs + (left+1),
-                    .len = i - (left+1),
-                };
-                AvString rightMost = {
-                    .chrs = arg.chrs + j,
-                    .len = right - j,
-                };
-                avDynamicArraySetAllowRelocation(true, chars);
-                for(uint32 k = 0; k < leftMost.len; k++){
-                    avDynamicArrayRemove(AV_DYNAMIC_ARRAY_LAST, chars);
-                }
-                avDynamicArraySetAllowRelocation(false, chars);
-
-                for(uint32 k = 0; k < count; k++){
-                    struct ConstValue val = values[k];
-                    avDynamicArrayAddRange((char*)leftMost.chrs, leftMost.len, 0, 1, chars);
-                    bool32 isEmpty = true;
-                    if(val.type == VALUE_TYPE_STRING){
-                        if(processArg(val.asString, chars, project)){
-                            isEmpty = false;
-                        }
-                    }
-                    if(val.type == VALUE_TYPE_NUMBER){
-                        char buffer[256] = {0};
-                        avStringPrintfToBuffer(buffer, sizeof(buffer)-1, AV_CSTR("%i"), val.asNumber);
-                        avDynamicArrayAddRange(buffer, avCStringLength(buffer), 0, 1, chars);
-                        isEmpty = false;
-                    }
+            wordStart = true;
+            open = nullptr;
+        }
+        bool32 startsWord = wordStart && c!=' ';
+        if(startsWord){
+            wordStart = false;
+            open = nullptr;
+        }
+        if(open == nullptr){
+            open = template->segments + template->segmentCount++;
+            open->type = TEMPLATE_SEGMENT_LITERAL;
+            open->startsWord = startsWord;
+            open->text.chrs = literal;
+        }
+        *literal++ = c;
+        open->text.len++;
+    }
+    if(expansion != -1){
+        template->segments[expansion].suffixCount = template->segmentCount - expansion - 1;
+    }
+    return template;
+}
 
-                    avDynamicArrayAddRange((char*)rightMost.chrs, rightMost.len, 0, 1, chars);
+static struct CommandTemplate* findTemplate(AvString str){
+    uint64 key = hashString(str, HASH_SEED);
+    struct CommandTemplate** slot = commandTemplates.table + (key & (COMMAND_TEMPLATE_TABLE_SIZE - 1));
+    for(struct CommandTemplate* template = *slot; template; template = template->next){
+        if(template->key == key && avStringEquals(template->source, str)){
+            return template;
+        }
+    }
+    struct CommandTemplate* template = compileTemplate(str, key);
+    template->next = *slot;
+    *slot = template;
+    commandTemplates.count++;
+    return template;
+}
 
-                    if(k < count -1 && !isEmpty){
-                        char tmpChar = ' ';
-                        avDynamicArrayAdd(&tmpChar, chars);
-                    }
-                }   
+void commandTemplatesClear(){
+    for(uint32 i = 0; i < COMMAND_TEMPLATE_TABLE_SIZE; i++){
+        struct CommandTemplate* template = commandTemplates.table[i];
+        while(template){
+            struct CommandTemplate* next = template->next;
+            avFree(template);
+            template = next;
+        }
+        commandTemplates.table[i] = nullptr;
+    }
+    commandTemplates.count = 0;
+}
 
-                i = j-1;
-            }
+// finds the value of a referenced variable, evaluating globals that were never assigned
+static bool32 resolveTemplateVariable(const struct TemplateSegment* segment, struct Value* value, Project* project){
+    static const AvString msg[] = {
+        AV_CSTRA("but was not found"),
+        AV_CSTRA("but was invalid"),
+    };
+    uint32 msgIndex = 0;
+    if(segment->text.len == 0){
+        goto invalidValue;
+    }
+    struct VariableDescription var = findVariable(segment->text, project);
+    jobPoolWaitForValue(var.value);
+    if(var.value){
+        *value = *var.value;
+        return value->type != VALUE_TYPE_NONE;
+    }
+    if(!var.project || segment->type == TEMPLATE_SEGMENT_EXPAND){
+        goto invalidValue;
+    }
+    msgIndex = 1;
+    if(var.statement >= var.project->statementCount){
+        goto invalidValue;
+    }
+    struct Statement_S* statement = var.project->statements[var.statement];
+    if(statement->type != STATEMENT_TYPE_VARIABLE_ASSIGNMENT || !statement->variableAssignment.value){
+        goto invalidValue;
+    }
+    *value = evaluateLazyVariable(var, statement, project);
+    return value->type != VALUE_TYPE_NONE;
+
+invalidValue:
+    if(segment->important){
+        runtimeError(project,"Variable %s was marked important %s", segment->text, msg[msgIndex]);
+    }
+    return false;
+}
+
+static void expandString(AvString str, struct TemplateOutput* output, Project* project);
+
+static void expandNumber(uint32 number, struct TemplateOutput* output){
+    char buffer[256] = {0};
+    avStringPrintfToBuffer(buffer, sizeof(buffer)-1, AV_CSTR("%i"), number);
+    appendTemplateOutput(output, buffer, avCStringLength(buffer));
+}
+
+static void expandSegments(const struct TemplateSegment* segments, uint32 segmentCount, struct TemplateOutput* output, Project* project){
+    // where the word being written starts in the output, an expansion repeats everything written since
+    uint64 wordOutput = output->size;
+    for(uint32 s = 0; s < segmentCount; s++){
+        const struct TemplateSegment* segment = segments + s;
+        if(segment->startsWord){
+            wordOutput = output->size;
+        }
+        if(segment->type == TEMPLATE_SEGMENT_LITERAL){
+            appendTemplateOutput(output, segment->text.chrs, segment->text.len);
             continue;
         }
-        
-        if(c=='\\'){
-            if(!ignoreNext){
-                ignoreNext = true;
-                continue;
-            }else{
-                ignoreNext = false;
+        struct Value value;
+        if(!resolveTemplateVariable(segment, &value, project)){
+            appendTemplateOutput(output, segment->unresolved.chrs, segment->unresolved.len);
+            continue;
+        }
+        if(value.type == VALUE_TYPE_STRING){
+            expandString(value.asString, output, project);
+            continue;
+        }
+        if(value.type == VALUE_TYPE_NUMBER){
+            expandNumber(value.asNumber, output);
+            continue;
+        }
+        if(value.type != VALUE_TYPE_ARRAY){
+            continue;
+        }
+        uint32 count = value.asArray.count;
+        struct ConstValue* values = value.asArray.values;
+        if(segment->type == TEMPLATE_SEGMENT_VALUE){
+            for(uint32 k = 0; k < count; k++){
+                uint64 start = output->size;
+                if(values[k].type == VALUE_TYPE_STRING){
+                    expandString(values[k].asString, output, project);
+                }
+                bool32 isEmpty = output->size == start;
+                if(values[k].type == VALUE_TYPE_NUMBER){
+                    expandNumber(values[k].asNumber, output);
+                }
+                if(k < count -1 && !isEmpty){
+                    appendTemplateOutput(output, " ", 1);
+                }
             }
-        }else{
-            ignoreNext = false;
+            continue;
         }
 
-        avDynamicArrayAdd(&c, chars);
+        // the word was already expanded up to the reference, the rest of it is expanded once. Every element
+        // gets its own copy of both
+        struct TemplateOutput suffix = {0};
+        expandSegments(segment + 1, segment->suffixCount, &suffix, project);
+        s += segment->suffixCount;
+        uint64 prefixLength = output->size - wordOutput;
+        char* prefix = nullptr;
+        if(prefixLength){
+            prefix = avAllocate(prefixLength, "command");
+            memcpy(prefix, output->data + wordOutput, prefixLength);
+        }
+        output->size = wordOutput;
+        reserveTemplateOutput(output, (uint64)count * (prefixLength + suffix.size + 2));
+        for(uint32 k = 0; k < count; k++){
+            appendTemplateOutput(output, prefix, prefixLength);
+            uint64 start = output->size;
+            if(values[k].type == VALUE_TYPE_STRING){
+                expandString(values[k].asString, output, project);
+            }
+            if(values[k].type == VALUE_TYPE_NUMBER){
+                expandNumber(values[k].asNumber, output);
+            }
+            bool32 isEmpty = output->size == start;
+            appendTemplateOutput(output, suffix.data, suffix.size);
+            if(k < count -1 && !isEmpty){
+                appendTemplateOutput(output, " ", 1);
+            }
+        }
+        if(prefix){
+            avFree(prefix);
+        }
+        if(suffix.data){
+            avFree(suffix.data);
+        }
     }
-    
-    return avDynamicArrayGetSize(chars)-start;
 }
 
-void parseCommandString(AvString str, struct CommandDescription** dst, Project* project){
-    AvDynamicArray finalArg = AV_EMPTY;
-    avDynamicArrayCreate(0, sizeof(char), &finalArg);
+static void expandTemplate(const struct CommandTemplate* template, struct TemplateOutput* output, Project* project){
+    expandSegments(template->segments, template->segmentCount, output, project);
+}
 
-    processArg(str, finalArg, project);
+// strings without references or escapes, like most values, are copied as they are
+static void expandString(AvString str, struct TemplateOutput* output, Project* project){
+    for(uint32 i = 0; i < str.len; i++){
+        char c = str.chrs[i];
+        if(c=='$' || c=='*' || c=='\\'){
+            expandTemplate(findTemplate(str), output, project);
+            return;
+        }
+    }
+    appendTemplateOutput(output, str.chrs, str.len);
+}
 
-    uint32 count = avDynamicArrayGetSize(finalArg);
-    char* buffer = avCallocate(count+1, 1, "");
-    avDynamicArrayReadRange(buffer, count, 0, 1, 0, finalArg);
+// expands the variables referenced by a string, the result is null terminated
+char* expandCommandString(AvString str, uint64* size, Project* project){
+    // templates are only dropped between expansions, an expansion refers to the templates it is in
+    if(commandTemplates.count >= COMMAND_TEMPLATE_MAX_COUNT){
+        commandTemplatesClear();
+    }
+    struct TemplateOutput output = {0};
+    expandString(str, &output, project);
+    reserveTemplateOutput(&output, 1);
+    output.data[output.size] = '\0';
+    *size = output.size;
+    return output.data;
+}
 
+void parseCommandString(AvString str, struct CommandDescription** dst, Project* project){
+    uint64 count = 0;
+    char* buffer = expandCommandString(str, &count, project);
+
+    uint32 argCount = 0;
+    for(uint64 i = 0; i < count; i++){
+        if(!avCharIsWhiteSpace(buffer[i]) && (i == 0 || avCharIsWhiteSpace(buffer[i-1]))){
+            argCount++;
+        }
+    }
     AvDynamicArray args = AV_EMPTY;
-    avDynamicArrayCreate(0, sizeof(struct AvString), &args);
+    avDynamicArrayCreate(argCount, sizeof(struct AvString), &args);
 
-    uint32 start = -1;
-    for(uint32 i = 0; i < count; i++){
-        char c = buffer[i];
+    uint64 start = -1;
+    for(uint64 i = 0; i <= count; i++){
+        bool32 separator = i == count || avCharIsWhiteSpace(buffer[i]);
         if(start == -1){
-            if(avCharIsWhiteSpace(c)){
-                continue;
+            if(!separator){
+                start = i;
             }
-            start = i;
             continue;
         }
-        if(avCharIsWhiteSpace(c)){
+        if(separator){
             AvString arg = {
                 .chrs = buffer + start,
                 .len = i - start,
@@ -1337,24 +1708,46 @@ void parseCommandString(AvString str, struct CommandDescription** dst, Project*
             start = -1;
         }
     }
-    if(start != -1){
-        AvString arg ={
-            .chrs = buffer + start,
-            .len = count - start,
-            .memory = nullptr,
-        };
-        avDynamicArrayAdd(&arg, args);
-    }
 
     *dst = avAllocate(sizeof(struct CommandDescription), "commandDescription");
     (*dst)->args = args;
     (*dst)->command = buffer;
-
-    avDynamicArrayDestroy(finalArg);
 }
 
 void assignVariableIndexed(struct AvString identifier, uint32 index, struct Value value, Project* project);
 
+// the keys describing a command belong to its block, they never reach a variable of the enclosing scopes
+static bool32 isCommandKey(AvString identifier){
+    return avStringEquals(identifier, AV_CSTR("command")) || avStringEquals(identifier, AV_CSTR("inputs"))
+        || avStringEquals(identifier, AV_CSTR("outputs")) || avStringEquals(identifier, AV_CSTR("depfile"));
+}
+
+static struct VariableDescription findCommandKey(const char* key, Project* project){
+    struct VariableDescription* variable = findFrameVariable(AV_CSTR(key), project);
+    return variable ? *variable : (struct VariableDescription){0};
+}
+
+static void runCommandVariableAssignment(struct VariableAssignment_S statement, Project* project){
+    if(statement.modifier == VARIABLE_ACCESS_MODIFIER_ARRAY || !isCommandKey(statement.variableName)){
+        runVariableAssignment(statement, -1, project);
+        return;
+    }
+    struct Value* value = projectAllocate(project, sizeof(struct Value));
+    *value = getValue(statement.value, project);
+    struct VariableDescription description = {
+        .identifier = statement.variableName,
+        .project = project,
+        .statement = -1,
+        .value = value,
+    };
+    struct VariableDescription* variable = findFrameVariable(statement.variableName, project);
+    if(variable){
+        *variable = description;
+        return;
+    }
+    addLocalVariable(description, project);
+}
+
 void runIfCommandStatement(struct IfCommandStatement_S statement, Project* project){
     struct Value value = getValue(statement.check, project);
     bool32 pass = false;
@@ -1380,7 +1773,7 @@ void runIfCommandStatement(struct IfCommandStatement_S statement, Project* proje
                     callFunction(stat.functionCall, project);
                     break;
                 case COMMAND_STATEMENT_VARIABLE_ASSIGNMENT:
-                    runVariableAssignment(stat.variableAssignment, -1, project);
+                    runCommandVariableAssignment(stat.variableAssignment, project);
                     break;
                 case COMMAND_STATEMENT_IF_STATEMENT:
                     runIfCommandStatement(stat.ifStatement, project);
@@ -1399,7 +1792,7 @@ void runIfCommandStatement(struct IfCommandStatement_S statement, Project* proje
                         callFunction(stat.functionCall, project);
                         break;
                     case COMMAND_STATEMENT_VARIABLE_ASSIGNMENT:
-                        runVariableAssignment(stat.variableAssignment, -1, project);
+                        runCommandVariableAssignment(stat.variableAssignment, project);
                         break;
                     case COMMAND_STATEMENT_IF_STATEMENT:
                         runIfCommandStatement(stat.ifStatement, project);
@@ -1415,6 +1808,343 @@ void runIfCommandStatement(struct IfCommandStatement_S statement, Project* proje
     }
 }
 
+struct FileSetInfo {
+    uint32 count;
+    bool32 complete; // all files exist
+    uint64 hash;
+};
+
+static void inspectFile(AvString path, bool32 hashStatus, struct FileSetInfo* info){
+    uint64 time = 0;
+    uint64 size = 0;
+    bool32 exists = false;
+    if(hashStatus){
+        watchFile(path);
+        exists = hashFile(path, &info->hash, &time);
+    }else{
+        info->hash = hashString(path, info->hash);
+        exists = fileStatus(path, &time, &size);
+    }
+    if(!exists){
+        info->complete = false;
+        return;
+    }
+    info->count++;
+}
+
+// gathers the state of the files in value, returns false if value is not a path or list of paths
+static bool32 inspectFiles(struct Value value, const char* key, bool32 hashStatus, struct FileSetInfo* info, Project* project){
+    uint32 count = 1;
+    if(value.type == VALUE_TYPE_ARRAY){
+        count = value.asArray.count;
+    }else if(value.type != VALUE_TYPE_STRING){
+        runtimeError(project, "%s of command is neither a file name nor an array of them", AV_CSTR(key));
+        return false;
+    }
+    for(uint32 i = 0; i < count; i++){
+        AvString path = value.asString;
+        if(value.type == VALUE_TYPE_ARRAY){
+            if(value.asArray.values[i].type != VALUE_TYPE_STRING){
+                runtimeError(project, "%s of command contains a value that is not a file name", AV_CSTR(key));
+                return false;
+            }
+            path = value.asArray.values[i].asString;
+        }
+        inspectFile(path, hashStatus, info);
+    }
+    return true;
+}
+
+// the command might finish after the working directory changed, so paths are stored absolute
+static char* absolutePath(AvString path, const char* workingDir, Project* project){
+    bool32 relative = path.len == 0 || path.chrs[0] != '/';
+    uint64 prefixLength = relative ? strlen(workingDir) + 1 : 0;
+    char* result = projectAllocate(project, prefixLength + path.len + 1);
+    if(relative){
+        memcpy(result, workingDir, prefixLength - 1);
+        result[prefixLength - 1] = '/';
+    }
+    memcpy(result + prefixLength, path.chrs, path.len);
+    result[prefixLength + path.len] = '\0';
+    return result;
+}
+
+// hash of the outputs, the command and the content of the inputs, 0 when an input can not be read
+static uint64 computeActionKey(struct BuildRecord record, struct Value* inputs, const char* dependencies, uint32 dependencyCount){
+    uint64 key = hashBytes(&record.commandHash, sizeof(uint64), record.key);
+    uint32 inputCount = 0;
+    if(inputs){
+        inputCount = inputs->type == VALUE_TYPE_ARRAY ? inputs->asArray.count : 1;
+    }
+    for(uint32 i = 0; i < inputCount; i++){
+        AvString path = inputs->type == VALUE_TYPE_ARRAY ? inputs->asArray.values[i].asString : inputs->asString;
+        key = hashString(path, key);
+        if(!hashFileContent(path, &key)){
+            return 0;
+        }
+    }
+    for(uint32 i = 0; i < dependencyCount; i++){
+        AvString path = AV_CSTR(dependencies);
+        key = hashString(path, key);
+        if(!hashFileContent(path, &key)){
+            return 0;
+        }
+        dependencies += path.len + 1;
+    }
+    return key ? key : 1;
+}
+
+// returns true if the command declares outputs, upToDate is set when it does not need to run
+static bool32 checkCommandBuild(const char* commandString, Project* project, struct CommandBuild* build, bool32* upToDate){
+    *upToDate = false;
+    struct VariableDescription outputsVar = findCommandKey("outputs", project);
+    if(outputsVar.value == nullptr){
+        return false;
+    }
+    struct VariableDescription inputsVar = findCommandKey("inputs", project);
+    struct VariableDescription depfileVar = findCommandKey("depfile", project);
+    if(depfileVar.value && depfileVar.value->type != VALUE_TYPE_STRING){
+        runtimeError(project, "depfile value is not string");
+        return false;
+    }
+
+    // inputs might still be produced by running commands, within a loop only the earlier commands of the
+    // same iteration are ordered before this one
+    if(jobPoolInLoop()){
+        jobPoolWaitForIteration();
+    }else{
+        jobPoolWaitAll();
+    }
+
+    char workingDir[PATH_MAX] = {0};
+    if(getcwd(workingDir, sizeof(workingDir)) == nullptr){
+        return false;
+    }
+
+    struct FileSetInfo inputs = { .complete = true, .hash = HASH_SEED };
+    if(inputsVar.value && !inspectFiles(*inputsVar.value, "inputs", true, &inputs, project)){
+        return false;
+    }
+    struct FileSetInfo outputs = { .complete = true, .hash = hashString(AV_CSTR(workingDir), HASH_SEED) };
+    if(!inspectFiles(*outputsVar.value, "outputs", false, &outputs, project)){
+        return false;
+    }
+
+    memset(build, 0, sizeof(struct CommandBuild));
+    build->record.key = outputs.hash;
+    build->record.commandHash = hashBytes(commandString, strlen(commandString), HASH_SEED);
+    build->record.inputHash = inputs.hash;
+
+    struct Value outputsValue = *outputsVar.value;
+    build->outputCount = outputsValue.type == VALUE_TYPE_ARRAY ? outputsValue.asArray.count : 1;
+    build->outputs = projectAllocate(project, sizeof(char*) * (build->outputCount + 1));
+    for(uint32 i = 0; i < build->outputCount; i++){
+        AvString path = outputsValue.type == VALUE_TYPE_ARRAY ? outputsValue.asArray.values[i].asString : outputsValue.asString;
+        build->outputs[i] = absolutePath(path, workingDir, project);
+    }
+
+    bool32 dependenciesKnown = true;
+    const char* dependencies = nullptr;
+    uint32 dependencyCount = 0;
+    if(depfileVar.value){
+        build->depfile = absolutePath(depfileVar.value->asString, workingDir, project);
+
+        // headers discovered by the previous run count as inputs
+        dependenciesKnown = buildDatabaseFindDependencies(build->record.key, &dependencies, &dependencyCount);
+        const char* path = dependencies;
+        for(uint32 i = 0; dependenciesKnown && i < dependencyCount; i++){
+            AvString dependency = AV_CSTR(path);
+            inspectFile(dependency, true, &inputs);
+            path += dependency.len + 1;
+        }
+    }
+
+    if(outputs.count != 0 && outputs.complete && inputs.complete){
+        // without a record nothing says which command wrote the outputs, so it runs once and is recorded then
+        struct BuildRecord previous = {0};
+        if(buildDatabaseFind(build->record.key, &previous)){
+            *upToDate = dependenciesKnown && previous.commandHash == build->record.commandHash && previous.inputHash == inputs.hash;
+        }
+    }
+
+    if(!*upToDate && dependenciesKnown && inputs.complete && actionCacheEnabled()){
+        build->actionKey = computeActionKey(build->record, inputsVar.value, dependencies, dependencyCount);
+    }
+    return true;
+}
+
+// evaluates the file a stream of the command is redirected to, the file is only opened once the command runs
+static bool32 redirectionPath(struct Expression_S* expression, const char* stream, AvString* path, Project* project){
+    if(expression == nullptr){
+        return true;
+    }
+    struct Value value = getValue(expression, project);
+    if(value.type != VALUE_TYPE_STRING || value.asString.len == 0){
+        runtimeError(project, "%s of command can only be redirected to a file name", AV_CSTR(stream));
+        return false;
+    }
+    *path = value.asString;
+    return true;
+}
+
+static int32 openRedirection(AvString path, Project* project){
+    char fileName[path.len + 1];
+    memcpy(fileName, path.chrs, path.len);
+    fileName[path.len] = '\0';
+#ifndef _WIN32
+    // the command fails like one that could not be started, the script sees its return code
+    int32 fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd == -1){
+        avStringPrintf(AV_CSTR("unable to open %s for the output of the command\n"), path);
+    }
+    return fd;
+#else
+    runtimeError(project, "redirecting the output of a command is not supported on this platform");
+    return -1;
+#endif
+}
+
+// the commands hold their own copies of the descriptors
+static void closeRedirections(struct CommandRedirection redirection){
+    if(redirection.output != -1){
+        close(redirection.output);
+    }
+    if(redirection.error != -1 && redirection.error != redirection.output){
+        close(redirection.error);
+    }
+}
+
+static bool32 openRedirections(AvString outputPath, AvString errorPath, struct CommandRedirection* redirection, Project* project){
+    redirection->output = -1;
+    redirection->error = -1;
+    if(outputPath.len){
+        redirection->output = openRedirection(outputPath, project);
+        if(redirection->output == -1){
+            return false;
+        }
+    }
+    if(errorPath.len){
+        // both streams going to the same file share one descriptor, so neither truncates the other
+        if(outputPath.len && avStringEquals(outputPath, errorPath)){
+            redirection->error = redirection->output;
+        }else{
+            redirection->error = openRedirection(errorPath, project);
+            if(redirection->error == -1){
+                closeRedirections(*redirection);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool32 dispatchCommand(struct CommandStatementBody_S command, uint32 argCount, AvString* args, const char* commandString, struct CommandRedirection redirection, char* responseFile, const struct CommandBuild* build, Project* project){
+    struct Value* target = nullptr;
+    bool32 indexed = false;
+    uint32 index = 0;
+    if(command.retCodeVariable.len){
+        struct VariableDescription var = findVariable(command.retCodeVariable, project);
+        if(!var.project){
+            if(command.retCodeIndex){
+                runtimeError(project, "unable to index unknown variable %s", command.retCodeVariable);
+                return false;
+            }
+            target = projectAllocate(project, sizeof(struct Value));
+            target->type = VALUE_TYPE_NUMBER;
+            target->asNumber = 0;
+            addVariableToContext((struct VariableDescription){
+                .identifier = command.retCodeVariable,
+                .project = project,
+                .statement = -1,
+                .value = target,
+            }, project);
+        }else if(command.retCodeIndex){
+            struct Value indexValue = getValue(command.retCodeIndex, project);
+            if(indexValue.type != VALUE_TYPE_NUMBER){
+                runtimeError(project, "can only index with number");
+                return false;
+            }
+            if(var.value == nullptr){
+                return false;
+            }
+            target = var.value;
+            unshareArray(target, project);
+            indexed = target->type == VALUE_TYPE_ARRAY;
+            index = indexValue.asNumber;
+            if(indexed && index >= target->asArray.count){
+                runtimeError(project, "accessing array index( %i ) out of bounds ( %i )", target->asArray.count, index);
+                return false;
+            }
+        }else{
+            assignVariable((struct VariableDescription){
+                .identifier = command.retCodeVariable,
+                .project = project,
+                .statement = -1,
+            }, (struct Value){.type=VALUE_TYPE_NUMBER, .asNumber=0}, project);
+            target = findVariable(command.retCodeVariable, project).value;
+        }
+    }
+    return jobPoolDispatch(argCount, args, commandString, redirection, responseFile, target, indexed, index, project->options.commandDebug, build);
+}
+
+static void assignCommandRetCode(struct CommandStatementBody_S command, int32 retCode, Project* project){
+    if(command.retCodeVariable.len){
+        struct VariableDescription var = findVariable(command.retCodeVariable, project);
+        if(!var.project){
+            if(command.retCodeIndex){
+                runtimeError(project, "unable to index unknown variable %s", command.retCodeVariable);
+                return;
+            }
+
+            struct Value* retValue = projectAllocate(project, sizeof(struct Value));
+            retValue->type= VALUE_TYPE_NUMBER;
+            retValue->asNumber = retCode;
+            addVariableToContext((struct VariableDescription){
+                .identifier= command.retCodeVariable, 
+                .project= project, 
+                .statement=-1,
+                .value = retValue,
+            }, project);
+        }else{
+            if(command.retCodeIndex){
+                struct Value index = getValue(command.retCodeIndex, project);
+                if(index.type != VALUE_TYPE_NUMBER){
+                    runtimeError(project, "can only index with number");
+                }
+                assignVariableIndexed(command.retCodeVariable,index.asNumber, (struct Value){.type=VALUE_TYPE_NUMBER, .asNumber=retCode}, project);
+            }else{
+                assignVariable((struct VariableDescription){
+                    .identifier = command.retCodeVariable,
+                    .project = project,
+                    .statement = -1,
+                }, (struct Value){.type=VALUE_TYPE_NUMBER, .asNumber=retCode}, project);
+            }
+        }
+
+    }
+}
+
+// drops the cached enumerations a command about to run might change. Only the declared outputs are known to be
+// written, any other command may write anywhere
+static void invalidateCommandWrites(const struct CommandBuild* build, AvString outputPath, AvString errorPath){
+    if(build == nullptr || build->outputCount == 0){
+        invalidateFileSystemReaders();
+        return;
+    }
+    for(uint32 i = 0; i < build->outputCount; i++){
+        invalidatePathReaders(AV_CSTR(build->outputs[i]));
+    }
+    if(build->depfile){
+        invalidatePathReaders(AV_CSTR(build->depfile));
+    }
+    if(outputPath.len){
+        invalidatePathReaders(outputPath);
+    }
+    if(errorPath.len){
+        invalidatePathReaders(errorPath);
+    }
+}
+
 void performCommand(struct CommandStatementBody_S command, Project* project){
     startLocalContext(project, true);
 
@@ -1425,7 +2155,7 @@ void performCommand(struct CommandStatementBody_S command, Project* project){
                 callFunction(statement.functionCall, project);
                 break;
             case COMMAND_STATEMENT_VARIABLE_ASSIGNMENT:
-                runVariableAssignment(statement.variableAssignment, -1, project);
+                runCommandVariableAssignment(statement.variableAssignment, project);
                 break;
             case COMMAND_STATEMENT_IF_STATEMENT:
                 runIfCommandStatement(statement.ifStatement, project);
@@ -1436,64 +2166,135 @@ void performCommand(struct CommandStatementBody_S command, Project* project){
         }
     }
 
-    struct VariableDescription commandVar = findVariable(AV_CSTR("command"), project);
+    struct VariableDescription commandVar = findCommandKey("command", project);
     if(commandVar.value==nullptr || commandVar.value->type != VALUE_TYPE_STRING){
         runtimeError(project, "command value is not string");
         endLocalContext(project);
         return;
     }
     
+    AvString outputPath = AV_EMPTY_STRING;
+    AvString errorPath = AV_EMPTY_STRING;
+    if(command.outputVariable.len && command.pipeFile){
+        runtimeError(project, "output of command cannot be captured and redirected to a file at once");
+        endLocalContext(project);
+        return;
+    }
+    if(!redirectionPath(command.pipeFile, "output", &outputPath, project) || !redirectionPath(command.errorFile, "error output", &errorPath, project)){
+        endLocalContext(project);
+        return;
+    }
+
     AvString commandUnformated = commandVar.value->asString;
     struct CommandDescription* commandDescription = nullptr;
     parseCommandString(commandUnformated, &commandDescription, project);
 
+    // commands capturing their output always run, the output is not cached
+    struct CommandBuild build = {0};
+    bool32 upToDate = false;
+    bool32 recordBuild = !command.outputVariable.len && checkCommandBuild(commandDescription->command, project, &build, &upToDate);
+
     endLocalContext(project);
 
+    if(upToDate){
+        if(project->options.commandDebug){
+            avStringPrintf(AV_CSTR("up to date: %s\n"), AV_CSTR(commandDescription->command));
+        }
+        avFree(commandDescription->command);
+        avDynamicArrayDestroy(commandDescription->args);
+        avFree(commandDescription);
+        assignCommandRetCode(command, 0, project);
+        return;
+    }
+
+    invalidateCommandWrites(recordBuild ? &build : nullptr, outputPath, errorPath);
+
+    if(recordBuild){
+        uint64 traceStarted = traceStart();
+        bool32 restored = actionCacheRestore(&build);
+        traceSpan("cache", AV_CSTR("action cache"), AV_CSTR(commandDescription->command), traceStarted);
+        if(restored){
+            if(project->options.commandDebug){
+                avStringPrintf(AV_CSTR("restored from cache: %s\n"), AV_CSTR(commandDescription->command));
+            }
+            avFree(commandDescription->command);
+            avDynamicArrayDestroy(commandDescription->args);
+            avFree(commandDescription);
+            commitCommandBuild(&build);
+            assignCommandRetCode(command, 0, project);
+            return;
+        }
+        actionCacheDetachOutputs(&build);
+    }
+
+    struct CommandRedirection redirection;
+    if(!openRedirections(outputPath, errorPath, &redirection, project)){
+        avFree(commandDescription->command);
+        avDynamicArrayDestroy(commandDescription->args);
+        avFree(commandDescription);
+        assignCommandRetCode(command, -1, project);
+        return;
+    }
 
     uint32 argCount = avDynamicArrayGetSize(commandDescription->args);
     avDynamicArrayMakeContiguous(commandDescription->args);
     AvString* strings = avDynamicArrayGetPageDataPtr(0, commandDescription->args);
 
-    AvProcessStartInfo info = AV_EMPTY;
-	avProcessStartInfoPopulateARR(&info, strings[0], (AvString)AV_EMPTY, argCount-1, strings+1);
+    // tools that accept one read overly long command lines from a file, so they stay below the limit of the system
+    AvString responseArgs[2];
+    char* responseFile = responseFileWrite(argCount, strings, project->options.responseFileSize * 1024);
+    if(responseFile){
+        responseArgs[0] = strings[0];
+        responseArgs[1] = AV_CSTR(responseFile);
+        strings = responseArgs;
+        argCount = 2;
+    }
+
+    if(jobPoolIsParallel()){
+        if(jobPoolInLoop() && !command.outputVariable.len && argCount){
+            if(dispatchCommand(command, argCount, strings, commandDescription->command, redirection, responseFile, recordBuild ? &build : nullptr, project)){
+                closeRedirections(redirection);
+                avFree(commandDescription->command);
+                avDynamicArrayDestroy(commandDescription->args);
+                avFree(commandDescription);
+                return;
+            }
+        }
+        // commands outside of loops depend on everything issued before them
+        jobPoolWaitAll();
+    }
 
-    AvPipe pipe = AV_EMPTY;
+    int32 retCode = 0;
+    struct CommandOutput output = {0};
+    uint64 traceStarted = traceStart();
     if(command.outputVariable.len){
-        avPipeCreate(&pipe);
-        info.output = &pipe.write;
+        retCode = runCapturedCommand(argCount, strings, redirection.error, project->options.teeOutput, &output);
+    }else if(redirection.output != -1 || redirection.error != -1){
+        retCode = runRedirectedCommand(argCount, strings, redirection);
+    }else{
+        AvProcessStartInfo info = AV_EMPTY;
+        avProcessStartInfoPopulateARR(&info, strings[0], (AvString)AV_EMPTY, argCount-1, strings+1);
+        retCode = avProcessRun(info);
+        avProcessStartInfoDestroy(&info);
     }
-
-    //AvProcess process = AV_EMPTY;
-	int32 retCode = avProcessRun(info);
-    avPipeConsumeWriteChannel(&pipe);
-
-
-    avProcessStartInfoDestroy(&info);
+    closeRedirections(redirection);
+    responseFileRemove(responseFile);
+    traceCommand(commandDescription->command, retCode, traceStarted, -1);
 
     if(command.outputVariable.len){
-        char buffer[4096] = {0};
-        AvDynamicArray data = AV_EMPTY;
-        avDynamicArrayCreate(0, 1, &data);
-        while(true){
-            int readBytes = read(pipe.read, buffer,  sizeof(buffer));
-            if(readBytes == -1){
-                runtimeError(project, "error reading from pipe");
-                return;
-            }
-            if(readBytes == 0){
-                break;
-            }
-            avDynamicArrayAddRange(buffer, readBytes, 0, 1, data);
-        }
-        avDynamicArrayMakeContiguous(data);
-        uint32 dataSize = avDynamicArrayGetSize(data);
-        char* strData = avAllocatorAllocate(dataSize+1, &project->allocator);
-        avDynamicArrayReadRange(strData, dataSize, 0, 1, 0, data);
-        avDynamicArrayDestroy(data);
+        // the lines point into the one copy kept by the project
+        char* strData = projectAllocate(project, output.size+1);
+        memcpy(strData, output.data, output.size);
+        strData[output.size] = '\0';
 
         if(command.outputVariableIndex){
             struct Value indexValue = getValue(command.outputVariableIndex, project);
             if(indexValue.type != VALUE_TYPE_NUMBER){
+                // runtime errors do not return
+                commandOutputDestroy(&output);
+                avFree(commandDescription->command);
+                avDynamicArrayDestroy(commandDescription->args);
+                avFree(commandDescription);
                 runtimeError(project, "cannot index with non number");
                 return;
             }
@@ -1502,62 +2303,38 @@ void performCommand(struct CommandStatementBody_S command, Project* project){
                 .type = VALUE_TYPE_STRING,
                 .asString = {
                     .chrs = strData,
-                    .len = dataSize,
+                    .len = output.size,
                     .memory = nullptr,
                 },
             };
             assignVariableIndexed(command.outputVariable, index, value, project);
         }else{
             struct VariableDescription var = findVariable(command.outputVariable, project);
-            AvDynamicArray strs = AV_EMPTY;
-            avDynamicArrayCreate(0, sizeof(AvString), &strs);
-            uint32 start =  0;
-            uint32 end = 0;
-            for(; end < dataSize; end++){
-                char c = strData[end];
-                if(c=='\n'){
-                    AvString str = {
-                        .chrs = strData+start,
-                        .len = end - start,
-                        .memory = nullptr,
-                    };
-                    start = end+1;
-                    if(str.len != 0){
-                        avDynamicArrayAdd(&str, strs);
-                    }
-                }
-            }
-            if(start != dataSize){
-                AvString str = {
-                    .chrs = strData+start,
-                    .len = end - start,
-                    .memory = nullptr,
-                };
-                start = end+1;
-                avDynamicArrayAdd(&str, strs);
-            }
-
             struct ConstValue* values = nullptr;
-            if(avDynamicArrayGetSize(strs)){
-                values = avAllocatorAllocate(sizeof(struct ConstValue) * avDynamicArrayGetSize(strs), &project->allocator);
+            if(output.lineCount){
+                values = projectAllocate(project, sizeof(struct ConstValue) * output.lineCount);
             }
-            for(uint32 i = 0; i < avDynamicArrayGetSize(strs); i++){
+            for(uint32 i = 0; i < output.lineCount; i++){
                 values[i].type = VALUE_TYPE_STRING;
+                values[i].asString = (AvString){
+                    .chrs = strData + output.lines[i].start,
+                    .len = output.lines[i].length,
+                    .memory = nullptr,
+                };
             }
-            avDynamicArrayReadRange(values, avDynamicArrayGetSize(strs), offsetof(struct ConstValue, asString), sizeof(struct ConstValue), 0, strs);
             if(var.project){
                 assignVariable(var, (struct Value){
                     .type = VALUE_TYPE_ARRAY,
                     .asArray = {
-                        .count = avDynamicArrayGetSize(strs),
+                        .count = output.lineCount,
                         .values = values,
                     },
                 } ,project);
             }else{
-                struct Value* value = avAllocatorAllocate(sizeof(struct Value), &project->allocator);
+                struct Value* value = projectAllocate(project, sizeof(struct Value));
                 value->type = VALUE_TYPE_ARRAY,
                 value->asArray = (struct ArrayValue){
-                    .count = avDynamicArrayGetSize(strs),
+                    .count = output.lineCount,
                     .values = values,
                 };
                 addVariableToContext((struct VariableDescription){
@@ -1567,12 +2344,15 @@ void performCommand(struct CommandStatementBody_S command, Project* project){
                     .value = value,
                 }, project);
             }
-            avDynamicArrayDestroy(strs);
         }
 
-        avPipeDestroy(&pipe);
+        commandOutputDestroy(&output);
     }
     
+    if(recordBuild && retCode == 0){
+        commitCommandBuild(&build);
+    }
+
     if(project->options.commandDebug){
 #ifndef _WIN32
         avStringPrintf(AV_CSTR("%i = %s\n"), retCode, AV_CSTR(commandDescription->command));
@@ -1585,41 +2365,7 @@ void performCommand(struct CommandStatementBody_S command, Project* project){
     avDynamicArrayDestroy(commandDescription->args);
     avFree(commandDescription);
 
-    if(command.retCodeVariable.len){
-        struct VariableDescription var = findVariable(command.retCodeVariable, project);
-        if(!var.project){
-            if(command.retCodeIndex){
-                runtimeError(project, "unable to index unknown variable %s", command.retCodeVariable);
-                return;
-            }
-
-            struct Value* retValue = avAllocatorAllocate(sizeof(struct Value), &project->allocator);
-            retValue->type= VALUE_TYPE_NUMBER;
-            retValue->asNumber = retCode;
-            addVariableToContext((struct VariableDescription){
-                .identifier= command.retCodeVariable, 
-                .project= project, 
-                .statement=-1,
-                .value = retValue,
-            }, project);
-        }else{
-            if(command.retCodeIndex){
-                struct Value index = getValue(command.retCodeIndex, project);
-                if(index.type != VALUE_TYPE_NUMBER){
-                    runtimeError(project, "can only index with number");
-                }
-                assignVariableIndexed(command.retCodeVariable,index.asNumber, (struct Value){.type=VALUE_TYPE_NUMBER, .asNumber=retCode}, project);
-            }else{
-                assignVariable((struct VariableDescription){
-                    .identifier = command.retCodeVariable,
-                    .project = project,
-                    .statement = -1,
-                }, (struct Value){.type=VALUE_TYPE_NUMBER, .asNumber=retCode}, project);
-            }
-        }
-
-    }
-
+    assignCommandRetCode(command, retCode, project);
 }
 
 void addVariableToContext(struct VariableDescription description, Project* project);
@@ -1651,7 +2397,7 @@ void performVariableDefinition(struct VariableDefinition_S variable, Project* pr
         return;
     }
 
-    struct Value* value = avAllocatorAllocate(sizeof(struct Value), &project->allocator);
+    struct Value* value = projectAllocate(project, sizeof(struct Value));
     value->type = VALUE_TYPE_NUMBER,
     value->asNumber = 0;
     if(size.asNumber==1){
@@ -1667,7 +2413,7 @@ void performVariableDefinition(struct VariableDefinition_S variable, Project* pr
     value->type = VALUE_TYPE_ARRAY;
     value->asArray = (struct ArrayValue){
         .count = size.asNumber,
-        .values = avAllocatorAllocate(sizeof(struct Value)*size.asNumber, &project->allocator)
+        .values = projectAllocate(project, sizeof(struct Value)*size.asNumber)
     };
     addVariableToContext((struct VariableDescription){
         .identifier = variable.identifier,
@@ -1702,7 +2448,7 @@ void runIfPerformStatement(struct IfPerformStatement_S statement, Project* proje
                     callFunction(stat.functionCall, project);
                     break;
                 case PERFORM_OPERATION_TYPE_VARIABLE_ASSIGNMENT:
-                    runVariableAssignment(stat.variableAssignment, -1, project);
+                    runCommandVariableAssignment(stat.variableAssignment, project);
                     break;
                 case PERFORM_OPERATION_TYPE_COMMAND:
                     performCommand(stat.commandStatement, project);
@@ -1730,7 +2476,7 @@ void runIfPerformStatement(struct IfPerformStatement_S statement, Project* proje
                         callFunction(stat.functionCall, project);
                         break;
                     case PERFORM_OPERATION_TYPE_VARIABLE_ASSIGNMENT:
-                        runVariableAssignment(stat.variableAssignment, -1, project);
+                        runCommandVariableAssignment(stat.variableAssignment, project);
                         break;
                     case PERFORM_OPERATION_TYPE_COMMAND:
                         performCommand(stat.commandStatement, project);
@@ -1884,6 +2630,7 @@ struct Value runIfFunctionStatement(struct IfFunctionStatement_S statement, bool
 }
 
 struct Value runFunction(struct FunctionDefinition_S function, Project* project){
+    profileEnter(function.functionName);
     struct Value value = {.type=VALUE_TYPE_NUMBER, .asNumber=0 };
     bool32 done = false;
     for(uint32 i = 0; i < function.body.statementCount; i++){
@@ -1921,6 +2668,7 @@ struct Value runFunction(struct FunctionDefinition_S function, Project* project)
             break;
         }
     }
+    profileLeave();
     return value;
 }
 
@@ -1928,17 +2676,24 @@ struct Value runFunction(struct FunctionDefinition_S function, Project* project)
 
 struct Value callFunction(struct CallExpression_S call, Project* project){
 
-    struct Value* values = avAllocate(sizeof(struct Value)*call.argumentCount, "allocating tempArgs");
+    struct Value values[call.argumentCount + 1];
     for(uint32 i = 0; i < call.argumentCount; i++){
+        if(i == 2 && isFilteredEnumeration(call, values, project)){
+            profileEnter(call.function);
+            struct Value filtered = filterEnumeration(call.arguments[i].enumeration, values[1], project);
+            profileLeave();
+            return filtered;
+        }
         struct Value tmpValue = getValue(call.arguments+i, project);
         memcpy(values+i, &tmpValue, sizeof(struct Value));
     }
 
     struct BuiltInFunctionDescription builtIn = {0};
     if(isBuiltInFunction(&builtIn, call.function, project)){
-        struct Value value = callBuiltInFunction(builtIn, call.argumentCount, values, project);
-        avFree(values);
-        return value;
+        profileEnter(builtIn.identifier);
+        struct Value returnValue = callBuiltInFunction(builtIn, call.argumentCount, values, project);
+        profileLeave();
+        return returnValue;
     }
 
     struct FunctionDescription description = findFunction(call.function, project);
@@ -1957,7 +2712,7 @@ struct Value callFunction(struct CallExpression_S call, Project* project){
         runtimeError( project,"invalid number of arguments calling function %s", call.function);
     }
 
-    
+    uint64 traceStarted = traceStart();
     startLocalContext(description.project, false);
     for(uint32 i = 0; i < call.argumentCount; i++){
         struct Value value = values[i];
@@ -1968,9 +2723,9 @@ struct Value callFunction(struct CallExpression_S call, Project* project){
         };
         assignVariable(variable, value, description.project);
     }
-    avFree(values);
     struct Value returnValue = runFunction(function, description.project);
     endLocalContext(description.project);
+    traceSpan("function", call.function, AV_EMPTY_STRING, traceStarted);
 
     return returnValue;
 }
@@ -1981,6 +2736,7 @@ void sanitizeString(AvStringRef str, Project* project){
     avStringDebugContextStart;
     AvString newStr = AV_EMPTY;
     AvString seqs[] = {
+        AV_CSTRA("\r\n"),AV_CSTRA("\n"),
         AV_CSTRA("\\n"),AV_CSTR("\n"),
         AV_CSTRA("\\\""),AV_CSTRA("\""),
         AV_CSTRA("\\\'"),AV_CSTRA("\'"),
@@ -1999,105 +2755,49 @@ void sanitizeString(AvStringRef str, Project* project){
 }
 
 struct Value getValue(struct Expression_S* expression, Project* project){
-    switch(expression->type){
-        case EXPRESSION_TYPE_NONE:
-            return (struct Value){
-                .type = VALUE_TYPE_ARRAY,
-                .asArray = {
-                    .count=0,
-                    .values=nullptr,
-                },
-            };
-        case EXPRESSION_TYPE_LITERAL:{
-            AvString str = {
-                .chrs = expression->literal.value.chrs + 1,
-                .len = expression->literal.value.len - 2,
-                .memory = nullptr,
-            };
-            sanitizeString(&str, project);
-            return (struct Value){
-                .type = VALUE_TYPE_STRING,
-                .asString = str,
-            };
-        }
-        case EXPRESSION_TYPE_NUMBER:
-            return (struct Value){
-                .type = VALUE_TYPE_NUMBER,
-                .asNumber = parseNumber(expression->number.value),
-            };
-        case EXPRESSION_TYPE_ARRAY:
-            return (struct Value){
-                .type = VALUE_TYPE_ARRAY,
-                .asArray = getArray(expression->array, project),
-            };
-        case EXPRESSION_TYPE_GROUPING:
-            return getValue(expression->grouping.expression, project);
-        case EXPRESSION_TYPE_UNARY:
-            return performUnary(expression->unary, project);
-        case EXPRESSION_TYPE_SUMMATION:
-            return performSummation(expression->summation, project);
-        case EXPRESSION_TYPE_COMPARISON:
-            return performComparison(expression->comparison, project);
-        case EXPRESSION_TYPE_MULTIPLICATION:
-            return performMultiplication(expression->multiplication, project);
-        case EXPRESSION_TYPE_IDENTIFIER:
-            return retrieveVariableValue(expression->identifier, project);
-        case EXPRESSION_TYPE_ENUMERATION:
-            return enumerateFiles(expression->enumeration, project);
-        case EXPRESSION_TYPE_FILTER:
-            return filterValues(expression->filter, project);
-        case EXPRESSION_TYPE_CALL:
-            return callFunction(expression->call, project);
+    if(expression->byteCode == nullptr){
+        // the code is kept with the statement, so it has to outlive the instance running it
+        expression->byteCode = compileExpression(expression, project->statementOwner);
     }
-    return NULL_VALUE;
+    return runExpressionByteCode(expression->byteCode, project);
 }
 void addVariableToContext(struct VariableDescription description, Project* project);
 
 void assignVariableInGlobalScope(struct VariableDescription description, struct Value value, Project* project){
-    avDynamicArrayForEachElement(struct VariableDescription, project->variables, {
-        if(avStringEquals(description.identifier, element.identifier)){
-            avDynamicArrayWrite(&description, index, project->variables);
-            return;
-        }
-    });
-    avDynamicArrayForEachElement(struct VariableDescription, project->constants, {
-        if(avStringEquals(description.identifier, element.identifier)){
-            runtimeError(project, "Cant write to constant");
-            return;
-        }
-    });
+    uint32 index = 0;
+    if(symbolTableFind(&project->symbols, SYMBOL_KIND_VARIABLE, description.identifier, &index)){
+        avDynamicArrayWrite(&description, index, project->variables);
+        invalidateVariableReaders(description.identifier);
+        return;
+    }
+    if(symbolTableFind(&project->symbols, SYMBOL_KIND_CONSTANT, description.identifier, &index)){
+        runtimeError(project, "Cant write to constant");
+        return;
+    }
     addVariableToContext(description, project);
 }
 
 void assignVariable(struct VariableDescription description, struct Value value, Project* project){
-    struct Value* val = avAllocatorAllocate(sizeof(struct Value), &project->allocator);
+    struct Value* val = projectAllocate(project, sizeof(struct Value));
     memcpy(val, &value, sizeof(struct Value));
     description.value = val;
-    LocalContext* context =  project->localContext;
-    while(context){
-        avDynamicArrayForEachElement(struct VariableDescription, context->variables, {
-            if(avStringEquals(description.identifier, element.identifier)){
-                avDynamicArrayWrite(&description, index, context->variables);
-                return;
-            }
-        });
-        if(!context->inherit){
-            break;
-        }
-        context = context->previous;
+    struct VariableDescription* local = findLocalVariable(description.identifier, project);
+    if(local){
+        memcpy(local, &description, sizeof(struct VariableDescription));
+        return;
     }
     assignVariableInGlobalScope(description, value, project);
 }
 
 void assignConstant(struct VariableDescription description, struct Value value, Project* project){
-    struct Value* val = avAllocatorAllocate(sizeof(struct Value), &project->allocator);
+    struct Value* val = projectAllocate(project, sizeof(struct Value));
     memcpy(val, &value, sizeof(struct Value));
     description.value = val;
-    avDynamicArrayForEachElement(struct VariableDescription, project->variables, {
-        if(avStringEquals(description.identifier, element.identifier)){
-            runtimeError(project, "constant already exists!");
-        }
-    });
+    uint32 index = 0;
+    if(symbolTableFind(&project->symbols, SYMBOL_KIND_VARIABLE, description.identifier, &index)){
+        runtimeError(project, "constant already exists!");
+    }
+    symbolTableAdd(&project->symbols, SYMBOL_KIND_CONSTANT, description.identifier, avDynamicArrayGetSize(project->constants));
     avDynamicArrayAdd(&description, project->constants);
 }
 
@@ -2138,36 +2838,16 @@ struct Value appendValue(struct Value valueA, struct Value valueB, Project* proj
 }
 
 void assignVariableIndexed(struct AvString identifier, uint32 index, struct Value value, Project* project){
-    LocalContext* context =  project->localContext;
-    AvDynamicArray variables = nullptr;
-    uint32 varIndex = -1;
-    while(context){
-        avDynamicArrayForEachElement(struct VariableDescription, context->variables, {
-            if(avStringEquals(identifier, element.identifier)){
-                variables = context->variables;
-                varIndex = index;
-                break;
-            }
-        });
-        if(!context->inherit || varIndex != -1){
-            break;
-        }
-        context = context->previous;
+    struct VariableDescription* variable = findLocalVariable(identifier, project);
+    uint32 varIndex = 0;
+    if(!variable && symbolTableFind(&project->symbols, SYMBOL_KIND_VARIABLE, identifier, &varIndex)){
+        variable = avDynamicArrayGetPtr(varIndex, project->variables);
+        invalidateVariableReaders(identifier);
     }
-    if(varIndex == -1){
-        avDynamicArrayForEachElement(struct VariableDescription, project->variables, {
-            if(avStringEquals(identifier, element.identifier)){
-                variables = context->variables;
-                varIndex = index;
-                break;
-            }
-        });
-    }
-    if(varIndex == -1){
+    if(!variable){
         runtimeError(project, "accessing unknown variable '%s' with index", identifier);
         return;
     }
-    struct VariableDescription* variable = avDynamicArrayGetPtr(varIndex, variables);
     if(!variable->value){
         runtimeError(project, "variable '%s' not initialized", identifier);
         return;
@@ -2187,19 +2867,22 @@ void assignVariableIndexed(struct AvString identifier, uint32 index, struct Valu
     struct ConstValue val = {0};
     toConstValue(value, &val, project);
 
+    unshareArray(variable->value, project);
     memcpy(variable->value->asArray.values+index, &val, sizeof(struct ConstValue));
 }
 
 void addVariableToGlobalContext(struct VariableDescription description, Project* project){
+    invalidateVariableReaders(description.identifier);
+    symbolTableAdd(&project->symbols, SYMBOL_KIND_VARIABLE, description.identifier, avDynamicArrayGetSize(project->variables));
     avDynamicArrayAdd(&description, project->variables);
 }
 
 void addVariableToContext(struct VariableDescription description, Project* project){
-    if(!project->localContext){
-        avDynamicArrayAdd(&description, project->variables);
+    if(!project->localContext.frameCount){
+        addVariableToGlobalContext(description, project);
         return;
     }
-    avDynamicArrayAdd(&description, project->localContext->variables);
+    addLocalVariable(description, project);
 }
 
 void runVariableAssignment(struct VariableAssignment_S statement, uint32 index, Project* project){
@@ -2278,7 +2961,7 @@ void performInherit(struct InheritStatement_S inheritStatement, uint32 i, Projec
                 return;
             }
             if(stat->type == STATEMENT_TYPE_VARIABLE_ASSIGNMENT){
-                struct Value* value = avAllocatorAllocate(sizeof(struct Value), &project->allocator);
+                struct Value* value = projectAllocate(project, sizeof(struct Value));
                 struct Value tmpValue = getValue(stat->variableAssignment.value, description.project);
                 memcpy(value, &tmpValue, sizeof(AvString));
                 addVariableToGlobalContext((struct VariableDescription){
@@ -2294,7 +2977,7 @@ void performInherit(struct InheritStatement_S inheritStatement, uint32 i, Projec
             }
         }
     }else if(inheritStatement.defaultValue){
-        struct Value* value = avAllocatorAllocate(sizeof(struct Value), &project->allocator);
+        struct Value* value = projectAllocate(project, sizeof(struct Value));
         struct Value tmpValue = getValue(inheritStatement.defaultValue, project);
         memcpy(value, &tmpValue, sizeof(AvString));
         addVariableToGlobalContext((struct VariableDescription){
@@ -2396,6 +3079,7 @@ uint32 runProject(Project* project, AvDynamicArray arguments){
         assignVariable(variable, value, project);
     }
     struct Value returnValue = runFunction(function, project);
+    jobPoolWaitAll();
     endLocalContext(project);
     if(returnValue.type == VALUE_TYPE_NUMBER){
         return returnValue.asNumber;
@@ -2407,4 +3091,12 @@ uint32 runProject(Project* project, AvDynamicArray arguments){
         return returnValue.asArray.count == 0;
     }
     return -1;
-}
\ No newline at end of file
+}
+
+// the evaluations and loops a runtime error left are gone with their stack frames, the commands they started
+// still finish before the values they write to are destroyed
+void runtimeErrorAbandon(){
+    lazyValues.evaluation = nullptr;
+    jobPoolWaitAll();
+    jobPoolEndLoop(0);
+}
@@ -0,0 +1,74 @@
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <string.h>
+
+static uint64 symbolHash(enum SymbolKind kind, AvString identifier){
+    uint64 hash = hashString(identifier, HASH_SEED);
+    hash = hashBytes(&kind, sizeof(kind), hash);
+    // 0 marks an empty slot
+    return hash ? hash : 1;
+}
+
+static struct Symbol* findSlot(struct SymbolTable* table, uint64 hash, enum SymbolKind kind, AvString identifier){
+    uint32 mask = table->capacity - 1;
+    for(uint32 i = hash & mask;; i = (i + 1) & mask){
+        struct Symbol* symbol = table->symbols + i;
+        if(symbol->hash == 0){
+            return symbol;
+        }
+        if(symbol->hash == hash && symbol->kind == kind && avStringEquals(symbol->identifier, identifier)){
+            return symbol;
+        }
+    }
+}
+
+void symbolTableCreate(struct SymbolTable* table){
+    table->count = 0;
+    table->capacity = 64;
+    table->symbols = avCallocate(table->capacity, sizeof(struct Symbol), "symbol table");
+}
+
+void symbolTableDestroy(struct SymbolTable* table){
+    if(table->symbols){
+        avFree(table->symbols);
+    }
+    memset(table, 0, sizeof(struct SymbolTable));
+}
+
+bool32 symbolTableFind(struct SymbolTable* table, enum SymbolKind kind, AvString identifier, uint32* index){
+    if(table->count == 0){
+        return false;
+    }
+    struct Symbol* symbol = findSlot(table, symbolHash(kind, identifier), kind, identifier);
+    if(symbol->hash == 0){
+        return false;
+    }
+    *index = symbol->index;
+    return true;
+}
+
+void symbolTableAdd(struct SymbolTable* table, enum SymbolKind kind, AvString identifier, uint32 index){
+    if((table->count + 1) * 2 > table->capacity){
+        struct Symbol* symbols = table->symbols;
+        uint32 capacity = table->capacity;
+        table->capacity *= 2;
+        table->symbols = avCallocate(table->capacity, sizeof(struct Symbol), "symbol table");
+        for(uint32 i = 0; i < capacity; i++){
+            if(symbols[i].hash){
+                memcpy(findSlot(table, symbols[i].hash, symbols[i].kind, symbols[i].identifier), symbols + i, sizeof(struct Symbol));
+            }
+        }
+        avFree(symbols);
+    }
+    uint64 hash = symbolHash(kind, identifier);
+    struct Symbol* symbol = findSlot(table, hash, kind, identifier);
+    if(symbol->hash){
+        // lookups used to return the first definition, keep it that way
+        return;
+    }
+    symbol->hash = hash;
+    symbol->kind = kind;
+    symbol->identifier = identifier;
+    symbol->index = index;
+    table->count++;
+}
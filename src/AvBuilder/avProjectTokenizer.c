@@ -7,66 +7,142 @@
 #include <AvUtils/avMath.h>
 #include <AvUtils/filesystem/avFile.h>
 #include <AvUtils/avMemory.h>
+#include <AvUtils/logging/avAssert.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
 
-bool32 consumeToken(uint64* const readIndex, const AvString projectFileContent, const uint32 tokenCount, const AvString * const tokens){
-    uint32 keywordLength = 0;
-    uint32 longestKeyword = -1;
-    for(uint32 i = 0; i < tokenCount; i++){
-        const AvString keyword = tokens[i];
-        const uint64 remainingLength = projectFileContent.len - *readIndex;
-        if(!avStringEquals(keyword, AV_STR(projectFileContent.chrs+*readIndex, AV_MIN(keyword.len, remainingLength)))){
-            continue;
+#define TOKEN_KEYWORD(token) TOKEN_TYPE_KEYWORD_##token,
+#define TOKEN_PUNCTUATOR(token)
+#define TOKEN(type, token, symbol) TOKEN_##type(token)
+static const TokenType keywordTypes[] = {
+    LIST_OF_TOKENS
+};
+#undef TOKEN_KEYWORD
+#undef TOKEN_PUNCTUATOR
+#undef TOKEN
+
+#define TOKEN_KEYWORD(token)
+#define TOKEN_PUNCTUATOR(token) TOKEN_TYPE_PUNCTUATOR_##token,
+#define TOKEN(type, token, symbol) TOKEN_##type(token)
+static const TokenType punctuatorTypes[] = {
+    LIST_OF_TOKENS
+};
+#undef TOKEN_KEYWORD
+#undef TOKEN_PUNCTUATOR
+#undef TOKEN
+
+enum CharClass {
+    CHAR_CLASS_WHITESPACE   = 1<<0,
+    CHAR_CLASS_NEWLINE      = 1<<1,
+    CHAR_CLASS_WORD         = 1<<2, // letters and digits, a keyword has to end before one of these
+    CHAR_CLASS_PUNCTUATOR   = 1<<3, // first character of a punctuator, ends text
+};
+
+#define KEYWORD_TABLE_SIZE 64
+
+static struct Lexicon {
+    bool32 initialized;
+    uint8 charClasses[256];
+    // open addressing table of keyword index + 1, 0 for empty slots
+    uint8 keywordTable[KEYWORD_TABLE_SIZE];
+    // punctuator indices grouped by their first character, longest first
+    uint8 punctuatorStart[256];
+    uint8 punctuatorMatches[256];
+    uint8 punctuatorOrder[64];
+} lexicon = {0};
+
+static uint32 keywordHash(const char* chrs, uint64 len){
+    return ((uint32)len * 31 + (uint8)chrs[0] * 7 + (uint8)chrs[len - 1]) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+static void initializeLexicon(){
+    if(lexicon.initialized){
+        return;
+    }
+    avAssert(keywordCount < KEYWORD_TABLE_SIZE / 2, "keyword table too small");
+    avAssert(punctuatorCount <= sizeof(lexicon.punctuatorOrder), "punctuator table too small");
+
+    for(uint32 c = 0; c < 256; c++){
+        uint8 class = 0;
+        if(avCharIsWhiteSpace(c) || c == '\r'){
+            class |= CHAR_CLASS_WHITESPACE;
         }
-        if(keyword.len == remainingLength){
-            (*readIndex)++;
-            return true;
-        }            
-        if(remainingLength >= keyword.len && keyword.len != 1){
-            char next = (projectFileContent.chrs[*readIndex + keyword.len]);
-            if(avCharIsLetter(next)||avCharIsNumber(next)){
+        if(avCharIsNewline(c)){
+            class |= CHAR_CLASS_NEWLINE;
+        }
+        if(avCharIsLetter(c) || avCharIsNumber(c)){
+            class |= CHAR_CLASS_WORD;
+        }
+        lexicon.charClasses[c] = class;
+    }
+
+    for(uint32 i = 0; i < keywordCount; i++){
+        uint32 slot = keywordHash(keywords[i].chrs, keywords[i].len);
+        while(lexicon.keywordTable[slot]){
+            slot = (slot + 1) & (KEYWORD_TABLE_SIZE - 1);
+        }
+        lexicon.keywordTable[slot] = i + 1;
+    }
+
+    uint32 orderIndex = 0;
+    for(uint32 c = 0; c < 256; c++){
+        lexicon.punctuatorStart[c] = orderIndex;
+        for(uint32 i = 0; i < punctuatorCount; i++){
+            if((uint8)punctuators[i].chrs[0] != c){
                 continue;
             }
+            lexicon.charClasses[c] |= CHAR_CLASS_PUNCTUATOR;
+            uint32 j = orderIndex++;
+            for(; j > lexicon.punctuatorStart[c] && punctuators[lexicon.punctuatorOrder[j - 1]].len < punctuators[i].len; j--){
+                lexicon.punctuatorOrder[j] = lexicon.punctuatorOrder[j - 1];
+            }
+            lexicon.punctuatorOrder[j] = i;
+            lexicon.punctuatorMatches[c]++;
         }
+    }
+    lexicon.initialized = true;
+}
 
-        if(keyword.len > keywordLength){
-            keywordLength = keyword.len;
-            longestKeyword = i;
-        }
+static inline bool32 isCharClass(char c, enum CharClass class){
+    return (lexicon.charClasses[(uint8)c] & class) != 0;
+}
+
+bool32 consumeKeyword(uint64* const readIndex, const AvString projectFileContent, TokenType* type){
+    uint64 index = *readIndex;
+    while(index < projectFileContent.len && isCharClass(projectFileContent.chrs[index], CHAR_CLASS_WORD)){
+        index++;
     }
-    if(longestKeyword == -1){
+    uint64 length = index - *readIndex;
+    if(length == 0){
         return false;
     }
-    *readIndex += keywordLength;
-    return true;
+    const char* word = projectFileContent.chrs + *readIndex;
+    for(uint32 slot = keywordHash(word, length); lexicon.keywordTable[slot]; slot = (slot + 1) & (KEYWORD_TABLE_SIZE - 1)){
+        uint32 keyword = lexicon.keywordTable[slot] - 1;
+        if(keywords[keyword].len == length && memcmp(keywords[keyword].chrs, word, length) == 0){
+            *type = keywordTypes[keyword];
+            *readIndex = index;
+            return true;
+        }
+    }
+    return false;
 }
 
-bool32 consumePunctuator(uint64* const readIndex, const AvString projectFileContent, const uint32 tokenCount, const AvString * const tokens){
-    uint32 keywordLength = 0;
-    uint32 longestKeyword = -1;
-    for(uint32 i = 0; i < tokenCount; i++){
-        const AvString keyword = tokens[i];
-        const uint64 remainingLength = projectFileContent.len - *readIndex;
-        if(!avStringEquals(keyword, AV_STR(projectFileContent.chrs+*readIndex, AV_MIN(keyword.len, remainingLength)))){
+bool32 consumePunctuator(uint64* const readIndex, const AvString projectFileContent, TokenType* type){
+    uint8 c = projectFileContent.chrs[*readIndex];
+    const uint64 remainingLength = projectFileContent.len - *readIndex;
+    for(uint32 i = 0; i < lexicon.punctuatorMatches[c]; i++){
+        uint32 punctuator = lexicon.punctuatorOrder[lexicon.punctuatorStart[c] + i];
+        const AvString symbol = punctuators[punctuator];
+        if(symbol.len > remainingLength || memcmp(symbol.chrs, projectFileContent.chrs + *readIndex, symbol.len) != 0){
             continue;
         }
-        if(keyword.len == remainingLength){
-            (*readIndex)++;
-            return true;
-        }            
-
-        if(keyword.len > keywordLength){
-            keywordLength = keyword.len;
-            longestKeyword = i;
-        }
-    }
-    if(longestKeyword == -1){
-        return false;
+        *type = punctuatorTypes[punctuator];
+        *readIndex += symbol.len;
+        return true;
     }
-    *readIndex += keywordLength;
-    return true;
+    return false;
 }
 
 void consumeComments(uint64* const readIndex, uint32* const lineIndex, const AvString projectFileContent){
@@ -234,18 +310,7 @@ bool32 consumeText(uint64 * const readIndex, const AvString projectFileContent){
     for(; index < projectFileContent.len; index++){
         char chr = projectFileContent.chrs[index];
 
-        if(avCharIsWhiteSpace(chr)){
-            break;
-        }
-
-        bool32 isPunctuator = false;
-        for(uint32 i = 0; i < punctuatorCount; i++){
-            if(punctuators[i].chrs[0] == chr){
-                isPunctuator = true;
-                break;
-            }
-        }
-        if(isPunctuator){
+        if(isCharClass(chr, CHAR_CLASS_WHITESPACE | CHAR_CLASS_PUNCTUATOR)){
             break;
         }
 
@@ -282,24 +347,23 @@ bool32 tokenizeProject(const AvString projectFileContent, const AvString project
     uint64 tokenStart = 0;
 
     TokenType tokenType = TOKEN_TYPE_NONE;
+    initializeLexicon();
 
     while(readIndex < projectFileContent.len){
         consumeComments(&readIndex, &line, projectFileContent);
         tokenStart = readIndex;
         
-        if(avCharIsWhiteSpace(projectFileContent.chrs[readIndex])){
-            if(avCharIsNewline(projectFileContent.chrs[readIndex])){
+        if(isCharClass(projectFileContent.chrs[readIndex], CHAR_CLASS_WHITESPACE)){
+            if(isCharClass(projectFileContent.chrs[readIndex], CHAR_CLASS_NEWLINE)){
                 line++;
             }
             readIndex++;
             continue;
         }
-        if(consumeToken(&readIndex, projectFileContent, keywordCount, keywords)){
-            tokenType = TOKEN_TYPE_KEYWORD;
+        if(consumeKeyword(&readIndex, projectFileContent, &tokenType)){
             goto tokenFound;
         }
-        if(consumePunctuator(&readIndex, projectFileContent, punctuatorCount, punctuators)){
-            tokenType = TOKEN_TYPE_PUNCTUATOR;
+        if(consumePunctuator(&readIndex, projectFileContent, &tokenType)){
             goto tokenFound;
         }
 
@@ -334,14 +398,6 @@ bool32 tokenizeProject(const AvString projectFileContent, const AvString project
             if(token.str.len==0){
                 return false;
             }
-
-            #define TOKEN(tokenType, tokenName, symbol) \
-            if(avStringEquals(token.str, AV_CSTR(symbol))) { \
-                 token.type = TOKEN_TYPE_##tokenType##_##tokenName;\
-            }
-            LIST_OF_TOKENS
-            #undef TOKEN
-
             avDynamicArrayAdd(&token, tokens);
         }
     }
@@ -0,0 +1,290 @@
+// sigaction is not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#endif
+
+// events following each other within this many milliseconds start a single run, saving a file
+// or a command writing a directory usually causes a burst of them
+#define WATCH_SETTLE_TIME 100
+
+#ifdef __linux__
+#define WATCH_FILE_EVENTS (IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+// only entries appearing or disappearing change an enumeration, writes to the files are left to their own watches
+#define WATCH_DIRECTORY_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+enum WatchKind {
+    WATCH_KIND_NONE,
+    WATCH_KIND_INPUT,   // a change runs the entry function again
+    WATCH_KIND_PROJECT, // a change loads the project files again
+};
+
+struct WatchTarget {
+    enum WatchKind kind;
+    char* path; // as it was first watched, for reporting
+};
+
+// directories are watched from the threads walking them
+static struct {
+    int fd;
+    pthread_mutex_t mutex;
+    uint32 targetCapacity;
+    struct WatchTarget* targets; // indexed by watch descriptor
+    bool32 reload;
+    struct sigaction previousInterrupt;
+} watcher = {
+    .fd = -1,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static volatile sig_atomic_t watchInterrupted = 0;
+
+static void interruptWatch(int signal){
+    watchInterrupted = 1;
+}
+
+static void addWatch(const char* path, uint32 mask, enum WatchKind kind){
+    if(watcher.fd == -1){
+        return;
+    }
+    int wd = inotify_add_watch(watcher.fd, path, mask | IN_MASK_ADD);
+    if(wd < 0){
+        return;
+    }
+    pthread_mutex_lock(&watcher.mutex);
+    if((uint32)wd >= watcher.targetCapacity){
+        uint32 capacity = watcher.targetCapacity ? watcher.targetCapacity : 64;
+        while(capacity <= (uint32)wd){
+            capacity *= 2;
+        }
+        struct WatchTarget* targets = avCallocate(capacity, sizeof(struct WatchTarget), "watch targets");
+        if(watcher.targets){
+            memcpy(targets, watcher.targets, sizeof(struct WatchTarget) * watcher.targetCapacity);
+            avFree(watcher.targets);
+        }
+        watcher.targets = targets;
+        watcher.targetCapacity = capacity;
+    }
+    struct WatchTarget* target = watcher.targets + wd;
+    if(target->path == nullptr){
+        uint64 length = strlen(path);
+        target->path = avAllocate(length + 1, "watched path");
+        memcpy(target->path, path, length + 1);
+    }
+    if(kind > target->kind){
+        target->kind = kind;
+    }
+    pthread_mutex_unlock(&watcher.mutex);
+}
+
+static void addWatchString(AvString path, uint32 mask, enum WatchKind kind){
+    if(watcher.fd == -1 || path.len == 0){
+        return;
+    }
+    char fileName[path.len + 1];
+    memcpy(fileName, path.chrs, path.len);
+    fileName[path.len] = '\0';
+    addWatch(fileName, mask, kind);
+}
+
+static void forgetWatch(int wd){
+    pthread_mutex_lock(&watcher.mutex);
+    if(wd >= 0 && (uint32)wd < watcher.targetCapacity){
+        struct WatchTarget* target = watcher.targets + wd;
+        if(target->path){
+            avFree(target->path);
+        }
+        target->path = nullptr;
+        target->kind = WATCH_KIND_NONE;
+    }
+    pthread_mutex_unlock(&watcher.mutex);
+}
+
+static enum WatchKind watchKind(int wd, const char* name){
+    enum WatchKind kind = WATCH_KIND_NONE;
+    pthread_mutex_lock(&watcher.mutex);
+    if(wd >= 0 && (uint32)wd < watcher.targetCapacity){
+        struct WatchTarget* target = watcher.targets + wd;
+        kind = target->kind;
+        if(kind != WATCH_KIND_NONE && name){
+            printf("%s/%s changed\n", target->path, name);
+        }else if(kind != WATCH_KIND_NONE){
+            printf("%s changed\n", target->path);
+        }
+    }
+    pthread_mutex_unlock(&watcher.mutex);
+    return kind;
+}
+#endif
+
+// watching only starts once the watcher is open, until then the calls adding watches do nothing
+bool32 watchOpen(){
+#ifdef __linux__
+    watcher.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(watcher.fd == -1){
+        return false;
+    }
+    watcher.reload = false;
+    watchInterrupted = 0;
+    // an interrupt ends the watch after the current run instead of leaving the databases unwritten
+    struct sigaction action = {0};
+    action.sa_handler = interruptWatch;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, &watcher.previousInterrupt);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void watchClose(){
+#ifdef __linux__
+    if(watcher.fd == -1){
+        return;
+    }
+    sigaction(SIGINT, &watcher.previousInterrupt, nullptr);
+    close(watcher.fd);
+    watcher.fd = -1;
+    for(uint32 i = 0; i < watcher.targetCapacity; i++){
+        if(watcher.targets[i].path){
+            avFree(watcher.targets[i].path);
+        }
+    }
+    if(watcher.targets){
+        avFree(watcher.targets);
+    }
+    watcher.targets = nullptr;
+    watcher.targetCapacity = 0;
+#endif
+}
+
+// an input of a command
+void watchFile(AvString path){
+#ifdef __linux__
+    addWatchString(path, WATCH_FILE_EVENTS, WATCH_KIND_INPUT);
+#endif
+}
+
+void watchProjectFile(AvString path){
+#ifdef __linux__
+    addWatchString(path, WATCH_FILE_EVENTS, WATCH_KIND_PROJECT);
+#endif
+}
+
+// a directory that was enumerated
+void watchDirectory(const char* path){
+#ifdef __linux__
+    addWatch(path, WATCH_DIRECTORY_EVENTS, WATCH_KIND_INPUT);
+#endif
+}
+
+// blocks until a watched file changes, returns false once interrupted. A change of a project file
+// stays pending until the next call, which returns right away
+bool32 watchWait(){
+#ifdef __linux__
+    if(watcher.fd == -1 || watchInterrupted){
+        return false;
+    }
+    if(watcher.reload){
+        watcher.reload = false;
+        return true;
+    }
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool32 changed = false;
+    while(!watchInterrupted){
+        struct pollfd descriptor = {
+            .fd = watcher.fd,
+            .events = POLLIN,
+        };
+        int ready = poll(&descriptor, 1, changed ? WATCH_SETTLE_TIME : -1);
+        if(ready < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return false;
+        }
+        if(ready == 0){
+            fflush(stdout);
+            return true;
+        }
+        ssize_t size = read(watcher.fd, buffer, sizeof(buffer));
+        if(size < 0){
+            if(errno == EINTR || errno == EAGAIN){
+                continue;
+            }
+            return false;
+        }
+        for(char* at = buffer; at < buffer + size;){
+            const struct inotify_event* event = (const struct inotify_event*)at;
+            at += sizeof(struct inotify_event) + event->len;
+            if(event->mask & IN_Q_OVERFLOW){
+                // events were lost, anything might have changed
+                changed = true;
+                watcher.reload = true;
+                continue;
+            }
+            if(event->mask & IN_IGNORED){
+                forgetWatch(event->wd);
+                continue;
+            }
+            enum WatchKind kind = watchKind(event->wd, event->len ? event->name : nullptr);
+            if(kind == WATCH_KIND_NONE){
+                continue;
+            }
+            changed = true;
+            if(kind == WATCH_KIND_PROJECT){
+                watcher.reload = true;
+            }
+        }
+    }
+#endif
+    return false;
+}
+
+bool32 watchReloadPending(){
+#ifdef __linux__
+    return watcher.reload;
+#else
+    return false;
+#endif
+}
+
+// runs the entry function every time an input changes, until a project file changes or the watch is interrupted.
+// The parsed project and its imports stay loaded, each run gets a fresh instance borrowing their statements, so
+// no value computed by an earlier run is seen. Commands whose inputs did not change are skipped by the build database
+uint32 runProjectWatched(Project* project, AvDynamicArray arguments){
+    uint64 key = projectFileKey(project->projectFileName);
+    moduleRegistryAdd(key, project);
+    uint32 result = -1;
+#ifdef __linux__
+    // a run changing the directory does not move the next one
+    int workingDir = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+    do{
+        result = runModule(key, &project->options, arguments);
+#ifdef __linux__
+        if(workingDir != -1 && fchdir(workingDir) != 0){
+            printf("unable to return to the directory of the watched project\n");
+        }
+#endif
+        printf("Finished with %i, watching for changes\n", (int)result);
+        fflush(stdout);
+    }while(watchWait() && !watchReloadPending());
+#ifdef __linux__
+    if(workingDir != -1){
+        close(workingDir);
+    }
+#endif
+    return result;
+}
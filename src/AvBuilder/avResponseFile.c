@@ -0,0 +1,170 @@
+// PATH_MAX is not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#else
+#include <io.h>
+#include <process.h>
+#include <windows.h>
+#endif
+
+#define RESPONSE_FILE_DIR BUILD_DATABASE_DIR "/rsp"
+#define RESPONSE_FILE_NAME_SIZE (PATH_MAX + 64)
+// CreateProcess takes a command line of at most 32767 characters, the rest is left for the quotes added to the arguments
+#define RESPONSE_FILE_WINDOWS_THRESHOLD (30 * 1024)
+
+// tools reading their arguments from "@file". All of them expand it with the rules of libiberty:
+// arguments are separated by whitespace and a backslash takes the next character literally
+static const char* responseFileTools[] = {
+    "gcc", "g++", "cc", "c++", "cpp",
+    "clang", "clang++",
+    "ld", "ld.bfd", "ld.gold", "ld.lld", "lld",
+    "ar", "ranlib",
+};
+
+// also matches cross compilers ("x86_64-w64-mingw32-gcc") and versioned ones ("gcc-13")
+static bool32 matchesTool(AvString name, const char* tool){
+    uint64 length = strlen(tool);
+    for(uint64 offset = 0; offset + length <= name.len; offset++){
+        if(memcmp(name.chrs + offset, tool, length) != 0){
+            continue;
+        }
+        if(offset != 0 && name.chrs[offset - 1] != '-'){
+            continue;
+        }
+        uint64 end = offset + length;
+        if(end == name.len){
+            return true;
+        }
+        if(name.chrs[end] != '-'){
+            continue;
+        }
+        bool32 version = end + 1 < name.len;
+        for(uint64 i = end + 1; i < name.len; i++){
+            if(!((name.chrs[i] >= '0' && name.chrs[i] <= '9') || name.chrs[i] == '.')){
+                version = false;
+            }
+        }
+        if(version){
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool32 supportsResponseFiles(AvString program){
+    AvString name = program;
+    for(uint64 i = program.len; i > 0; i--){
+        if(program.chrs[i - 1] == '/' || program.chrs[i - 1] == '\\'){
+            name.chrs = program.chrs + i;
+            name.len = program.len - i;
+            break;
+        }
+    }
+    for(uint32 i = 0; i < sizeof(responseFileTools) / sizeof(responseFileTools[0]); i++){
+        if(matchesTool(name, responseFileTools[i])){
+            return true;
+        }
+    }
+    return false;
+}
+
+static void writeResponseArgument(FILE* file, AvString argument){
+    // an empty line would be skipped as whitespace
+    if(argument.len == 0){
+        fputs("\"\"\n", file);
+        return;
+    }
+    for(uint64 i = 0; i < argument.len; i++){
+        char c = argument.chrs[i];
+        if(c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f' || c == '\'' || c == '"' || c == '\\'){
+            putc('\\', file);
+        }
+        putc(c, file);
+    }
+    putc('\n', file);
+}
+
+// writes the arguments of a command that takes more than threshold bytes to a response file. Returns
+// the "@file" argument replacing them, or nullptr when the command is run as it is
+char* responseFileWrite(uint32 argCount, AvString* args, uint64 threshold){
+    if(threshold == 0 || argCount < 2){
+        return nullptr;
+    }
+#ifndef _WIN32
+    // the strings and the pointers to them count against the limit of the system
+    uint64 size = sizeof(char*);
+    for(uint32 i = 0; i < argCount; i++){
+        size += args[i].len + 1 + sizeof(char*);
+    }
+#else
+    // the arguments are joined into one command line, each one quoted and followed by a space
+    if(threshold > RESPONSE_FILE_WINDOWS_THRESHOLD){
+        threshold = RESPONSE_FILE_WINDOWS_THRESHOLD;
+    }
+    uint64 size = 0;
+    for(uint32 i = 0; i < argCount; i++){
+        size += args[i].len + 3;
+    }
+#endif
+    if(size <= threshold || !supportsResponseFiles(args[0])){
+        return nullptr;
+    }
+    // absolute, so the command finds it whatever directory the script changed to
+    char dir[PATH_MAX];
+#ifndef _WIN32
+    workspacePath(dir, sizeof(dir), RESPONSE_FILE_DIR);
+    if(mkdir(dir, 0755) != 0 && errno != EEXIST){
+        return nullptr;
+    }
+    int32 pid = getpid();
+#else
+    // the workspace is not tracked on windows, the temporary directory is absolute on its own
+    DWORD length = GetTempPathA(sizeof(dir), dir);
+    if(length == 0 || length >= sizeof(dir)){
+        return nullptr;
+    }
+    // the path ends with a separator
+    dir[length - 1] = '\0';
+    int32 pid = _getpid();
+#endif
+
+    static uint32 responseFileCounter = 0;
+    char* argument = avAllocate(RESPONSE_FILE_NAME_SIZE + 1, "response file");
+    snprintf(argument, RESPONSE_FILE_NAME_SIZE + 1, "@%s/avBuilder-%i-%u.rsp", dir, (int)pid, ++responseFileCounter);
+    FILE* file = fopen(argument + 1, "w");
+    if(file == nullptr){
+        avFree(argument);
+        return nullptr;
+    }
+    for(uint32 i = 1; i < argCount; i++){
+        writeResponseArgument(file, args[i]);
+    }
+    bool32 written = !ferror(file);
+    if(fclose(file) != 0 || !written){
+        responseFileRemove(argument);
+        return nullptr;
+    }
+    return argument;
+}
+
+// removes the response file of a command once it finished
+void responseFileRemove(char* argument){
+    if(argument == nullptr){
+        return;
+    }
+#ifndef _WIN32
+    unlink(argument + 1);
+#else
+    _unlink(argument + 1);
+#endif
+    avFree(argument);
+}
@@ -0,0 +1,170 @@
+// clock_gettime is not declared by the strict c11 headers
+#define _DEFAULT_SOURCE
+#include "avBuilder.h"
+#include <AvUtils/avMemory.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#define TRACE_LOCK() pthread_mutex_lock(&trace.mutex)
+#define TRACE_UNLOCK() pthread_mutex_unlock(&trace.mutex)
+#else
+#define TRACE_LOCK()
+#define TRACE_UNLOCK()
+#endif
+
+// commands run by the job pool are shown on a lane of their own per job
+#define TRACE_JOB_LANE 1000
+
+// events are written as they end, in the trace event format read by chrome://tracing and Perfetto
+static struct {
+    FILE* file;
+    uint64 origin;
+    uint32 threadCount;
+    uint32 eventCount;
+#ifndef _WIN32
+    pthread_mutex_t mutex;
+#endif
+} trace = {
+#ifndef _WIN32
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+#endif
+};
+
+static _Thread_local uint32 traceThread = 0;
+
+// nanoseconds, only differences between two calls mean anything
+uint64 monotonicTime(){
+    struct timespec now;
+#ifndef _WIN32
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+    return (uint64)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void writeJsonString(const char* chrs, uint64 len){
+    FILE* file = trace.file;
+    putc('"', file);
+    for(uint64 i = 0; i < len; i++){
+        unsigned char c = chrs[i];
+        if(c == '"' || c == '\\'){
+            putc('\\', file);
+            putc(c, file);
+        }else if(c < 0x20){
+            fprintf(file, "\\u%04x", c);
+        }else{
+            putc(c, file);
+        }
+    }
+    putc('"', file);
+}
+
+static void beginEvent(){
+    fputs(trace.eventCount++ ? ",\n" : "\n", trace.file);
+}
+
+// has to be called with the lock held
+static uint32 currentLane(){
+    if(traceThread == 0){
+        traceThread = ++trace.threadCount;
+        beginEvent();
+        fprintf(trace.file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+            traceThread, traceThread == 1 ? "main" : "worker", traceThread);
+    }
+    return traceThread;
+}
+
+static void writeSpan(const char* category, AvString name, uint64 start, uint64 end, uint32 lane){
+    beginEvent();
+    fputs("{\"name\":", trace.file);
+    writeJsonString(name.chrs, name.len);
+    fprintf(trace.file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u",
+        category, (start - trace.origin) / 1000.0, (end - start) / 1000.0, lane);
+}
+
+void traceOpen(AvString fileName){
+    traceClose();
+    char path[fileName.len + 1];
+    memcpy(path, fileName.chrs, fileName.len);
+    path[fileName.len] = '\0';
+    trace.file = fopen(path, "w");
+    if(trace.file == nullptr){
+        avStringPrintf(AV_CSTR("unable to write trace to %s\n"), fileName);
+        return;
+    }
+    trace.origin = monotonicTime();
+    trace.threadCount = 0;
+    trace.eventCount = 0;
+    traceThread = 0;
+    fputs("[", trace.file);
+    TRACE_LOCK();
+    beginEvent();
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"avBuilder\"}}", trace.file);
+    currentLane();
+    TRACE_UNLOCK();
+}
+
+void traceClose(){
+    if(trace.file == nullptr){
+        return;
+    }
+    fputs("\n]\n", trace.file);
+    fclose(trace.file);
+    trace.file = nullptr;
+}
+
+// the start of a span, 0 when no trace is written
+uint64 traceStart(){
+    return trace.file ? monotonicTime() : 0;
+}
+
+// a span of the calling thread from start until now, file is added to its arguments if given
+void traceSpan(const char* category, AvString name, AvString file, uint64 start){
+    if(trace.file == nullptr || start == 0){
+        return;
+    }
+    uint64 end = monotonicTime();
+    TRACE_LOCK();
+    writeSpan(category, name, start, end, currentLane());
+    if(file.len){
+        fputs(",\"args\":{\"file\":", trace.file);
+        writeJsonString(file.chrs, file.len);
+        fputs("}", trace.file);
+    }
+    fputs("}", trace.file);
+    TRACE_UNLOCK();
+}
+
+void traceNameJob(uint32 job){
+    if(trace.file == nullptr){
+        return;
+    }
+    TRACE_LOCK();
+    beginEvent();
+    fprintf(trace.file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"job %u\"}}",
+        TRACE_JOB_LANE + job, job);
+    TRACE_UNLOCK();
+}
+
+// a command named after its program. Commands of the job pool pass the job they ran on, others -1
+void traceCommand(const char* command, int32 retCode, uint64 start, int32 job){
+    if(trace.file == nullptr || start == 0){
+        return;
+    }
+    uint64 end = monotonicTime();
+    AvString name = AV_CSTR(command);
+    const char* space = memchr(name.chrs, ' ', name.len);
+    if(space){
+        name.len = space - name.chrs;
+    }
+    TRACE_LOCK();
+    writeSpan("command", name, start, end, job < 0 ? currentLane() : TRACE_JOB_LANE + (uint32)job);
+    fputs(",\"args\":{\"command\":", trace.file);
+    writeJsonString(command, strlen(command));
+    fprintf(trace.file, ",\"exitCode\":%i}}", retCode);
+    TRACE_UNLOCK();
+}
@@ -44,14 +44,6 @@ const uint32 builtInVariableCount = sizeof(builtInVariables)/sizeof(struct Built
 #undef SET_VALUE_TYPE_ARRAY
 #undef SET_VALUE_TYPE_NUMBER
 
-#define SET_VALUE_TYPE_NUMBER(number) number
-
-#define BUILT_IN_VAR(var, valType, val) var=SET_VALUE(valType, val),
-enum BuiltInConstants {
-    BUILT_IN_VARS
-};
-#undef BUILT_IN_VAR
-
 bool32 isBuiltInFunction(struct BuiltInFunctionDescription* description, AvString identifier, Project* project){
     for(uint32 i = 0; i < builtInFunctionCount; i++){
         if(avStringEquals(builtInFunctions[i].identifier, identifier)){
@@ -320,7 +312,7 @@ struct Value filter(Project* project, uint32 valueCount, struct Value* values){
     struct ConstValue* filteredValues = nullptr;
     uint32 allowedCount = avDynamicArrayGetSize(newValues);
     if(allowedCount > 0){
-        filteredValues = avAllocatorAllocate(sizeof(struct ConstValue)*allowedCount, &project->allocator);
+        filteredValues = projectAllocate(project, sizeof(struct ConstValue)*allowedCount);
         avDynamicArrayReadRange(filteredValues, allowedCount, 0, sizeof(struct ConstValue), 0, newValues);
     }
     struct Value filtered = {
@@ -448,12 +440,13 @@ struct Value println(Project* project, uint32 valueCount, struct Value* values){
 #include <AvUtils/filesystem/avDirectoryV2.h>
 
 struct Value makeDir(Project* project, uint32 valueCount, struct Value* values){
+    invalidatePathReaders(values[0].asString);
     AvString dir = AV_EMPTY;
     avStringClone(&dir, values[0].asString);
     int ret = avMakeDirectory(dir);
     if(ret == -1){
         avStringFree(&dir);
-        struct ConstValue* vals = avAllocatorAllocate(sizeof(struct ConstValue)*2, &project->allocator);
+        struct ConstValue* vals = projectAllocate(project, sizeof(struct ConstValue)*2);
         vals[0].type = VALUE_TYPE_NUMBER;
         vals[0].asNumber = errno;
         memcpy(&vals[1].asString, &AV_CSTR(strerror(errno)), sizeof(AvString));
@@ -479,12 +472,13 @@ struct Value makeDir(Project* project, uint32 valueCount, struct Value* values){
 #include <stdio.h>
 
 struct Value makeDirs(Project* project, uint32 valueCount, struct Value* values){
+    invalidatePathReaders(values[0].asString);
     AvString dir = AV_EMPTY;
     avStringClone(&dir, values[0].asString);
     int ret = avMakeDirectoryRecursive(dir);
     if(ret == -1){
         avStringFree(&dir);
-        struct ConstValue* vals = avAllocatorAllocate(sizeof(struct ConstValue)*2, &project->allocator);
+        struct ConstValue* vals = projectAllocate(project, sizeof(struct ConstValue)*2);
         vals[0].type = VALUE_TYPE_NUMBER;
         vals[0].asNumber = errno;
         vals[1].type = VALUE_TYPE_STRING;
@@ -518,22 +512,18 @@ struct Value compileString(Project* project, uint32 valueCount, struct Value* va
         return result;
     }
 
-    struct ConstValue* results = avAllocatorAllocate(sizeof(struct ConstValue)*count, &project->allocator);
+    struct ConstValue* results = projectAllocate(project, sizeof(struct ConstValue)*count);
 
     for(uint32 i = 0; i < count; i++){
         if(vals[i].type!=VALUE_TYPE_STRING){
             runtimeError(project, "invalid type");
             return result;
         }
-        AvDynamicArray finalArg = AV_EMPTY;
-        avDynamicArrayCreate(0, sizeof(char), &finalArg);
-
-        processArg(vals[i].asString, finalArg, project);
-
-        uint32 count = avDynamicArrayGetSize(finalArg);
-        char* buffer = avAllocatorAllocate(count+1, &project->allocator);
-        avDynamicArrayReadRange(buffer, count, 0, 1, 0, finalArg);
-        avDynamicArrayDestroy(finalArg);
+        uint64 size = 0;
+        char* expanded = expandCommandString(vals[i].asString, &size, project);
+        char* buffer = projectAllocate(project, size+1);
+        memcpy(buffer, expanded, size+1);
+        avFree(expanded);
 
         struct ConstValue res = {
             .type = VALUE_TYPE_STRING,
@@ -574,7 +564,7 @@ struct Value toUppercase(Project* project, uint32 valueCount, struct Value* valu
         return result;
     }
 
-    struct ConstValue* results = avAllocatorAllocate(sizeof(struct ConstValue)*count, &project->allocator);
+    struct ConstValue* results = projectAllocate(project, sizeof(struct ConstValue)*count);
 
     for(uint32 i = 0; i < count; i++){
         if(vals[i].type!=VALUE_TYPE_STRING){
@@ -626,7 +616,7 @@ struct Value toLowercase(Project* project, uint32 valueCount, struct Value* valu
         return result;
     }
 
-    struct ConstValue* results = avAllocatorAllocate(sizeof(struct ConstValue)*count, &project->allocator);
+    struct ConstValue* results = projectAllocate(project, sizeof(struct ConstValue)*count);
 
     for(uint32 i = 0; i < count; i++){
         if(vals[i].type!=VALUE_TYPE_STRING){
@@ -663,6 +653,8 @@ struct Value toLowercase(Project* project, uint32 valueCount, struct Value* valu
 }
 
 struct Value changeDir(Project* project, uint32 valueCount, struct Value* values){
+    // relative directories listed before point somewhere else now
+    invalidateFileSystemReaders();
     struct Value result = {.type=VALUE_TYPE_ARRAY, .asArray={.count=0}};
     
     struct ConstValue tmpValue = {0};
@@ -678,7 +670,7 @@ struct Value changeDir(Project* project, uint32 valueCount, struct Value* values
         return result;
     }
 
-    struct ConstValue* results = avAllocatorAllocate(sizeof(struct ConstValue)*count, &project->allocator);
+    struct ConstValue* results = projectAllocate(project, sizeof(struct ConstValue)*count);
 
     for(uint32 i = 0; i < count; i++){
         if(vals[i].type!=VALUE_TYPE_STRING){
@@ -713,6 +705,94 @@ struct Value changeDir(Project* project, uint32 valueCount, struct Value* values
     }
 }
 
+static bool32 libraryExists(AvString dir, AvString prefix, AvString name, AvString suffix, AvStringRef path, Project* project){
+    char buffer[dir.len + prefix.len + name.len + suffix.len + 2];
+    uint64 length = 0;
+    if(dir.len){
+        memcpy(buffer, dir.chrs, dir.len);
+        length = dir.len;
+        buffer[length++] = '/';
+    }
+    memcpy(buffer + length, prefix.chrs, prefix.len);
+    length += prefix.len;
+    memcpy(buffer + length, name.chrs, name.len);
+    length += name.len;
+    memcpy(buffer + length, suffix.chrs, suffix.len);
+    length += suffix.len;
+    buffer[length] = '\0';
+    FILE* file = fopen(buffer, "rb");
+    if(file == nullptr){
+        return false;
+    }
+    fclose(file);
+    avStringCopyToAllocator(AV_CSTR(buffer), path, &project->allocator);
+    return true;
+}
+
+// the files the linker picks for -L*libDirs -l*libs, in the order it searches them. Libraries only found
+// in the default search path of the linker are left out
+struct Value findLibraries(Project* project, uint32 valueCount, struct Value* values){
+    struct ConstValue tmpDir = {0};
+    uint32 dirCount = 1;
+    struct ConstValue* dirs = &tmpDir;
+    if(values[0].type == VALUE_TYPE_ARRAY){
+        dirs = values[0].asArray.values;
+        dirCount = values[0].asArray.count;
+    }else{
+        toConstValue(values[0], &tmpDir, project);
+    }
+    struct ConstValue tmpLib = {0};
+    uint32 libCount = 1;
+    struct ConstValue* libs = &tmpLib;
+    if(values[1].type == VALUE_TYPE_ARRAY){
+        libs = values[1].asArray.values;
+        libCount = values[1].asArray.count;
+    }else{
+        toConstValue(values[1], &tmpLib, project);
+    }
+
+    struct ConstValue* found = nullptr;
+    if(libCount){
+        found = projectAllocate(project, sizeof(struct ConstValue) * libCount);
+    }
+    uint32 foundCount = 0;
+    for(uint32 i = 0; i < libCount; i++){
+        if(libs[i].type != VALUE_TYPE_STRING){
+            runtimeError(project, "library names can only be strings");
+            return (struct Value){0};
+        }
+        AvString lib = libs[i].asString;
+        for(uint32 j = 0; j < dirCount; j++){
+            if(dirs[j].type != VALUE_TYPE_STRING){
+                runtimeError(project, "library directories can only be strings");
+                return (struct Value){0};
+            }
+            AvString dir = dirs[j].asString;
+            AvString path = AV_EMPTY;
+            bool32 exists = false;
+            if(lib.len && lib.chrs[0] == ':'){
+                // -l:file names the file itself
+                AvString file = { .chrs = lib.chrs + 1, .len = lib.len - 1 };
+                exists = libraryExists(dir, AV_CSTR(""), file, AV_CSTR(""), &path, project);
+            }else{
+                exists = libraryExists(dir, AV_CSTR("lib"), lib, AV_CSTR(".so"), &path, project)
+                    || libraryExists(dir, AV_CSTR("lib"), lib, AV_CSTR(".a"), &path, project);
+            }
+            if(exists){
+                found[foundCount].type = VALUE_TYPE_STRING;
+                memcpy(&found[foundCount].asString, &path, sizeof(AvString));
+                foundCount++;
+                break;
+            }
+        }
+    }
+    return (struct Value){
+        .type = VALUE_TYPE_ARRAY,
+        .asArray.count = foundCount,
+        .asArray.values = found,
+    };
+}
+
 struct Value currentDir(Project* project, uint32 valueCount, struct Value* values){
     
     char cwd[PATH_MAX];
@@ -12,7 +12,7 @@
 void runtimeError(Project* project, const char* message, ...);
 void toConstValue(struct Value value, struct ConstValue* val, Project* project);
 void toValue(struct ConstValue value, struct Value* val);
-uint32 processArg(AvString arg, AvDynamicArray chars, Project* project);
+char* expandCommandString(AvString str, uint64* size, Project* project);
 Project* importProject(AvString projectFile, bool32 local, Project* baseProject);
 struct VariableDescription findVariable(AvString identifier, Project* project);
 struct FunctionDescription findFunction(AvString identifier, Project* project);
@@ -24,6 +24,14 @@ void assignVariable(struct VariableDescription description, struct Value value,
 BUILT_IN_FUNCS
 #undef BUILT_IN_FUNC
 
+#define BUILT_IN_CONSTANT_VALUE_TYPE_NUMBER(number) number
+#define BUILT_IN_VAR(var, valType, val) var=BUILT_IN_CONSTANT_##valType(val),
+enum BuiltInConstants {
+    BUILT_IN_VARS
+};
+#undef BUILT_IN_VAR
+#undef BUILT_IN_CONSTANT_VALUE_TYPE_NUMBER
+
 
 
 struct BuiltInFunctionDescription{
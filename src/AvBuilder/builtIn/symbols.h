@@ -19,4 +19,5 @@
     BUILT_IN_FUNC(toLowercase, { VALUE_TYPE_STRING|VALUE_TYPE_ARRAY })\
     BUILT_IN_FUNC(changeDir, { VALUE_TYPE_STRING|VALUE_TYPE_ARRAY })\
     BUILT_IN_FUNC(currentDir, {})\
+    BUILT_IN_FUNC(findLibraries, { VALUE_TYPE_STRING|VALUE_TYPE_ARRAY, VALUE_TYPE_STRING|VALUE_TYPE_ARRAY })\
     BUILT_IN_FUNC(callExtern, {VALUE_TYPE_STRING, VALUE_TYPE_STRING })